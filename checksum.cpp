@@ -0,0 +1,98 @@
+#include "checksum.h"
+#ifdef CRC_CLMUL
+#include <atomic>
+#endif
+
+#if (CRC_SLICES != 1) && (CRC_SLICES != 4) && (CRC_SLICES != 8)
+#error CRC_SLICES must be 1, 4 or 8
+#endif
+
+typedef struct {
+  uint16_t t[CRC_SLICES][256];
+} crc_tables_t;
+
+/*
+ * t[0] is the usual byte table.  t[k][x] is the CRC of byte x followed by k zero bytes, so one byte at
+ * distance k from the end of a block can be folded in with a single lookup.
+ */
+static constexpr crc_tables_t crcMakeTables(void) {
+  crc_tables_t tables = {};
+  uint16_t crc = 0;
+
+  for(int ii = 0; ii < 256; ii++) {
+    crc = (uint16_t) (ii << 8);
+    for(int bit = 0; bit < 8; bit++)
+      crc = (crc & 0x8000) ? (uint16_t) ((crc << 1) ^ CRC_POLY) : (uint16_t) (crc << 1);
+    tables.t[0][ii] = crc;
+  }
+
+  for(int kk = 1; kk < CRC_SLICES; kk++) {
+    for(int ii = 0; ii < 256; ii++) {
+      crc = tables.t[kk - 1][ii];
+      tables.t[kk][ii] = (uint16_t) ((crc << 8) ^ tables.t[0][crc >> 8]);
+    }
+  }
+  return tables;
+}
+
+static constexpr crc_tables_t crcTables = crcMakeTables();
+
+static_assert(crcTables.t[0][1] == 0x1021, "crc table generation");
+static_assert(crcTables.t[0][255] == 0x1ef0, "crc table generation");
+
+uint16_t crc_generate_table(const uint8_t *buffer, size_t length, uint16_t startValue) {
+  const uint8_t *p = buffer;
+  const uint8_t *end = buffer + length;
+  uint16_t crc = startValue;
+
+#if CRC_SLICES == 8
+  while(end - p >= 8) {
+    crc ^= (uint16_t) ((p[0] << 8) | p[1]);
+    crc = crcTables.t[7][crc >> 8] ^ crcTables.t[6][crc & 0xFF] ^
+          crcTables.t[5][p[2]] ^ crcTables.t[4][p[3]] ^
+          crcTables.t[3][p[4]] ^ crcTables.t[2][p[5]] ^
+          crcTables.t[1][p[6]] ^ crcTables.t[0][p[7]];
+    p += 8;
+  }
+#endif
+#if CRC_SLICES >= 4
+  while(end - p >= 4) {
+    crc ^= (uint16_t) ((p[0] << 8) | p[1]);
+    crc = crcTables.t[3][crc >> 8] ^ crcTables.t[2][crc & 0xFF] ^
+          crcTables.t[1][p[2]] ^ crcTables.t[0][p[3]];
+    p += 4;
+  }
+#endif
+  while(p < end) {
+    crc = (uint16_t) ((crc << 8) ^ crcTables.t[0][(crc >> 8) ^ *p]);
+    p++;
+  }
+
+  return crc;
+}
+
+#ifdef CRC_CLMUL
+static uint16_t crcClmulResolve(const uint8_t *buffer, size_t length, uint16_t startValue);
+
+/* Starts at crcClmulResolve, which replaces itself with the path the CPU supports on the first call. */
+static std::atomic<crc_fn_t> crcClmul(crcClmulResolve);
+
+static uint16_t crcClmulResolve(const uint8_t *buffer, size_t length, uint16_t startValue) {
+  crc_fn_t fn = crcClmulSelect();
+
+  if(fn == NULL)
+    fn = crc_generate_table;
+  crcClmul.store(fn, std::memory_order_release);   /* racing threads all store the same answer */
+  return fn(buffer, length, startValue);
+}
+
+uint16_t crc_generate(const uint8_t *buffer, size_t length, uint16_t startValue) {
+  if(length < CRC_CLMUL_MIN)
+    return crc_generate_table(buffer, length, startValue);
+  return crcClmul.load(std::memory_order_acquire)(buffer, length, startValue);
+}
+#else
+uint16_t crc_generate(const uint8_t *buffer, size_t length, uint16_t startValue) {
+  return crc_generate_table(buffer, length, startValue);
+}
+#endif
@@ -1,4 +1,35 @@
+#ifndef __CHECKSUM_H
+#define __CHECKSUM_H
+
 #include <stdlib.h>
 #include <stdint.h>
 
-uint16_t crc_generate(uint8_t *buffer, size_t length, uint16_t startValue );
\ No newline at end of file
+/*
+ * CRC-16/CCITT (polynomial 0x1021, MSB first, no final XOR).  The lookup tables are generated at compile
+ * time in checksum.cpp.  CRC_SLICES selects how many bytes are folded per loop iteration: 8 is fastest,
+ * 4 halves the table flash (2 KB) and 1 is the classic 512 byte single table.
+ */
+#define CRC_POLY            0x1021
+
+#ifndef CRC_SLICES
+#define CRC_SLICES          8
+#endif
+
+/*
+ * 64-bit hosts also have a carry-less multiply path (checksum_clmul.cpp) that crc_generate picks at run
+ * time for buffers of at least CRC_CLMUL_MIN bytes when the CPU supports it.
+ */
+#if defined(__x86_64__) || (defined(__aarch64__) && defined(__linux__))
+#define CRC_CLMUL
+#define CRC_CLMUL_MIN       128   /* 64 byte minimum for the folding loop; table path wins below this */
+#endif
+
+typedef uint16_t (*crc_fn_t)(const uint8_t *buffer, size_t length, uint16_t startValue);
+
+uint16_t crc_generate(const uint8_t *buffer, size_t length, uint16_t startValue);
+uint16_t crc_generate_table(const uint8_t *buffer, size_t length, uint16_t startValue);
+#ifdef CRC_CLMUL
+crc_fn_t crcClmulSelect(void);
+#endif
+
+#endif /* __CHECKSUM_H */
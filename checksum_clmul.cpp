@@ -0,0 +1,161 @@
+/*
+ * Carry-less multiply folding for crc_generate on 64-bit hosts (PCLMULQDQ on x86-64, PMULL on AArch64).
+ *
+ * The buffer is treated as one big polynomial, MSB first.  Four 128-bit accumulators are folded forward
+ * 64 bytes at a time by multiplying each 64-bit half with x^(512+64) mod P and x^512 mod P; the products
+ * stay below 80 bits so no reduction is needed until the end.  The accumulators are then folded into one
+ * 128-bit value congruent to the data consumed so far, and that value plus the remaining tail bytes are
+ * finished with the table code.  The start value is XORed into the first two bytes, which is equivalent
+ * to seeding the shift register with it.
+ */
+#include "checksum.h"
+
+#ifdef CRC_CLMUL
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+/* x^n mod P, the folding constants */
+static constexpr uint64_t crcXPowMod(unsigned n) {
+  uint32_t r = 1;
+
+  for(unsigned ii = 0; ii < n; ii++) {
+    r <<= 1;
+    if(r & 0x10000)
+      r ^= 0x10000 | CRC_POLY;
+  }
+  return r;
+}
+
+static constexpr uint64_t K_FOLD4_HI = crcXPowMod(512 + 64);
+static constexpr uint64_t K_FOLD4_LO = crcXPowMod(512);
+static constexpr uint64_t K_FOLD1_HI = crcXPowMod(128 + 64);
+static constexpr uint64_t K_FOLD1_LO = crcXPowMod(128);
+
+#if defined(__x86_64__)
+
+#define CRC_TARGET __attribute__((target("pclmul,ssse3")))
+
+CRC_TARGET static inline __m128i crcLoad(const uint8_t *p, __m128i bswap) {
+  return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) p), bswap);
+}
+
+CRC_TARGET static inline __m128i crcFold(__m128i a, __m128i k) {
+  return _mm_xor_si128(_mm_clmulepi64_si128(a, k, 0x11), _mm_clmulepi64_si128(a, k, 0x00));
+}
+
+CRC_TARGET static uint16_t crcClmulX86(const uint8_t *buffer, size_t length, uint16_t startValue) {
+  const __m128i bswap = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+  const __m128i k4 = _mm_set_epi64x((long long) K_FOLD4_HI, (long long) K_FOLD4_LO);
+  const __m128i k1 = _mm_set_epi64x((long long) K_FOLD1_HI, (long long) K_FOLD1_LO);
+  const uint8_t *p = buffer;
+  uint8_t folded[16];
+  __m128i a0, a1, a2, a3;
+
+  a0 = _mm_xor_si128(crcLoad(p, bswap), _mm_set_epi64x((long long) ((uint64_t) startValue << 48), 0));
+  a1 = crcLoad(p + 16, bswap);
+  a2 = crcLoad(p + 32, bswap);
+  a3 = crcLoad(p + 48, bswap);
+  p += 64;
+  length -= 64;
+
+  while(length >= 64) {
+    a0 = _mm_xor_si128(crcFold(a0, k4), crcLoad(p, bswap));
+    a1 = _mm_xor_si128(crcFold(a1, k4), crcLoad(p + 16, bswap));
+    a2 = _mm_xor_si128(crcFold(a2, k4), crcLoad(p + 32, bswap));
+    a3 = _mm_xor_si128(crcFold(a3, k4), crcLoad(p + 48, bswap));
+    p += 64;
+    length -= 64;
+  }
+
+  a0 = _mm_xor_si128(crcFold(a0, k1), a1);
+  a0 = _mm_xor_si128(crcFold(a0, k1), a2);
+  a0 = _mm_xor_si128(crcFold(a0, k1), a3);
+  while(length >= 16) {
+    a0 = _mm_xor_si128(crcFold(a0, k1), crcLoad(p, bswap));
+    p += 16;
+    length -= 16;
+  }
+
+  _mm_storeu_si128((__m128i *) folded, _mm_shuffle_epi8(a0, bswap));
+  return crc_generate_table(p, length, crc_generate_table(folded, sizeof(folded), 0));
+}
+
+crc_fn_t crcClmulSelect(void) {
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3"))
+    return crcClmulX86;
+  return NULL;
+}
+
+#elif defined(__aarch64__)
+
+#define CRC_TARGET __attribute__((target("+crypto")))
+
+CRC_TARGET static inline uint64x2_t crcLoad(const uint8_t *p) {
+  uint8x16_t v = vrev64q_u8(vld1q_u8(p));
+
+  return vreinterpretq_u64_u8(vextq_u8(v, v, 8));
+}
+
+CRC_TARGET static inline uint64x2_t crcFold(uint64x2_t a, poly64_t kHi, poly64_t kLo) {
+  poly128_t hi = vmull_p64((poly64_t) vgetq_lane_u64(a, 1), kHi);
+  poly128_t lo = vmull_p64((poly64_t) vgetq_lane_u64(a, 0), kLo);
+
+  return veorq_u64(vreinterpretq_u64_p128(hi), vreinterpretq_u64_p128(lo));
+}
+
+CRC_TARGET static uint16_t crcClmulArm(const uint8_t *buffer, size_t length, uint16_t startValue) {
+  const poly64_t k4Hi = (poly64_t) K_FOLD4_HI, k4Lo = (poly64_t) K_FOLD4_LO;
+  const poly64_t k1Hi = (poly64_t) K_FOLD1_HI, k1Lo = (poly64_t) K_FOLD1_LO;
+  const uint8_t *p = buffer;
+  uint8_t folded[16];
+  uint64x2_t a0, a1, a2, a3;
+  uint8x16_t out;
+
+  a0 = veorq_u64(crcLoad(p), vcombine_u64(vcreate_u64(0), vcreate_u64((uint64_t) startValue << 48)));
+  a1 = crcLoad(p + 16);
+  a2 = crcLoad(p + 32);
+  a3 = crcLoad(p + 48);
+  p += 64;
+  length -= 64;
+
+  while(length >= 64) {
+    a0 = veorq_u64(crcFold(a0, k4Hi, k4Lo), crcLoad(p));
+    a1 = veorq_u64(crcFold(a1, k4Hi, k4Lo), crcLoad(p + 16));
+    a2 = veorq_u64(crcFold(a2, k4Hi, k4Lo), crcLoad(p + 32));
+    a3 = veorq_u64(crcFold(a3, k4Hi, k4Lo), crcLoad(p + 48));
+    p += 64;
+    length -= 64;
+  }
+
+  a0 = veorq_u64(crcFold(a0, k1Hi, k1Lo), a1);
+  a0 = veorq_u64(crcFold(a0, k1Hi, k1Lo), a2);
+  a0 = veorq_u64(crcFold(a0, k1Hi, k1Lo), a3);
+  while(length >= 16) {
+    a0 = veorq_u64(crcFold(a0, k1Hi, k1Lo), crcLoad(p));
+    p += 16;
+    length -= 16;
+  }
+
+  out = vrev64q_u8(vreinterpretq_u8_u64(a0));
+  vst1q_u8(folded, vextq_u8(out, out, 8));
+  return crc_generate_table(p, length, crc_generate_table(folded, sizeof(folded), 0));
+}
+
+crc_fn_t crcClmulSelect(void) {
+  if(getauxval(AT_HWCAP) & HWCAP_PMULL)
+    return crcClmulArm;
+  return NULL;
+}
+
+#endif
+
+#endif /* CRC_CLMUL */
@@ -0,0 +1,155 @@
+/********************************************************************************************************==*
+*                                      Reading formatter benchmark
+* Filename      : bench_format.cpp
+**********************************************************************************************************
+* Notes         : Checks uartFormatFloat against snprintf("%.*f") for random and hand-picked floats at every
+*                 supported number of decimals, then reports how many answer_t records per second each
+*                 formats, in the handlers' text and as CSV/JSON lines.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_format.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define ANSWERS             1024
+
+/* Local variables --------------------------------------------------------------------------------------*/
+static answer_t answers[ANSWERS];
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static double nowSec(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static float randomFloat(void) {
+  uint32_t bits;
+  float v;
+
+  switch(rand() % 4) {
+    case 0:   /* any bit pattern that is a finite number */
+      do {
+        bits = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+        memcpy(&v, &bits, sizeof(v));
+      } while(!isfinite(v) || (fabsf(v) >= 1.8e19f));
+      return v;
+    case 1:   /* ties at a few decimals: multiples of 1/1024 */
+      return (float) ((rand() % 200000) - 100000) / 1024.0f;
+    default:  /* what a sensor reports */
+      return (float) ((rand() % 2000000) - 1000000) / 997.0f;
+  }
+}
+
+static int check(float v, uint32_t decimals) {
+  char ours[64], ref[64];
+
+  uartFormatFloat(ours, sizeof(ours), v, decimals);
+  snprintf(ref, sizeof(ref), "%.*f", (int) decimals, v);
+  if(strcmp(ours, ref) == 0)
+    return 0;
+  printf("MISMATCH at %u decimals: %a gives %s, printf %s\n", decimals, v, ours, ref);
+  return 1;
+}
+
+static int verify(void) {
+  static const float edges[] = {0.0f, -0.0f, 0.5f, 1.5f, 2.5f, -2.5f, 0.25f, 0.125f, 0.05f, 9.9999995f, 99.5f,
+                                999999.94f, 4294967295.0f, 4294967296.0f, 1e-30f, 1.7e19f, 123456.789f};
+  uint32_t ii, decimals, count = 0;
+
+  for(ii = 0; ii < sizeof(edges) / sizeof(edges[0]); ii++) {
+    for(decimals = 0; decimals <= UART_FMT_DECIMALS_MAX; decimals++, count++) {
+      if(check(edges[ii], decimals))
+        return 1;
+    }
+  }
+
+  srand(1);
+  for(ii = 0; ii < 200000; ii++, count++) {
+    if(check(randomFloat(), ii % (UART_FMT_DECIMALS_MAX + 1)))
+      return 1;
+  }
+  printf("verified %u values against printf\n", count);
+  return 0;
+}
+
+/* The handlers' human format through snprintf, as ReadAnswer printed it before. */
+static uint32_t printfAnswer(char *buf, uint32_t size, const answer_t *a, uint32_t style, uint32_t decimals) {
+  (void) style;
+  return (uint32_t) snprintf(buf, size, "Cycle: %u\nGas: %d\nConcentration: %.*f\nTEMP: %.*f\nPRESS: %.*f\n"
+                             "REL_HUM: %.*f\nABS_HUM: %.*f\n", a->cycleCount, (int) a->flamID, (int) decimals,
+                             a->concentration, (int) decimals, a->temp, (int) decimals, a->pressure,
+                             (int) decimals, a->relHumidity, (int) decimals, a->absHumidity);
+}
+
+static uint32_t printfCsv(char *buf, uint32_t size, const answer_t *a, uint32_t style, uint32_t decimals) {
+  (void) style;
+  return (uint32_t) snprintf(buf, size, "%u,%.*f,%u,%.*f,%.*f,%.*f,%.*f\n", a->cycleCount, (int) decimals,
+                             a->concentration, a->flamID, (int) decimals, a->temp, (int) decimals, a->pressure,
+                             (int) decimals, a->relHumidity, (int) decimals, a->absHumidity);
+}
+
+static double measure(uint32_t (*fn)(char *, uint32_t, const answer_t *, uint32_t, uint32_t), uint32_t style,
+                      uint32_t decimals) {
+  static char buf[UART_FMT_LINE_MAX];
+  volatile uint32_t sink = 0;
+  double start, elapsed;
+  uint64_t records = 0;
+
+  start = nowSec();
+  do {
+    sink += fn(buf, sizeof(buf), &answers[records % ANSWERS], style, decimals);
+    records++;
+    elapsed = nowSec() - start;
+  } while((elapsed < 0.2) || (records < 1000));
+
+  return records / elapsed;
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+int main(void) {
+  static const uint32_t decimalsList[] = {2, 6};
+  char a[UART_FMT_LINE_MAX], b[UART_FMT_LINE_MAX];
+  uint32_t ii;
+
+  if(verify() != 0)
+    return 1;
+
+  srand(42);
+  for(ii = 0; ii < ANSWERS; ii++) {
+    answers[ii].cycleCount = ii * 3 + 100000;
+    answers[ii].concentration = (float) (rand() % 100000) / 1000.0f;
+    answers[ii].flamID = rand() % 8;
+    answers[ii].temp = 20.0f + (float) (rand() % 1000) / 100.0f;
+    answers[ii].pressure = 101.325f + (float) (rand() % 1000) / 1000.0f;
+    answers[ii].relHumidity = (float) (rand() % 10000) / 100.0f;
+    answers[ii].absHumidity = (float) (rand() % 3000) / 100.0f;
+  }
+
+  for(ii = 0; ii < ANSWERS; ii++) {
+    uartFormatAnswer(a, sizeof(a), &answers[ii], UART_FMT_HUMAN, 6);
+    printfAnswer(b, sizeof(b), &answers[ii], UART_FMT_HUMAN, 6);
+    if(strcmp(a, b) != 0) {
+      printf("MISMATCH in answer %u:\n%s---\n%s", ii, a, b);
+      return 1;
+    }
+  }
+
+  printf("%8s %16s %16s %16s %16s\n", "decimals", "printf human/s", "human/s", "printf csv/s", "csv/s");
+  for(ii = 0; ii < sizeof(decimalsList) / sizeof(decimalsList[0]); ii++) {
+    printf("%8u %16.0f %16.0f %16.0f %16.0f\n", decimalsList[ii],
+           measure(printfAnswer, UART_FMT_HUMAN, decimalsList[ii]),
+           measure(uartFormatAnswer, UART_FMT_HUMAN, decimalsList[ii]),
+           measure(printfCsv, UART_FMT_CSV, decimalsList[ii]),
+           measure(uartFormatAnswer, UART_FMT_CSV, decimalsList[ii]));
+  }
+  printf("json: %.0f records/s at 6 decimals\n", measure(uartFormatAnswer, UART_FMT_JSON, 6));
+  return 0;
+}
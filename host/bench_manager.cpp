@@ -0,0 +1,154 @@
+/********************************************************************************************************==*
+*                                      Multi-sensor poller benchmark
+* Filename      : bench_manager.cpp
+**********************************************************************************************************
+* Notes         : Polls CMD_ANSWER back to back on 1, 2, 4 ... up to -n simulated sensors from one
+*                 uart_manager_t thread and reports the poll rate.  Each simulator runs in its own thread
+*                 on one end of a socketpair and takes -d us to answer, as a real sensor would; with the
+*                 loop keeping up, the rate grows with the number of sensors.  The spread of polls over
+*                 the sessions (Jain's fairness index, 1 is perfectly even) shows the scheduling is fair.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_manager.h"
+#include "uart_client.h"
+#include "uart_transport_posix.h"
+#include "sensor_sim.h"
+#include <sys/socket.h>
+#include <thread>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uart_transport_t host;
+  uart_transport_t simLink;
+  sensor_sim_t sim;
+  std::thread thread;
+} bench_sensor_t;
+
+/* Local variables --------------------------------------------------------------------------------------*/
+static bench_sensor_t sensors[UART_MGR_MAX];
+static uart_manager_t mgr;
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static double nowSec(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int runStep(uint32_t count, const sensor_sim_cfg_t *cfg, double seconds) {
+  sensor_sim_cfg_t simCfg = *cfg;
+  uart_mgr_stats_t *st;
+  uint64_t polls = 0, failed = 0, latSum = 0, minPolls = UINT64_MAX, maxPolls = 0;
+  uint32_t ii, latMax = 0;
+  double start, elapsed = 0, sum = 0, sumSq = 0;
+  int fds[2], sts = 0;
+
+  if(uartManagerInit(&mgr) != 0) {
+    printf("Failed to create the event loop: %s\n", strerror(errno));
+    return 1;
+  }
+  for(ii = 0; ii < count; ii++) {
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+      printf("Failed to create socketpair: %s\n", strerror(errno));
+      return 1;
+    }
+    uartTransportPosixInit(&sensors[ii].host, fds[0]);
+    uartTransportPosixInit(&sensors[ii].simLink, fds[1]);
+    simCfg.seed = cfg->seed + ii;
+    sensorSimInit(&sensors[ii].sim, &simCfg, &sensors[ii].simLink);
+    sensors[ii].thread = std::thread(sensorSimRun, &sensors[ii].sim);
+    if(uartManagerAdd(&mgr, &sensors[ii].host, fds[0], CMD_ANSWER, 0, NULL, NULL) < 0) {
+      printf("Failed to add sensor %u: %s\n", ii, strerror(errno));
+      return 1;
+    }
+  }
+
+  start = nowSec();
+  do {
+    if(uartManagerRunOnce(&mgr, 100) < 0) {
+      printf("Event loop failed: %s\n", strerror(errno));
+      sts = 1;
+      break;
+    }
+    elapsed = nowSec() - start;
+  } while(elapsed < seconds);
+
+  for(ii = 0; ii < count; ii++) {
+    st = &mgr.sessions[ii].stats;
+    polls += st->polls;
+    failed += st->failed;
+    latSum += st->latSumUs;
+    if(st->latMaxUs > latMax)
+      latMax = st->latMaxUs;
+    if(st->polls < minPolls)
+      minPolls = st->polls;
+    if(st->polls > maxPolls)
+      maxPolls = st->polls;
+    sum += st->polls;
+    sumSq += (double) st->polls * st->polls;
+  }
+  printf("%7u %10.0f %10.0f %8llu %8llu %8llu %9.0f %9u %8.4f\n", count, polls / elapsed, polls / elapsed / count,
+         (unsigned long long) failed, (unsigned long long) minPolls, (unsigned long long) maxPolls,
+         polls ? (double) latSum / polls : 0.0, latMax, sumSq ? sum * sum / (count * sumSq) : 0.0);
+
+  uartManagerClose(&mgr);
+  for(ii = 0; ii < count; ii++) {
+    sensors[ii].sim.stop = 1;
+    sensors[ii].thread.join();
+    uartTransportPosixClose(&sensors[ii].host);
+    uartTransportPosixClose(&sensors[ii].simLink);
+  }
+  return sts;
+}
+
+static void usage(void) {
+  printf("usage: bench_manager [-n sensors] [-d delayUs] [-b baud] [-s seconds]\n"
+         "  -n  largest number of simulated sensors (default and most %u)\n"
+         "  -d  time each sensor takes to answer (default 2000)\n"
+         "  -b  emulate the line rate of this baud rate (default: as fast as the socket)\n"
+         "  -s  seconds per step (default 1)\n", UART_MGR_MAX);
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+int main(int argc, char **argv) {
+  sensor_sim_cfg_t cfg;
+  uint32_t ii, count, maxCount = UART_MGR_MAX, delay = 2000;
+  double seconds = 1.0;
+  int c;
+
+  sensorSimDefaults(&cfg);
+  while((c = getopt(argc, argv, "n:d:b:s:h")) != -1) {
+    switch(c) {
+      case 'n': maxCount = strtoul(optarg, NULL, 0); break;
+      case 'd': delay = strtoul(optarg, NULL, 0); break;
+      case 'b': cfg.baud = strtoul(optarg, NULL, 0); break;
+      case 's': seconds = atof(optarg); break;
+      default: usage(); return 1;
+    }
+  }
+  if((maxCount == 0) || (maxCount > UART_MGR_MAX)) {
+    usage();
+    return 1;
+  }
+  for(ii = 0; ii < 256; ii++)
+    cfg.delayUs[ii] = delay;
+  numOfRetries = 1;
+
+  printf("%7s %10s %10s %8s %8s %8s %9s %9s %8s\n", "sensors", "polls/s", "per sensor", "failed", "min", "max",
+         "avg us", "max us", "fairness");
+  for(count = 1;; count = (count * 2 < maxCount) ? count * 2 : maxCount) {   /* ends on maxCount itself */
+    if(runStep(count, &cfg, seconds) != 0)
+      return 1;
+    if(count == maxCount)
+      return 0;
+  }
+}
@@ -0,0 +1,142 @@
+/********************************************************************************************************==*
+*                                      Coroutine front end demo for NNTS - Linux host
+* Filename      : corodemo.cpp
+**********************************************************************************************************
+* Notes         : Polls N in-process simulated sensors from one thread.  Each sensor gets a coroutine that
+*                 reads the version, polls CMD_ANSWER and fetches the engineering data; all of them
+*                 share one executor.  The simulators run on threads of their own, standing in for the
+*                 sensors.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_coro.h"
+#include "uart_transport_posix.h"
+#include "uart_platform.h"
+#include "sensor_sim.h"
+#include <sys/socket.h>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  sensor_sim_t sim;
+  uart_transport_t simLink;
+  uart_transport_t link;
+  std::thread thread;
+} sim_port_t;
+
+typedef struct {
+  uint32_t polls;
+  uint32_t failed;
+  uint32_t engBytes;
+} port_stats_t;
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static int countSink(void *ctx, uint32_t offset, const uint8_t *data, uint16_t len) {
+  (void) ctx;
+  (void) offset;
+  (void) data;
+  (void) len;
+  return 0;
+}
+
+static uart_task_t<> pollSensor(uart_sensor_t &sensor, uint32_t id, uint32_t polls, port_stats_t *stats) {
+  uart_engdata_sink_t sink = {nullptr, countSink};
+  uint32_t ii;
+
+  auto version = co_await sensor.version();
+  if(!version) {
+    printf("sensor %u: version failed (0x%x)\n", id, version.status);
+    stats->failed++;
+    co_return;
+  }
+
+  for(ii = 0; ii < polls; ii++) {
+    auto answer = co_await sensor.answer();
+    auto temp = co_await sensor.read<CMD_TEMP>();
+    if(answer && temp)
+      stats->polls++;
+    else
+      stats->failed++;
+  }
+
+  auto eng = co_await sensor.engData(&sink);
+  if(eng)
+    stats->engBytes = eng.value.bytes;
+  else
+    stats->failed++;
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+int main(int argc, char **argv) {
+  uint32_t numPorts = 8, polls = 100, ii, total = 0, failed = 0;
+  std::vector<std::unique_ptr<sim_port_t>> ports;
+  std::vector<std::unique_ptr<uart_sensor_t>> sensors;
+  std::vector<port_stats_t> stats;
+  sensor_sim_cfg_t cfg;
+  uart_executor_t ex;
+  uint64_t start;
+  int c, fds[2];
+
+  sensorSimDefaults(&cfg);
+  while((c = getopt(argc, argv, "N:n:b:h")) != -1) {
+    switch(c) {
+      case 'N': numPorts = strtoul(optarg, NULL, 0); break;
+      case 'n': polls = strtoul(optarg, NULL, 0); break;
+      case 'b': cfg.baud = strtoul(optarg, NULL, 0); break;
+      default:
+        printf("usage: corodemo [-N sensors] [-n polls] [-b baud]\n");
+        return 1;
+    }
+  }
+  if(numPorts > UART_EVLOOP_MAX)
+    numPorts = UART_EVLOOP_MAX;
+
+  stats.resize(numPorts);
+  for(ii = 0; ii < numPorts; ii++) {
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+      printf("Failed to create socketpair: %s (%d)\n", strerror(errno), errno);
+      return 1;
+    }
+    ports.emplace_back(new sim_port_t());
+    sim_port_t *p = ports.back().get();
+    uartTransportPosixInit(&p->link, fds[0]);
+    uartTransportPosixInit(&p->simLink, fds[1]);
+    cfg.seed = ii + 1;
+    sensorSimInit(&p->sim, &cfg, &p->simLink);
+    p->thread = std::thread(sensorSimRun, &p->sim);
+
+    sensors.emplace_back(new uart_sensor_t(ex, &p->link, fds[0]));
+    sensors.back()->timeoutMs = 100 + (cfg.baud ? (REPLY_HDR_LENGTH + sizeof(uart_engdata_t)) * 10000 / cfg.baud : 0);
+    sensors.back()->retries = 3;
+    memset(&stats[ii], 0, sizeof(stats[ii]));
+  }
+
+  start = uartMicros();
+  for(ii = 0; ii < numPorts; ii++)
+    ex.spawn(pollSensor(*sensors[ii], ii, polls, &stats[ii]));
+  ex.run();
+  start = uartMicros() - start;
+
+  for(ii = 0; ii < numPorts; ii++) {
+    total += stats[ii].polls;
+    failed += stats[ii].failed;
+  }
+  printf("%u sensors, %u polls, %u failed, %.3f s, %.0f polls/s on one thread\n", numPorts, total, failed,
+         start / 1e6, total / (start / 1e6));
+
+  for(ii = 0; ii < numPorts; ii++) {
+    ports[ii]->sim.stop = 1;
+    ports[ii]->thread.join();
+    uartTransportPosixClose(&ports[ii]->link);
+    uartTransportPosixClose(&ports[ii]->simLink);
+  }
+  return failed ? 1 : 0;
+}
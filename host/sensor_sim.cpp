@@ -0,0 +1,303 @@
+/********************************************************************************************************==*
+*                                      NNTS sensor simulator
+* Filename      : sensor_sim.cpp
+**********************************************************************************************************
+* Notes         : Requests are checked with crc_generate exactly as the client builds them: the checksum
+*                 covers the header with a zeroed cksum field followed by the payload, seeded with 0xFFFF.
+*                 Replies are built the same way.
+*
+*                 CMD_ENGDATA sends the next chunk of the dump, or with ENGDATA_SEEK in the reserved
+*                 field the chunk it names, so a client can ask again for a chunk that was lost.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "sensor_sim.h"
+#include "checksum.h"
+#include "uart_wire.h"
+#include <string.h>
+#include <time.h>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define SIM_PACE_CHUNK      16    /* bytes written per pacing step when emulating the line rate */
+#define SIM_BITS_PER_BYTE   10    /* 8N1 */
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static uint32_t simRandom(sensor_sim_t *sim) {
+  /* xorshift32, good enough for noise and fault injection */
+  sim->rng ^= sim->rng << 13;
+  sim->rng ^= sim->rng >> 17;
+  sim->rng ^= sim->rng << 5;
+  return sim->rng;
+}
+
+static float simNoise(sensor_sim_t *sim, float amplitude) {
+  return amplitude * (((float) (simRandom(sim) & 0xFFFF) / 32768.0f) - 1.0f);
+}
+
+static int simChance(sensor_sim_t *sim, uint32_t ppm) {
+  return (ppm != 0) && ((simRandom(sim) % 1000000) < ppm);
+}
+
+static uint64_t simNowUs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void simSleepUntil(uint64_t us) {
+  struct timespec ts;
+
+  ts.tv_sec = us / 1000000;
+  ts.tv_nsec = (us % 1000000) * 1000;
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+    ;
+}
+
+static uint64_t simLineTimeUs(sensor_sim_t *sim, uint32_t bytes) {
+  if(sim->cfg.baud == 0)
+    return 0;
+  return (uint64_t) bytes * SIM_BITS_PER_BYTE * 1000000 / sim->cfg.baud;
+}
+
+static uint8_t simEngByte(uint32_t offset) {
+  return (uint8_t) ((offset * 31 + (offset >> 8) + 7) & 0xFF);
+}
+
+static void simMeasure(sensor_sim_t *sim) {
+  answer_t *a = &sim->answer;
+
+  a->cycleCount++;
+  a->concentration = 2.0f + simNoise(sim, 0.5f);
+  a->temp = 21.5f + simNoise(sim, 0.2f);
+  a->pressure = 101.3f + simNoise(sim, 0.05f);
+  a->relHumidity = 45.0f + simNoise(sim, 1.0f);
+  a->absHumidity = 8.5f + simNoise(sim, 0.2f);
+}
+
+static int simWrite(sensor_sim_t *sim, const uint8_t *buf, uint32_t len) {
+  uint64_t deadline = simNowUs();
+  uint32_t done = 0, n;
+
+  if(sim->cfg.baud == 0)
+    return uartTransportWrite(sim->link, buf, len) == (int) len ? 0 : -1;
+
+  while(done < len) {   /* trickle the reply out as a real UART would */
+    n = len - done;
+    if(n > SIM_PACE_CHUNK)
+      n = SIM_PACE_CHUNK;
+    deadline += simLineTimeUs(sim, n);
+    simSleepUntil(deadline);
+    if(uartTransportWrite(sim->link, buf + done, n) != (int) n)
+      return -1;
+    done += n;
+  }
+  return 0;
+}
+
+/* payload NULL: the length payload bytes are already in place behind the header in txBuf. */
+static int simReply(sensor_sim_t *sim, uint8_t cmdID, uint8_t status, const void *payload, uint16_t length) {
+  uartReplyHeader_t reply;
+  uint32_t ii, out, total = REPLY_HDR_LENGTH + length;
+
+  reply.cmdID = cmdID;
+  reply.status = status;
+  reply.length = length;
+  reply.cksum = 0;
+  uart_codec<uartReplyHeader_t>::encode(&reply, sim->txBuf);
+  if(length && (payload != NULL))
+    memcpy(&sim->txBuf[REPLY_HDR_LENGTH], payload, length);
+  reply.cksum = crc_generate(sim->txBuf, total, 0xFFFF);
+
+  if(simChance(sim, sim->cfg.corruptPpm)) {
+    reply.cksum ^= 1 << (simRandom(sim) & 15);
+    sim->stats.corruptReplies++;
+  }
+  uart_codec<uartReplyHeader_t>::encode(&reply, sim->txBuf);
+
+  if(sim->cfg.dropPpm) {
+    for(ii = 0, out = 0; ii < total; ii++) {
+      if(simChance(sim, sim->cfg.dropPpm)) {
+        sim->stats.droppedBytes++;
+        continue;
+      }
+      sim->txBuf[out++] = sim->txBuf[ii];
+    }
+    total = out;
+  }
+
+  sim->stats.txBytes += total;
+  return simWrite(sim, sim->txBuf, total);
+}
+
+template<typename T>
+static int simReplyValue(sensor_sim_t *sim, uint8_t cmdID, const T *value) {
+  uart_codec<T>::encode(value, &sim->txBuf[REPLY_HDR_LENGTH]);
+  return simReply(sim, cmdID, UART_SUCCESS, NULL, uart_codec<T>::wireSize);
+}
+
+/* Only as much of uart_engdata_t as the chunk fills goes out: the length word, then the data. */
+static int simEngData(sensor_sim_t *sim, uint16_t reserved) {
+  uint8_t *chunk = &sim->txBuf[REPLY_HDR_LENGTH];
+  uint8_t *data = &chunk[sizeof(uint32_t)];
+  uint32_t ii, n;
+
+  if(reserved & ENGDATA_SEEK) {
+    sim->engOffset = (reserved & ~ENGDATA_SEEK) * ENGDATA_CHUNKSIZE;
+    if(sim->engOffset >= sim->cfg.engDataSize) {   /* past the end: empty final chunk */
+      uartStore32(chunk, FINAL_PACKET);
+      return simReply(sim, CMD_ENGDATA, UART_SUCCESS, NULL, sizeof(uint32_t));
+    }
+  } else if(sim->engOffset >= sim->cfg.engDataSize) {
+    sim->engOffset = 0;   /* previous dump finished, start a new one */
+  }
+
+  n = sim->cfg.engDataSize - sim->engOffset;
+  if(n > ENGDATA_CHUNKSIZE)
+    n = ENGDATA_CHUNKSIZE;
+  for(ii = 0; ii < n; ii++)
+    data[ii] = simEngByte(sim->engOffset + ii);
+  sim->engOffset += n;
+
+  uartStore32(chunk, (sim->engOffset >= sim->cfg.engDataSize) ? n | FINAL_PACKET : n);
+  return simReply(sim, CMD_ENGDATA, UART_SUCCESS, NULL, (uint16_t) (sizeof(uint32_t) + n));
+}
+
+static int simHandle(sensor_sim_t *sim, uartRqstHeader_t *rqst, uint8_t *payload) {
+  uint8_t cmdID = (uint8_t) rqst->cmdID;
+
+  switch(cmdID) {
+    case CMD_ANSWER:
+      simMeasure(sim);
+      return simReplyValue(sim, cmdID, &sim->answer);
+    case CMD_MEAS:
+      if(rqst->length != 1)
+        return simReply(sim, cmdID, UART_BAD_PARAM, NULL, 0);
+      simMeasure(sim);
+      return simReply(sim, cmdID, UART_SUCCESS, NULL, 0);
+    case CMD_CONC:
+      return simReplyValue(sim, cmdID, &sim->answer.concentration);
+    case CMD_ID:
+      return simReplyValue(sim, cmdID, &sim->answer.flamID);
+    case CMD_ENGDATA:
+      return simEngData(sim, rqst->reserved);
+    case CMD_TEMP:
+      return simReplyValue(sim, cmdID, &sim->answer.temp);
+    case CMD_PRES:
+      return simReplyValue(sim, cmdID, &sim->answer.pressure);
+    case CMD_REL_HUM:
+      return simReplyValue(sim, cmdID, &sim->answer.relHumidity);
+    case CMD_ABS_HUM:
+      return simReplyValue(sim, cmdID, &sim->answer.absHumidity);
+    case CMD_STATUS:
+      return simReplyValue(sim, cmdID, &sim->status);
+    case CMD_VERSION:
+      return simReplyValue(sim, cmdID, &sim->version);
+    case CMD_SENSOR_INFO:
+      return simReplyValue(sim, cmdID, &sim->info);
+    case CMD_SHUTDOWN:
+      sim->answer.cycleCount = 0;   /* comes back up as after a reset */
+      sim->engOffset = 0;
+      return simReply(sim, cmdID, UART_SUCCESS, NULL, 0);
+    default:
+      (void) payload;
+      sim->stats.unknownCmds++;
+      return simReply(sim, cmdID, UART_UNKNOWN_CMD, NULL, 0);
+  }
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void sensorSimDefaults(sensor_sim_cfg_t *cfg) {
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->engDataSize = SIM_ENGDATA_SIZE;
+  cfg->seed = 0x4E4E5453;
+}
+
+void sensorSimInit(sensor_sim_t *sim, const sensor_sim_cfg_t *cfg, uart_transport_t *link) {
+  memset(sim, 0, sizeof(*sim));
+  sim->cfg = *cfg;
+  sim->link = link;
+  sim->rng = cfg->seed ? cfg->seed : 1;
+
+  sim->version.sw_w = 1;
+  sim->version.sw_x = 2;
+  sim->version.hw_w = 3;
+  sim->version.proto_w = 1;
+  sim->version.proto_x = 2;
+
+  strcpy((char *) sim->info.sensorName, "NNTS-SIM");
+  sim->info.sensorType = 0x4E54;
+  strcpy((char *) sim->info.calDate, "2020-01-01");
+  strcpy((char *) sim->info.mfgDate, "2019-12-01");
+
+  sim->answer.flamID = 1;
+  simMeasure(sim);
+}
+
+/*
+ * Wait up to timeoutMs for request bytes and answer every complete request received.
+ * Returns the number of requests handled or -1 when the link failed.
+ */
+int sensorSimPoll(sensor_sim_t *sim, uint32_t timeoutMs) {
+  uartRqstHeader_t rqst;
+  uint16_t rxCksum, cksum;
+  uint32_t frameLen;
+  int n, handled = 0;
+
+  n = uartTransportRead(sim->link, &sim->rxBuf[sim->rxLen], sizeof(sim->rxBuf) - sim->rxLen, timeoutMs);
+  if(n < 0)
+    return -1;
+  sim->rxLen += n;
+  sim->stats.rxBytes += n;
+  if((n > 0) && (sim->rxLineUs < simNowUs()))
+    sim->rxLineUs = simNowUs();   /* line was idle, these bytes started arriving just now */
+
+  while(sim->rxLen >= RQST_HDR_LENGTH) {
+    uart_codec<uartRqstHeader_t>::decode(sim->rxBuf, &rqst);
+    if(rqst.length > UART_MAX_DATA_SIZE - RQST_HDR_LENGTH) {   /* not a header, slip one byte */
+      memmove(sim->rxBuf, &sim->rxBuf[1], --sim->rxLen);
+      continue;
+    }
+
+    frameLen = RQST_HDR_LENGTH + rqst.length;
+    if(sim->rxLen < frameLen)
+      break;
+
+    if(sim->cfg.baud) {
+      /* the line is full duplex: requests queued behind this one keep arriving while it is handled */
+      sim->rxLineUs += simLineTimeUs(sim, frameLen);
+      simSleepUntil(sim->rxLineUs);
+    }
+    sim->stats.requests++;
+
+    rxCksum = rqst.cksum;
+    memset(&sim->rxBuf[RQST_HDR_LENGTH - sizeof(uint16_t)], 0, sizeof(uint16_t));   /* cksum is last */
+    cksum = crc_generate(sim->rxBuf, frameLen, 0xFFFF);
+    if(sim->cfg.delayUs[rqst.cmdID & 0xFF])
+      simSleepUntil(simNowUs() + sim->cfg.delayUs[rqst.cmdID & 0xFF]);
+
+    if(rxCksum != cksum) {
+      sim->stats.crcErrors++;
+      n = simReply(sim, (uint8_t) rqst.cmdID, UART_CRC_ERROR, NULL, 0);
+    } else {
+      n = simHandle(sim, &rqst, &sim->rxBuf[RQST_HDR_LENGTH]);
+    }
+
+    sim->rxLen -= frameLen;
+    memmove(sim->rxBuf, &sim->rxBuf[frameLen], sim->rxLen);
+    if(n != 0)
+      return -1;
+    handled++;
+  }
+
+  return handled;
+}
+
+int sensorSimRun(sensor_sim_t *sim) {
+  while(!sim->stop) {
+    if(sensorSimPoll(sim, 100) < 0)
+      return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,66 @@
+/********************************************************************************************************==*
+*                                      NNTS sensor simulator
+* Filename      : sensor_sim.h
+**********************************************************************************************************
+* Notes         : Host only.  Answers the request/reply protocol on a transport so the client can be
+*                 load tested without a sensor.  Processing delay, line rate, byte loss and checksum
+*                 corruption can be set to reproduce field conditions.
+*/
+
+#ifndef __SENSOR_SIM_H
+#define __SENSOR_SIM_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_proto.h"
+#include "uart_transport.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define SIM_ENGDATA_SIZE    (6 * ENGDATA_CHUNKSIZE + 100)   /* default engineering dump size */
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uint32_t delayUs[256];   /* processing delay per cmdID */
+  uint32_t baud;           /* emulated line rate in both directions, 0 = as fast as the link allows */
+  uint32_t dropPpm;        /* probability per reply byte that it is lost, in parts per million */
+  uint32_t corruptPpm;     /* probability per reply that its checksum is corrupted, in ppm */
+  uint32_t engDataSize;    /* size of the engineering data dump */
+  uint32_t seed;
+} sensor_sim_cfg_t;
+
+typedef struct {
+  uint64_t requests;
+  uint64_t crcErrors;      /* requests received with a bad checksum */
+  uint64_t unknownCmds;
+  uint64_t droppedBytes;
+  uint64_t corruptReplies;
+  uint64_t rxBytes;
+  uint64_t txBytes;
+} sensor_sim_stats_t;
+
+typedef struct {
+  sensor_sim_cfg_t cfg;
+  sensor_sim_stats_t stats;
+  uart_transport_t *link;
+  volatile int stop;
+
+  /* sensor state */
+  answer_t answer;
+  uart_version_t version;
+  uart_sensor_info_t info;
+  uint8_t status;
+  uint32_t engOffset;
+  uint32_t rng;
+  uint8_t rxBuf[UART_MAX_DATA_SIZE];
+  uint32_t rxLen;
+  uint64_t rxLineUs;       /* when the last buffered request byte is through the emulated line */
+  uint8_t txBuf[UART_MAX_DATA_SIZE];
+} sensor_sim_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void sensorSimDefaults(sensor_sim_cfg_t *cfg);
+void sensorSimInit(sensor_sim_t *sim, const sensor_sim_cfg_t *cfg, uart_transport_t *link);
+int sensorSimPoll(sensor_sim_t *sim, uint32_t timeoutMs);
+int sensorSimRun(sensor_sim_t *sim);
+
+#endif /* __SENSOR_SIM_H */
@@ -0,0 +1,106 @@
+/********************************************************************************************************==*
+*                                      NNTS sensor simulator - pty front end
+* Filename      : sensorsim.cpp
+**********************************************************************************************************
+* Notes         : Creates a pty, prints the slave path and answers requests on it until interrupted.
+*                 Point uarttest -p (or any other client) at the printed path.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "sensor_sim.h"
+#include "uart_transport_posix.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+/* Local variables --------------------------------------------------------------------------------------*/
+static sensor_sim_t sim;
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static void onSignal(int sig) {
+  (void) sig;
+  sim.stop = 1;
+}
+
+static void usage(void) {
+  printf("usage: sensorsim [-D delayUs] [-d cmdID:delayUs] [-b baud] [-l dropPpm] [-e corruptPpm]\n"
+         "                 [-E engDataBytes] [-s seed]\n"
+         "  -D  processing delay for every command\n"
+         "  -d  processing delay for one command (cmdID in hex), may be repeated\n"
+         "  -b  emulate the line rate of this baud rate\n"
+         "  -l  reply bytes lost, in parts per million\n"
+         "  -e  replies with a corrupted checksum, in parts per million\n"
+         "  -E  size of the engineering data dump\n"
+         "  -s  random seed\n");
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+int main(int argc, char **argv) {
+  sensor_sim_cfg_t cfg;
+  uart_transport_t link;
+  struct termios tio;
+  uint32_t ii, cmd, delay;
+  char *sep;
+  int c, master, slave;
+
+  sensorSimDefaults(&cfg);
+  while((c = getopt(argc, argv, "D:d:b:l:e:E:s:h")) != -1) {
+    switch(c) {
+      case 'D':
+        delay = strtoul(optarg, NULL, 0);
+        for(ii = 0; ii < 256; ii++)
+          cfg.delayUs[ii] = delay;
+        break;
+      case 'd':
+        cmd = strtoul(optarg, &sep, 16);
+        if((*sep != ':') || (cmd > 0xFF)) {
+          usage();
+          return 1;
+        }
+        cfg.delayUs[cmd] = strtoul(sep + 1, NULL, 0);
+        break;
+      case 'b': cfg.baud = strtoul(optarg, NULL, 0); break;
+      case 'l': cfg.dropPpm = strtoul(optarg, NULL, 0); break;
+      case 'e': cfg.corruptPpm = strtoul(optarg, NULL, 0); break;
+      case 'E': cfg.engDataSize = strtoul(optarg, NULL, 0); break;
+      case 's': cfg.seed = strtoul(optarg, NULL, 0); break;
+      default: usage(); return 1;
+    }
+  }
+
+  master = posix_openpt(O_RDWR | O_NOCTTY);
+  if((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0)) {
+    printf("Failed to create pty: %s (%d)\n", strerror(errno), errno);
+    return 1;
+  }
+  tcgetattr(master, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(master, TCSANOW, &tio);
+
+  /* Hold the slave open so the master does not see EIO between client runs. */
+  slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  printf("%s\n", ptsname(master));
+  fflush(stdout);
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  uartTransportPosixInit(&link, master);
+  sensorSimInit(&sim, &cfg, &link);
+  sensorSimRun(&sim);
+
+  fprintf(stderr, "requests %llu, crc errors %llu, unknown %llu, dropped bytes %llu, corrupted %llu\n",
+          (unsigned long long) sim.stats.requests, (unsigned long long) sim.stats.crcErrors,
+          (unsigned long long) sim.stats.unknownCmds, (unsigned long long) sim.stats.droppedBytes,
+          (unsigned long long) sim.stats.corruptReplies);
+
+  close(slave);
+  close(master);
+  return 0;
+}
@@ -0,0 +1,237 @@
+/********************************************************************************************************==*
+*                                      answer_t time series file tool
+* Filename      : seriestool.cpp
+**********************************************************************************************************
+* Notes         : -g fills a new file with synthetic readings at sensor resolution, one per second with a
+*                 sensor restart half way, and reads them back to check the round trip.  -i reports how
+*                 compact the file is and how fast it decodes; -t and -c print a time or cycle range as
+*                 CSV and how many blocks it took to find it.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_series_file.h"
+#include "uart_format.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define GEN_START_MS        1700000000000ull
+#define GEN_PERIOD_MS       1000
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uint64_t index;
+  uint64_t count;
+  uint32_t rng;
+} gen_t;
+
+typedef struct {
+  gen_t gen;
+  uint64_t mismatches;
+} verify_t;
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static double nowSec(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static float genNoise(gen_t *g, float span) {
+  g->rng = g->rng * 1103515245u + 12345u;
+  return span * ((float) ((g->rng >> 8) & 0xFFFF) / 32768.0f - 1.0f);
+}
+
+/* A reading rounded to step, as the sensor reports it. */
+static float genQuantize(float v, float step) {
+  return roundf(v / step) * step;
+}
+
+static void genInit(gen_t *g, uint64_t count, uint32_t seed) {
+  g->index = 0;
+  g->count = count;
+  g->rng = seed;
+}
+
+static void genNext(gen_t *g, uart_sample_t *s) {
+  answer_t *a = &s->answer;
+  uint64_t ii = g->index++;
+
+  s->timeMs = GEN_START_MS + ii * GEN_PERIOD_MS + (uint64_t) (genNoise(g, 20.0f) + 20.0f);
+  a->cycleCount = (uint32_t) ((ii < g->count / 2) ? ii + 50000 : ii - g->count / 2);
+  a->flamID = ((ii / 5000) % 3 == 2) ? 4 : 1;
+  a->concentration = genQuantize(2.0f + genNoise(g, 0.5f), 0.001f);
+  a->temp = genQuantize(21.5f + genNoise(g, 0.2f), 0.01f);
+  a->pressure = genQuantize(101.3f + genNoise(g, 0.05f), 0.001f);
+  a->relHumidity = genQuantize(45.0f + genNoise(g, 1.0f), 0.1f);
+  a->absHumidity = genQuantize(8.5f + genNoise(g, 0.2f), 0.01f);
+}
+
+static int verifySample(const uart_sample_t *s, void *arg) {
+  verify_t *v = (verify_t *) arg;
+  uart_sample_t ref;
+
+  genNext(&v->gen, &ref);
+  if((s->timeMs != ref.timeMs) || (memcmp(&s->answer, &ref.answer, sizeof(ref.answer)) != 0))
+    v->mismatches++;
+  return 0;
+}
+
+static int printSample(const uart_sample_t *s, void *arg) {
+  char line[UART_FMT_LINE_MAX];
+
+  (void) arg;
+  uartFormatAnswer(line, sizeof(line), &s->answer, UART_FMT_CSV, 3);
+  printf("%" PRIu64 ",%s", s->timeMs, line);
+  return 0;
+}
+
+/* Length of the sample as a CSV line with its time stamp. */
+static int countText(const uart_sample_t *s, void *arg) {
+  char line[UART_FMT_LINE_MAX];
+
+  *(uint64_t *) arg += uartFormatAnswer(line, sizeof(line), &s->answer, UART_FMT_CSV, 6) + 14;
+  return 0;
+}
+
+static int countSample(const uart_sample_t *s, void *arg) {
+  (void) s;
+  (*(uint64_t *) arg)++;
+  return 0;
+}
+
+static int generate(const char *path, uint64_t count, uint32_t seed) {
+  uart_series_file_t f;
+  uart_series_reader_t r;
+  uart_sample_t s;
+  verify_t v;
+  int64_t found;
+  uint64_t ii;
+
+  if((unlink(path) != 0) && (errno != ENOENT)) {
+    printf("cannot replace %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  if(uartSeriesFileOpen(&f, path) != 0) {
+    printf("cannot open %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  genInit(&v.gen, count, seed);
+  for(ii = 0; ii < count; ii++) {
+    genNext(&v.gen, &s);
+    if(uartSeriesFileAppend(&f, &s) != 0)
+      break;
+  }
+  if((uartSeriesFileClose(&f) != 0) || (ii < count)) {
+    printf("write to %s failed: %s\n", path, strerror(errno));
+    return 1;
+  }
+
+  if(uartSeriesReaderOpen(&r, path) != 0) {
+    printf("cannot map %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  genInit(&v.gen, count, seed);
+  v.mismatches = 0;
+  found = uartSeriesQueryTime(&r, 0, UINT64_MAX, verifySample, &v);
+  printf("wrote %" PRIu64 " samples in %u blocks, read back %" PRId64 ", %" PRIu64 " mismatches\n", count,
+         r.blocks, found, v.mismatches);
+  uartSeriesReaderClose(&r);
+  return ((uint64_t) found == count) && (v.mismatches == 0) ? 0 : 1;
+}
+
+static void info(uart_series_reader_t *r) {
+  uint64_t samples = 0, text = 0, bytes = (uint64_t) r->blocks * UART_SERIES_BLOCK;
+  double start, elapsed;
+
+  start = nowSec();
+  uartSeriesQueryTime(r, 0, UINT64_MAX, countSample, &samples);
+  elapsed = nowSec() - start;
+
+  printf("%u blocks, %" PRIu64 " samples, %u damaged\n", r->blocks, samples, r->badBlocks);
+  if(samples == 0)
+    return;
+  uartSeriesQueryTime(r, 0, UINT64_MAX, countText, &text);
+  printf("%.2f bytes/sample: %zu in memory, %.1f as CSV text\n", (double) bytes / samples, sizeof(uart_sample_t),
+         (double) text / samples);
+  printf("decoded %.1f M samples/s\n", samples / elapsed / 1e6);
+}
+
+static int parseRange(const char *arg, uint64_t *from, uint64_t *to) {
+  char *end;
+
+  *from = strtoull(arg, &end, 0);
+  if(*end != ':')
+    return -1;
+  *to = strtoull(end + 1, &end, 0);
+  return (*end == '\0') ? 0 : -1;
+}
+
+static void usage(void) {
+  printf("usage: seriestool -g count [-s seed] file\n"
+         "       seriestool -i file\n"
+         "       seriestool -t fromMs:toMs | -c fromCycle:toCycle file\n"
+         "  -g  write count synthetic samples to a new file and check them\n"
+         "  -s  random seed for -g\n"
+         "  -i  size and decode speed\n"
+         "  -t  samples stamped fromMs..toMs, as CSV\n"
+         "  -c  samples with a cycle count fromCycle..toCycle, as CSV\n");
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+int main(int argc, char **argv) {
+  uart_series_reader_t r;
+  uint64_t count = 0, from = 0, to = 0;
+  uint32_t seed = 1;
+  int64_t found;
+  int c, mode = 0;
+
+  while((c = getopt(argc, argv, "g:s:it:c:h")) != -1) {
+    switch(c) {
+      case 'g': mode = c; count = strtoull(optarg, NULL, 0); break;
+      case 's': seed = strtoul(optarg, NULL, 0); break;
+      case 'i': mode = c; break;
+      case 't':
+      case 'c':
+        mode = c;
+        if(parseRange(optarg, &from, &to) != 0) {
+          usage();
+          return 1;
+        }
+        break;
+      default: usage(); return 1;
+    }
+  }
+  if((mode == 0) || (optind != argc - 1)) {
+    usage();
+    return 1;
+  }
+
+  if(mode == 'g')
+    return generate(argv[optind], count, seed);
+
+  if(uartSeriesReaderOpen(&r, argv[optind]) != 0) {
+    printf("cannot map %s: %s\n", argv[optind], strerror(errno));
+    return 1;
+  }
+  if(mode == 'i') {
+    info(&r);
+  } else {
+    printf("timeMs,%s", UART_FMT_ANSWER_CSV_HEADER);
+    if(mode == 't')
+      found = uartSeriesQueryTime(&r, from, to, printSample, NULL);
+    else
+      found = uartSeriesQueryCycle(&r, (uint32_t) from, (uint32_t) to, printSample, NULL);
+    fprintf(stderr, "%" PRId64 " samples, %u of %u blocks decoded\n", found, r.decoded, r.blocks);
+  }
+  uartSeriesReaderClose(&r);
+  return 0;
+}
@@ -0,0 +1,335 @@
+/********************************************************************************************************==*
+*                                      Coroutine front end for NNTS
+* Filename      : uart_coro.h
+**********************************************************************************************************
+* Notes         : Host only, C++20.  Wraps the asynchronous engine so a transaction reads as
+*
+*                   uart_result_t<float> t = co_await sensor.read<CMD_TEMP>();
+*
+*                 Every sensor has its own engine; one uart_executor_t runs the epoll loop for all of them
+*                 on the calling thread and resumes coroutines as their replies come in.  A completion
+*                 never resumes a coroutine directly, it queues it on the executor, so a coroutine always
+*                 runs from the executor's loop and never from inside the engine.
+*
+*                 No exceptions: results carry the protocol status next to the value.
+*/
+
+#ifndef __UART_CORO_H
+#define __UART_CORO_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <utility>
+#include "uart_async.h"
+#include "uart_evloop.h"
+#include "uart_platform.h"
+#include "uart_client.h"
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+template<typename T>
+struct uart_result_t {
+  uint32_t status;   /* UART_SUCCESS, the sensor's error status or UART_LOCAL_ERROR */
+  T value;
+
+  explicit operator bool() const { return status == UART_SUCCESS; }
+};
+
+class uart_executor_t;
+
+/* Coroutine return type.  Lazy: the body starts when the task is awaited or spawned. */
+template<typename T = void>
+class uart_task_t {
+public:
+  struct promise_type;
+  typedef std::coroutine_handle<promise_type> handle_t;
+
+  struct promise_base {
+    std::coroutine_handle<> continuation;
+    uart_executor_t *detachedOn = nullptr;   /* set by uart_executor_t::spawn */
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  template<typename U>
+  struct promise_value : promise_base {
+    U value{};
+    void return_value(U v) { value = std::move(v); }
+  };
+
+  struct promise_void : promise_base {
+    void return_void() {}
+  };
+
+  struct final_awaiter {
+    bool await_ready() noexcept { return false; }
+    template<typename P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept;
+    void await_resume() noexcept {}
+  };
+
+  struct promise_type : std::conditional_t<std::is_void_v<T>, promise_void, promise_value<T>> {
+    uart_task_t get_return_object() { return uart_task_t(handle_t::from_promise(*this)); }
+    final_awaiter final_suspend() noexcept { return {}; }
+  };
+
+  uart_task_t(uart_task_t &&other) noexcept : h(std::exchange(other.h, nullptr)) {}
+  uart_task_t(const uart_task_t &) = delete;
+  ~uart_task_t() {
+    if(h)
+      h.destroy();
+  }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+    h.promise().continuation = caller;
+    return h;
+  }
+  T await_resume() {
+    if constexpr(!std::is_void_v<T>)
+      return std::move(h.promise().value);
+  }
+
+  handle_t release() { return std::exchange(h, nullptr); }
+
+private:
+  explicit uart_task_t(handle_t handle) : h(handle) {}
+  handle_t h;
+};
+
+/* Single-threaded executor: an epoll loop over the sensors' engines plus a queue of ready coroutines. */
+class uart_executor_t {
+public:
+  uart_executor_t() { uartEvLoopInit(&loop); }
+  ~uart_executor_t() { uartEvLoopClose(&loop); }
+
+  int add(uart_async_t *a, int fd) { return uartEvLoopAdd(&loop, a, fd); }
+  void post(std::coroutine_handle<> h) { ready.push_back(h); }
+
+  /* Run task to completion in the background; the executor owns it from here. */
+  void spawn(uart_task_t<void> task) {
+    auto h = task.release();
+    h.promise().detachedOn = this;
+    live++;
+    post(h);
+  }
+
+  void taskDone() { live--; }
+
+  /* Resume everything that is ready, then wait up to maxWaitMs for I/O.  Returns -1 if epoll failed. */
+  int runOnce(uint32_t maxWaitMs) {
+    while(!ready.empty()) {
+      std::coroutine_handle<> h = ready.front();
+      ready.pop_front();
+      h.resume();
+    }
+    if(live == 0)
+      return 0;
+    return uartEvLoopRunOnce(&loop, maxWaitMs);
+  }
+
+  /* Until every spawned task has finished.  Returns 0, or -1 if epoll failed. */
+  int run() {
+    while((live != 0) || !ready.empty()) {
+      if(runOnce(1000) < 0)
+        return -1;
+    }
+    return 0;
+  }
+
+private:
+  uart_evloop_t loop;
+  std::deque<std::coroutine_handle<>> ready;
+  uint32_t live = 0;
+};
+
+template<typename T>
+template<typename P>
+std::coroutine_handle<> uart_task_t<T>::final_awaiter::await_suspend(std::coroutine_handle<P> h) noexcept {
+  std::coroutine_handle<> next = h.promise().continuation;
+  uart_executor_t *owner = h.promise().detachedOn;
+
+  if(owner != nullptr) {   /* spawned: nobody awaits the result */
+    owner->taskDone();
+    h.destroy();
+  }
+  return next ? next : std::noop_coroutine();
+}
+
+/* One transaction on the wire; lives in the awaiting coroutine's frame until its callback ran. */
+class uart_transaction_t {
+public:
+  uart_transaction_t(uart_executor_t &ex, uart_async_t *a, uint8_t cmdID, uint16_t reserved,
+                     const void *tx, uint16_t txLen, void *rx, uint16_t rxLen, uint32_t timeoutMs, uint32_t retries)
+    : ex(ex), async(a) {
+    uartAsyncRequest(&req, cmdID, (uint8_t *) rx, rxLen, onDone, this);
+    req.reserved = reserved;
+    req.txPayload = (uint8_t *) tx;
+    req.txLen = txLen;
+    req.timeoutMs = timeoutMs;
+    req.retries = retries;
+  }
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> h) {
+    waiter = h;
+    uartAsyncSubmit(async, &req);
+  }
+  uint32_t await_resume() const noexcept { return req.status; }
+  uint16_t replyLen() const { return req.replyLen; }
+  uint32_t attempts() const { return req.attempt; }   /* retries it took */
+
+private:
+  static void onDone(void *arg, uart_request_t *) {
+    uart_transaction_t *t = (uart_transaction_t *) arg;
+
+    t->ex.post(t->waiter);
+  }
+
+  uart_executor_t &ex;
+  uart_async_t *async;
+  uart_request_t req;
+  std::coroutine_handle<> waiter;
+};
+
+/*
+ * A sensor on one link.  timeoutMs and retries apply to every transaction started afterwards; timeoutMs 0
+ * adapts the timeout of each attempt to the command's round trip time, see uart_rto.h.
+ */
+class uart_sensor_t {
+public:
+  uart_sensor_t(uart_executor_t &ex, uart_transport_t *link, int fd) : ex(ex) {
+    uartAsyncInit(&async, link);
+    ex.add(&async, fd);
+  }
+
+  /* Types and sizes come from UART_CMD_LIST, see uart_cmdtab.h. */
+  template<uint8_t CMD>
+  uart_task_t<uart_result_t<typename uart_cmd_desc<CMD>::reply_t>> read() {
+    typedef uart_cmd_desc<CMD> desc;
+    static_assert(desc::reqSize == 0 && desc::resSize != 0, "not a read command");
+    uart_result_t<typename desc::reply_t> r{};
+    uint8_t buf[desc::resSize];
+
+    r.status = co_await transact(CMD, 0, nullptr, 0, buf, desc::resSize);
+    if(r.status == UART_SUCCESS)
+      uart_codec<typename desc::reply_t>::decode(buf, &r.value);
+    co_return r;
+  }
+
+  template<uint8_t CMD>
+  uart_task_t<uint32_t> write(typename uart_cmd_desc<CMD>::request_t value) {
+    typedef uart_cmd_desc<CMD> desc;
+    static_assert(desc::resSize == 0, "not a write command");
+    uint8_t buf[desc::reqSize];
+
+    uart_codec<typename desc::request_t>::encode(&value, buf);
+    co_return co_await transact(CMD, 0, buf, desc::reqSize, nullptr, 0);
+  }
+
+  template<uint8_t CMD>
+  uart_task_t<uint32_t> write() {
+    static_assert(uart_cmd_desc<CMD>::reqSize == 0, "command takes an argument");
+    static_assert(uart_cmd_desc<CMD>::resSize == 0, "not a write command");
+    co_return co_await transact(CMD, 0, nullptr, 0, nullptr, 0);
+  }
+
+  uart_task_t<uart_result_t<answer_t>> answer() { return read<CMD_ANSWER>(); }
+  uart_task_t<uart_result_t<uart_version_t>> version() { return read<CMD_VERSION>(); }
+  uart_task_t<uart_result_t<uart_sensor_info_t>> sensorInfo() { return read<CMD_SENSOR_INFO>(); }
+
+  /*
+   * Whole engineering data dump into sink, chunk by chunk.  With engSeek a failed chunk is asked for again
+   * by index.  Without it the sensor has moved on by then: the dump is run out and started over, up to
+   * retries times, as uartEngDataDownload() does.
+   */
+  uart_task_t<uart_result_t<uart_engdata_stats_t>> engData(uart_engdata_sink_t *sink) {
+    uart_result_t<uart_engdata_stats_t> r{};
+    uint8_t wire[uart_codec<uart_engdata_t>::wireSize];
+    uart_engdata_t chunk;
+    uint64_t start = uartMicros();
+    uint32_t index = 0, len, restarts = 0;
+
+    for(;;) {
+      if(engSeek && (index > ENGDATA_SEEK_MAX)) {
+        r.status = UART_LOCAL_ERROR;
+        break;
+      }
+      uart_transaction_t t = transact(CMD_ENGDATA, engSeek ? (uint16_t) (ENGDATA_SEEK | index) : 0, nullptr, 0,
+                                      wire, sizeof(wire), engSeek ? retries : 0);
+
+      r.status = co_await t;
+      uart_codec<uart_engdata_t>::decode(wire, &chunk);
+      r.value.retries += t.attempts();
+      len = chunk.length & ~FINAL_PACKET;
+      if((r.status == UART_SUCCESS) && (len > ENGDATA_CHUNKSIZE))
+        r.status = UART_LOCAL_ERROR;
+      if((r.status != UART_SUCCESS) && !engSeek && (restarts++ < retries) &&
+         (co_await engDataRunOut(wire) == UART_SUCCESS)) {
+        r.value.restarts++;
+        r.value.bytes = 0;
+        r.value.chunks = 0;
+        index = 0;
+        continue;
+      }
+      if(r.status != UART_SUCCESS)
+        break;
+      if(sink->write(sink->ctx, r.value.bytes, chunk.data, (uint16_t) len) != 0) {
+        r.status = UART_LOCAL_ERROR;
+        break;
+      }
+      r.value.bytes += len;
+      r.value.chunks++;
+      index++;
+      if(chunk.length & FINAL_PACKET)
+        break;
+    }
+    r.value.elapsedUs = (uint32_t) (uartMicros() - start);
+    co_return r;
+  }
+
+  uart_async_t *engine() { return &async; }
+
+  uint32_t timeoutMs = 0;
+  uint32_t retries = 0;
+  uint32_t engSeek = 0;   /* the sensor honours ENGDATA_SEEK, see engDataSeek in uart_client.h */
+
+private:
+  /*
+   * Read on to a good final chunk, so the next request starts the dump over.  A bad chunk may have been
+   * the final one, so that just means reading on, up to retries bad chunks.
+   */
+  uart_task_t<uint32_t> engDataRunOut(uint8_t *wire) {
+    uart_engdata_t chunk;
+    uint32_t failed = 0;
+
+    for(;;) {
+      if(co_await transact(CMD_ENGDATA, 0, nullptr, 0, wire, uart_codec<uart_engdata_t>::wireSize, 0) ==
+         UART_SUCCESS) {
+        uart_codec<uart_engdata_t>::decode(wire, &chunk);
+        if(chunk.length & FINAL_PACKET)
+          co_return UART_SUCCESS;
+      } else if(failed++ >= retries) {
+        co_return UART_LOCAL_ERROR;
+      }
+    }
+  }
+
+  uart_transaction_t transact(uint8_t cmdID, uint16_t reserved, const void *tx, uint16_t txLen,
+                              void *rx, uint16_t rxLen) {
+    return transact(cmdID, reserved, tx, txLen, rx, rxLen, retries);
+  }
+
+  uart_transaction_t transact(uint8_t cmdID, uint16_t reserved, const void *tx, uint16_t txLen,
+                              void *rx, uint16_t rxLen, uint32_t tries) {
+    return uart_transaction_t(ex, &async, cmdID, reserved, tx, txLen, rx, rxLen, timeoutMs, tries);
+  }
+
+  uart_executor_t &ex;
+  uart_async_t async;
+};
+
+#endif /* __UART_CORO_H */
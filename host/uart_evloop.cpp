@@ -0,0 +1,72 @@
+/********************************************************************************************************==*
+*                                      epoll driver for asynchronous requests
+* Filename      : uart_evloop.cpp
+**********************************************************************************************************
+* Notes         : Level triggered: an engine that left bytes unread is simply woken again.  Deadlines are
+*                 not timerfds; the loop sleeps no longer than the nearest one and then lets every engine
+*                 check its own.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_evloop.h"
+#include <sys/epoll.h>
+#include <errno.h>
+#include <unistd.h>
+
+/* Functions --------------------------------------------------------------------------------------------*/
+/* Returns 0, or -1 with errno set. */
+int uartEvLoopInit(uart_evloop_t *l) {
+  l->count = 0;
+  l->epfd = epoll_create1(EPOLL_CLOEXEC);
+  return (l->epfd < 0) ? -1 : 0;
+}
+
+/* Watch fd, the descriptor behind a's transport.  Returns 0, or -1 with errno set. */
+int uartEvLoopAdd(uart_evloop_t *l, uart_async_t *a, int fd) {
+  struct epoll_event ev;
+
+  if(l->count == UART_EVLOOP_MAX) {
+    errno = ENOSPC;
+    return -1;
+  }
+  ev.events = EPOLLIN;
+  ev.data.ptr = a;
+  if(epoll_ctl(l->epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+    return -1;
+  l->engines[l->count++] = a;
+  return 0;
+}
+
+/*
+ * Wait up to maxWaitMs for input or the nearest deadline and handle what is due.  Returns the number of
+ * engines that had input, or -1 with errno set.
+ */
+int uartEvLoopRunOnce(uart_evloop_t *l, uint32_t maxWaitMs) {
+  struct epoll_event events[UART_EVLOOP_MAX];
+  uint32_t ii, wait = maxWaitMs, next;
+  int n, timeout;
+
+  for(ii = 0; ii < l->count; ii++) {
+    next = uartAsyncNextTimeoutMs(l->engines[ii]);
+    if(next < wait)
+      wait = next;
+  }
+  timeout = (wait == UART_WAIT_FOREVER) ? -1 : (int) wait;
+
+  n = epoll_wait(l->epfd, events, UART_EVLOOP_MAX, timeout);
+  if(n < 0)
+    return (errno == EINTR) ? 0 : -1;
+
+  for(ii = 0; ii < (uint32_t) n; ii++)
+    uartAsyncOnReadable((uart_async_t *) events[ii].data.ptr);
+  for(ii = 0; ii < l->count; ii++)
+    uartAsyncOnTimer(l->engines[ii]);
+  return n;
+}
+
+void uartEvLoopClose(uart_evloop_t *l) {
+  close(l->epfd);
+  l->epfd = -1;
+  l->count = 0;
+}
@@ -0,0 +1,33 @@
+/********************************************************************************************************==*
+*                                      epoll driver for asynchronous requests
+* Filename      : uart_evloop.h
+**********************************************************************************************************
+* Notes         : Host only.  One loop serves any number of engines, each on its own file descriptor.
+*/
+
+#ifndef __UART_EVLOOP_H
+#define __UART_EVLOOP_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_async.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#ifndef UART_EVLOOP_MAX
+#define UART_EVLOOP_MAX     64    /* engines per loop */
+#endif
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  int epfd;
+  uint32_t count;
+  uart_async_t *engines[UART_EVLOOP_MAX];
+} uart_evloop_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+int uartEvLoopInit(uart_evloop_t *l);
+int uartEvLoopAdd(uart_evloop_t *l, uart_async_t *a, int fd);
+int uartEvLoopRunOnce(uart_evloop_t *l, uint32_t maxWaitMs);
+void uartEvLoopClose(uart_evloop_t *l);
+
+#endif /* __UART_EVLOOP_H */
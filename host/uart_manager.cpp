@@ -0,0 +1,138 @@
+/********************************************************************************************************==*
+*                                      Multi-sensor poller for NNTS
+* Filename      : uart_manager.cpp
+**********************************************************************************************************
+* Notes         : The schedule is kept in absolute time: a poll that went out late does not move the ones
+*                 after it, only a whole skipped period does.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_manager.h"
+#include "uart_client.h"
+#include "uart_platform.h"
+#include <errno.h>
+#include <string.h>
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static void mgrDone(void *arg, uart_request_t *req) {
+  uart_mgr_session_t *s = (uart_mgr_session_t *) arg;
+  uint32_t latUs = (uint32_t) (uartMicros() - s->sentUs);
+
+  s->busy = 0;
+  s->stats.polls++;
+  if(req->status != UART_SUCCESS)
+    s->stats.failed++;
+  s->stats.latSumUs += latUs;
+  if(latUs > s->stats.latMaxUs)
+    s->stats.latMaxUs = latUs;
+  if(s->periodMs == 0)
+    s->dueUs = uartMicros();
+
+  if(s->done != NULL)
+    s->done(s->arg, s, req->status);
+}
+
+static void mgrSend(uart_mgr_session_t *s, uint64_t now) {
+  uint64_t periodUs = (uint64_t) s->periodMs * 1000, lag = now - s->dueUs, skipped;
+
+  if(lag > s->stats.lagMaxUs)
+    s->stats.lagMaxUs = (uint32_t) lag;
+  if(periodUs) {
+    skipped = lag / periodUs;
+    s->stats.overruns += skipped;
+    s->dueUs += (skipped + 1) * periodUs;
+  }
+  s->busy = 1;
+  s->sentUs = now;
+  s->req.timeoutMs = s->session.rxTimeout;   /* 0: the estimate for cmdID at each attempt */
+  s->req.retries = s->session.numOfRetries;
+  uartAsyncSubmit(&s->async, &s->req);
+}
+
+/* Send every idle session that is due, round robin.  Returns ms until the next one is due. */
+static uint32_t mgrDispatch(uart_manager_t *m) {
+  uart_mgr_session_t *s;
+  uint64_t now = uartMicros(), next = UINT64_MAX;
+  uint32_t ii;
+
+  for(ii = 0; ii < m->count; ii++) {
+    s = &m->sessions[(m->first + ii) % m->count];
+    if(s->busy)
+      continue;
+    if(s->dueUs <= now)
+      mgrSend(s, now);
+    else if(s->dueUs < next)
+      next = s->dueUs;
+  }
+  if(m->count)
+    m->first = (m->first + 1) % m->count;
+
+  if(next == UINT64_MAX)
+    return UART_WAIT_FOREVER;
+  return (uint32_t) ((next - now + 999) / 1000);
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+/* Returns 0, or -1 with errno set. */
+int uartManagerInit(uart_manager_t *m) {
+  m->count = 0;
+  m->first = 0;
+  return uartEvLoopInit(&m->loop);
+}
+
+/*
+ * Poll cmdID on link, whose descriptor is fd, every periodMs from now on.  The reply must fit
+ * UART_MGR_REPLY_MAX.  The session starts with the settings in force now (uartSessionInit); change
+ * sessions[index].session.rxTimeout and numOfRetries to give this sensor its own.
+ * Returns the session index, or -1 with errno set.
+ */
+int uartManagerAdd(uart_manager_t *m, uart_transport_t *link, int fd, uint8_t cmdID, uint32_t periodMs,
+                   uart_mgr_cb_t done, void *arg) {
+  uart_cmd_t *cmd = uartFindCmd(cmdID);
+  uart_mgr_session_t *s;
+
+  if((cmd == NULL) || (cmd->req_size != 0) || (cmd->res_size > UART_MGR_REPLY_MAX)) {
+    errno = EINVAL;
+    return -1;
+  }
+  if(m->count == UART_MGR_MAX) {
+    errno = ENOSPC;
+    return -1;
+  }
+
+  s = &m->sessions[m->count];
+  memset(&s->stats, 0, sizeof(s->stats));
+  uartSessionInit(&s->session, link);
+  uartAsyncInit(&s->async, link);
+  if(uartEvLoopAdd(&m->loop, &s->async, fd) != 0)
+    return -1;
+  uartAsyncRequest(&s->req, cmdID, s->reply, cmd->res_size, mgrDone, s);
+  s->index = m->count;
+  s->periodMs = periodMs;
+  s->dueUs = uartMicros();
+  s->busy = 0;
+  s->done = done;
+  s->arg = arg;
+  return (int) m->count++;
+}
+
+/*
+ * Send what is due, then wait up to maxWaitMs for replies, deadlines or the next due poll and handle
+ * them.  Returns the number of sessions that had input, or -1 with errno set.
+ */
+int uartManagerRunOnce(uart_manager_t *m, uint32_t maxWaitMs) {
+  uint32_t wait = mgrDispatch(m);
+
+  return uartEvLoopRunOnce(&m->loop, (wait < maxWaitMs) ? wait : maxWaitMs);
+}
+
+/* Fail what is still queued and stop watching the links; the links themselves stay open. */
+void uartManagerClose(uart_manager_t *m) {
+  uint32_t ii;
+
+  for(ii = 0; ii < m->count; ii++)
+    uartAsyncCancelAll(&m->sessions[ii].async);
+  uartEvLoopClose(&m->loop);
+  m->count = 0;
+}
@@ -0,0 +1,75 @@
+/********************************************************************************************************==*
+*                                      Multi-sensor poller for NNTS
+* Filename      : uart_manager.h
+**********************************************************************************************************
+* Notes         : Host only.  Polls one command on each of up to UART_MGR_MAX sensors from a single thread:
+*                 every session is a uart_session_t for the sensor's link and settings with an
+*                 asynchronous engine (uart_async.h) on that link, and one epoll loop (uart_evloop.h) serves
+*                 them all, so a slow or silent sensor only holds up itself.  The engine has its own parser
+*                 and does not take the session lock, so the blocking uartSession* calls must not be used on
+*                 a session while the manager polls it.
+*
+*                 A session polls every periodMs, on a fixed schedule, or back to back with periodMs 0.
+*                 Only one poll per session is out at a time; periods that pass while it is still
+*                 running are skipped and counted as overruns.  Due sessions are sent in round-robin
+*                 order starting one further each pass, so no sensor is always served first.  Each poll
+*                 takes its timeout and retries from session.rxTimeout and session.numOfRetries as they
+*                 are when it is sent, so they can be set per sensor after uartManagerAdd().
+*/
+
+#ifndef __UART_MANAGER_H
+#define __UART_MANAGER_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_evloop.h"
+#include "uart_client.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define UART_MGR_MAX        UART_EVLOOP_MAX
+#define UART_MGR_REPLY_MAX  64    /* largest reply a session can poll */
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+struct uart_mgr_session;
+/* Called when a poll completed; the reply is in s->reply if status is UART_SUCCESS. */
+typedef void (*uart_mgr_cb_t)(void *arg, struct uart_mgr_session *s, uint32_t status);
+
+typedef struct {
+  uint64_t polls;           /* completed, failed ones included */
+  uint64_t failed;
+  uint64_t overruns;        /* periods skipped because the poll before was still running */
+  uint64_t latSumUs;        /* sent to completed, retries included */
+  uint32_t latMaxUs;
+  uint32_t lagMaxUs;        /* longest wait from due to sent */
+} uart_mgr_stats_t;
+
+typedef struct uart_mgr_session {
+  uart_session_t session;   /* link and per-sensor settings */
+  uart_async_t async;
+  uart_request_t req;
+  uint8_t reply[UART_MGR_REPLY_MAX];
+  uint32_t index;
+  uint32_t periodMs;
+  uint64_t dueUs;
+  uint64_t sentUs;
+  int busy;
+  uart_mgr_cb_t done;
+  void *arg;
+  uart_mgr_stats_t stats;
+} uart_mgr_session_t;
+
+typedef struct {
+  uart_evloop_t loop;
+  uint32_t count;
+  uint32_t first;           /* session sent first on the next pass */
+  uart_mgr_session_t sessions[UART_MGR_MAX];
+} uart_manager_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+int uartManagerInit(uart_manager_t *m);
+int uartManagerAdd(uart_manager_t *m, uart_transport_t *link, int fd, uint8_t cmdID, uint32_t periodMs,
+                   uart_mgr_cb_t done, void *arg);
+int uartManagerRunOnce(uart_manager_t *m, uint32_t maxWaitMs);
+void uartManagerClose(uart_manager_t *m);
+
+#endif /* __UART_MANAGER_H */
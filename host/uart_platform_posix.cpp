@@ -0,0 +1,48 @@
+/********************************************************************************************************==*
+*                                      Platform services for NNTS - Linux host
+* Filename      : uart_platform_posix.cpp
+**********************************************************************************************************
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_platform.h"
+#include "uart_transport.h"
+#include <chrono>
+#include <errno.h>
+#include <time.h>
+
+/* Functions --------------------------------------------------------------------------------------------*/
+uint64_t uartMicros(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void uartEventSignal(uart_event_t *ev) {
+  std::lock_guard<std::mutex> guard(ev->lock);
+
+  ev->set = 1;
+  ev->cond.notify_one();
+}
+
+int uartEventWait(uart_event_t *ev, uint32_t timeoutMs) {
+  std::unique_lock<std::mutex> guard(ev->lock);
+
+  if(timeoutMs == UART_WAIT_FOREVER)
+    ev->cond.wait(guard, [ev] { return ev->set != 0; });
+  else if(!ev->cond.wait_for(guard, std::chrono::milliseconds(timeoutMs), [ev] { return ev->set != 0; }))
+    return 0;
+  ev->set = 0;
+  return 1;
+}
+
+void uartSleepMs(uint32_t ms) {
+  struct timespec ts;
+
+  ts.tv_sec = ms / 1000;
+  ts.tv_nsec = (long) (ms % 1000) * 1000000;
+  while((nanosleep(&ts, &ts) != 0) && (errno == EINTR))
+    ;
+}
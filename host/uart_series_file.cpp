@@ -0,0 +1,247 @@
+/********************************************************************************************************==*
+*                                      answer_t time series files for NNTS
+* Filename      : uart_series_file.cpp
+**********************************************************************************************************
+* Notes         : A torn block at the end of the file, left by a crash during a write, is cut off when the
+*                 file is opened again for appending and ignored by the reader.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_series_file.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define FILE_MAGIC_LEN      8
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static int writeAll(int fd, const uint8_t *buf, size_t len, off_t offset) {
+  ssize_t n;
+
+  while(len) {
+    n = pwrite(fd, buf, len, offset);
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+      return -1;
+    }
+    buf += n;
+    len -= n;
+    offset += n;
+  }
+  return 0;
+}
+
+static int checkFileHeader(const uint8_t *hdr) {
+  if((memcmp(hdr, UART_SERIES_FILE_MAGIC, FILE_MAGIC_LEN) != 0) ||
+     (uartLoad32(&hdr[FILE_MAGIC_LEN]) != UART_SERIES_BLOCK) ||
+     (uartLoad32(&hdr[FILE_MAGIC_LEN + 4]) != UART_SERIES_FILE_VERSION)) {
+    errno = EINVAL;
+    return -1;
+  }
+  return 0;
+}
+
+static off_t blockOffset(uint32_t index) {
+  return (off_t) (index + 1) * UART_SERIES_BLOCK;
+}
+
+static int writeBlock(uart_series_file_t *f) {
+  if(writeAll(f->fd, f->block, UART_SERIES_BLOCK, blockOffset(f->blocks)) != 0)
+    return -1;
+  f->blocks++;
+  return 0;
+}
+
+/* Last time stamp of block index, or of the nearest readable block before it; 0 if there is none. */
+static uint64_t blockLastTime(const uart_series_reader_t *r, uint32_t index) {
+  uart_series_hdr_t hdr;
+
+  for(index++; index--;) {
+    if(uartSeriesHeader(uartSeriesReaderBlock(r, index), &hdr) == 0)
+      return hdr.lastTimeMs;
+  }
+  return 0;
+}
+
+/* Decode block index and pass on its samples that pass the filter.  Returns 1 if cb ended the query. */
+static int queryBlock(uart_series_reader_t *r, uint32_t index, uint64_t from, uint64_t to, int byCycle,
+                      uart_series_cb_t cb, void *arg, int64_t *found) {
+  uart_sample_t samples[UART_SERIES_MAX_SAMPLES];
+  uart_series_hdr_t hdr;
+  uint64_t key;
+  int ii, n;
+
+  if((n = uartSeriesDecode(uartSeriesReaderBlock(r, index), &hdr, samples)) < 0) {
+    r->badBlocks++;
+    return 0;
+  }
+  r->decoded++;
+  for(ii = 0; ii < n; ii++) {
+    key = byCycle ? samples[ii].answer.cycleCount : samples[ii].timeMs;
+    if((key < from) || (key > to))
+      continue;
+    (*found)++;
+    if(cb(&samples[ii], arg) != 0)
+      return 1;
+  }
+  return 0;
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+/* Open path for appending, creating it if needed.  Returns 0, or -1 with errno set. */
+int uartSeriesFileOpen(uart_series_file_t *f, const char *path) {
+  struct stat st;
+
+  if((f->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) < 0)
+    return -1;
+  if(fstat(f->fd, &st) != 0)
+    goto fail;
+
+  if(st.st_size < UART_SERIES_BLOCK) {
+    memset(f->block, 0, sizeof(f->block));
+    memcpy(f->block, UART_SERIES_FILE_MAGIC, FILE_MAGIC_LEN);
+    uartStore32(&f->block[FILE_MAGIC_LEN], UART_SERIES_BLOCK);
+    uartStore32(&f->block[FILE_MAGIC_LEN + 4], UART_SERIES_FILE_VERSION);
+    if(writeAll(f->fd, f->block, UART_SERIES_BLOCK, 0) != 0)
+      goto fail;
+    st.st_size = UART_SERIES_BLOCK;
+  } else if((pread(f->fd, f->block, UART_SERIES_BLOCK, 0) != UART_SERIES_BLOCK) || (checkFileHeader(f->block) != 0)) {
+    goto fail;
+  }
+
+  f->blocks = (uint32_t) (st.st_size / UART_SERIES_BLOCK - 1);
+  if((st.st_size % UART_SERIES_BLOCK) && (ftruncate(f->fd, blockOffset(f->blocks)) != 0))
+    goto fail;
+  f->samples = 0;
+  uartSeriesInit(&f->w);
+  return 0;
+
+fail:
+  close(f->fd);
+  f->fd = -1;
+  return -1;
+}
+
+/* Returns 0, or -1 with errno set if a full block could not be written. */
+int uartSeriesFileAppend(uart_series_file_t *f, const uart_sample_t *s) {
+  f->samples++;
+  if(uartSeriesAppend(&f->w, s, f->block))
+    return writeBlock(f);
+  return 0;
+}
+
+/* Write the open block, even if partly filled, and close.  Returns 0, or -1 with errno set. */
+int uartSeriesFileClose(uart_series_file_t *f) {
+  int ret = 0;
+
+  if(uartSeriesFlush(&f->w, f->block))
+    ret = writeBlock(f);
+  if(close(f->fd) != 0)
+    ret = -1;
+  f->fd = -1;
+  return ret;
+}
+
+/* Map path for reading.  Returns 0, or -1 with errno set. */
+int uartSeriesReaderOpen(uart_series_reader_t *r, const char *path) {
+  struct stat st;
+  void *map;
+
+  if((r->fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+    return -1;
+  if(fstat(r->fd, &st) != 0)
+    goto fail;
+  if(st.st_size < UART_SERIES_BLOCK) {
+    errno = EINVAL;
+    goto fail;
+  }
+  if((map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, r->fd, 0)) == MAP_FAILED)
+    goto fail;
+
+  r->map = (const uint8_t *) map;
+  r->size = st.st_size;
+  r->blocks = (uint32_t) (st.st_size / UART_SERIES_BLOCK - 1);
+  r->decoded = 0;
+  r->badBlocks = 0;
+  if(checkFileHeader(r->map) != 0) {
+    munmap(map, r->size);
+    goto fail;
+  }
+  return 0;
+
+fail:
+  close(r->fd);
+  r->fd = -1;
+  return -1;
+}
+
+void uartSeriesReaderClose(uart_series_reader_t *r) {
+  munmap((void *) r->map, r->size);
+  close(r->fd);
+  r->fd = -1;
+}
+
+const uint8_t *uartSeriesReaderBlock(const uart_series_reader_t *r, uint32_t index) {
+  return r->map + blockOffset(index);
+}
+
+/*
+ * Pass every sample stamped fromMs..toMs, both included, to cb.  The first block that can hold one is
+ * found by a binary search on the block headers.  Returns the number of samples passed.
+ */
+int64_t uartSeriesQueryTime(uart_series_reader_t *r, uint64_t fromMs, uint64_t toMs, uart_series_cb_t cb,
+                            void *arg) {
+  uart_series_hdr_t hdr;
+  uint32_t lo = 0, hi = r->blocks, mid;
+  int64_t found = 0;
+
+  while(lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if(blockLastTime(r, mid) < fromMs)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  for(; lo < r->blocks; lo++) {
+    if(uartSeriesHeader(uartSeriesReaderBlock(r, lo), &hdr) != 0) {
+      r->badBlocks++;
+      continue;
+    }
+    if(hdr.firstTimeMs > toMs)
+      break;
+    if(queryBlock(r, lo, fromMs, toMs, 0, cb, arg, &found))
+      break;
+  }
+  return found;
+}
+
+/*
+ * Pass every sample with a cycle count from..to, both included, to cb.  Cycle counts restart with the
+ * sensor, so every header is looked at, but only blocks whose cycle range overlaps are decoded.  Returns
+ * the number of samples passed.
+ */
+int64_t uartSeriesQueryCycle(uart_series_reader_t *r, uint32_t from, uint32_t to, uart_series_cb_t cb,
+                             void *arg) {
+  uart_series_hdr_t hdr;
+  uint32_t ii;
+  int64_t found = 0;
+
+  for(ii = 0; ii < r->blocks; ii++) {
+    if(uartSeriesHeader(uartSeriesReaderBlock(r, ii), &hdr) != 0) {
+      r->badBlocks++;
+      continue;
+    }
+    if((hdr.maxCycle < from) || (hdr.minCycle > to))
+      continue;
+    if(queryBlock(r, ii, from, to, 1, cb, arg, &found))
+      break;
+  }
+  return found;
+}
@@ -0,0 +1,61 @@
+/********************************************************************************************************==*
+*                                      answer_t time series files for NNTS
+* Filename      : uart_series_file.h
+**********************************************************************************************************
+* Notes         : Host only.  A series file is a file header padded to UART_SERIES_BLOCK followed by
+*                 blocks of uart_series.h, so every block is page aligned.  Blocks are only ever appended;
+*                 the last one may be partly filled, as may any block after which the file was closed.
+*
+*                 The reader maps the file and finds a time range by a binary search over the block
+*                 headers, and a cycle range by skipping the blocks whose header range misses it; only
+*                 the blocks that hold matching samples are decoded.  Damaged blocks are skipped and
+*                 counted.
+*/
+
+#ifndef __UART_SERIES_FILE_H
+#define __UART_SERIES_FILE_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_series.h"
+#include <stddef.h>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define UART_SERIES_FILE_MAGIC    "NNTSSER1"
+#define UART_SERIES_FILE_VERSION  1
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  int fd;
+  uint32_t blocks;          /* blocks in the file, the open one excluded */
+  uint64_t samples;         /* samples appended through this handle */
+  uart_series_writer_t w;
+  uint8_t block[UART_SERIES_BLOCK];
+} uart_series_file_t;
+
+typedef struct {
+  int fd;
+  const uint8_t *map;
+  size_t size;
+  uint32_t blocks;
+  uint32_t decoded;         /* blocks decoded by queries so far */
+  uint32_t badBlocks;       /* skipped by queries so far */
+} uart_series_reader_t;
+
+/* Called for every sample in range, in file order; a non-zero return ends the query. */
+typedef int (*uart_series_cb_t)(const uart_sample_t *s, void *arg);
+
+/* Functions --------------------------------------------------------------------------------------------*/
+int uartSeriesFileOpen(uart_series_file_t *f, const char *path);
+int uartSeriesFileAppend(uart_series_file_t *f, const uart_sample_t *s);
+int uartSeriesFileClose(uart_series_file_t *f);
+
+int uartSeriesReaderOpen(uart_series_reader_t *r, const char *path);
+void uartSeriesReaderClose(uart_series_reader_t *r);
+const uint8_t *uartSeriesReaderBlock(const uart_series_reader_t *r, uint32_t index);
+int64_t uartSeriesQueryTime(uart_series_reader_t *r, uint64_t fromMs, uint64_t toMs, uart_series_cb_t cb,
+                            void *arg);
+int64_t uartSeriesQueryCycle(uart_series_reader_t *r, uint32_t from, uint32_t to, uart_series_cb_t cb,
+                             void *arg);
+
+#endif /* __UART_SERIES_FILE_H */
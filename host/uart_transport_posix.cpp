@@ -0,0 +1,118 @@
+/********************************************************************************************************==*
+*                                      POSIX file descriptor transport for NNTS
+* Filename      : uart_transport_posix.cpp
+**********************************************************************************************************
+* Notes         : The descriptor is stored directly in the transport context pointer.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_transport_posix.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static int posixWrite(void *ctx, const uint8_t *buf, size_t len) {
+  int fd = (int) (intptr_t) ctx;
+  size_t done = 0;
+  ssize_t n;
+
+  while(done < len) {   /* sockets and ptys may accept a partial write */
+    n = write(fd, buf + done, len - done);
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+      return -1;
+    }
+    done += n;
+  }
+  return (int) done;
+}
+
+static int posixRead(void *ctx, uint8_t *buf, size_t len, uint32_t timeoutMs) {
+  int fd = (int) (intptr_t) ctx;
+  struct pollfd pfd;
+  ssize_t n;
+  int rc;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  do {
+    rc = poll(&pfd, 1, (timeoutMs == UART_WAIT_FOREVER) ? -1 : (int) timeoutMs);
+  } while((rc < 0) && (errno == EINTR));
+  if(rc <= 0)
+    return rc;   /* 0 on timeout */
+
+  do {
+    n = read(fd, buf, len);
+  } while((n < 0) && (errno == EINTR));
+  if(n == 0) {   /* peer closed */
+    errno = EPIPE;
+    return -1;
+  }
+  return (int) n;
+}
+
+static speed_t posixBaud(uint32_t baud) {
+  switch(baud) {
+    case 9600:    return B9600;
+    case 19200:   return B19200;
+    case 38400:   return B38400;
+    case 57600:   return B57600;
+    case 115200:  return B115200;
+    case 230400:  return B230400;
+    case 460800:  return B460800;
+    case 921600:  return B921600;
+    default:      return B0;
+  }
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+int uartTransportPosixOpen(uart_transport_t *t, const char *path, uint32_t baud) {
+  struct termios tio;
+  speed_t speed;
+  int fd;
+
+  fd = open(path, O_RDWR | O_NOCTTY);
+  if(fd < 0)
+    return -1;
+
+  if(isatty(fd)) {   /* raw 8N1 for a real serial port or a pty */
+    if(tcgetattr(fd, &tio) != 0) {
+      close(fd);
+      return -1;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    speed = posixBaud(baud);
+    if(speed != B0) {
+      cfsetispeed(&tio, speed);
+      cfsetospeed(&tio, speed);
+    }
+    if(tcsetattr(fd, TCSANOW, &tio) != 0) {
+      close(fd);
+      return -1;
+    }
+  }
+
+  uartTransportPosixInit(t, fd);
+  return 0;
+}
+
+void uartTransportPosixInit(uart_transport_t *t, int fd) {
+  t->ctx = (void *) (intptr_t) fd;
+  t->write = posixWrite;
+  t->read = posixRead;
+}
+
+int uartTransportPosixFd(uart_transport_t *t) {
+  return (int) (intptr_t) t->ctx;
+}
+
+void uartTransportPosixClose(uart_transport_t *t) {
+  close(uartTransportPosixFd(t));
+  t->ctx = (void *) (intptr_t) -1;
+}
@@ -0,0 +1,21 @@
+/********************************************************************************************************==*
+*                                      POSIX file descriptor transport for NNTS
+* Filename      : uart_transport_posix.h
+**********************************************************************************************************
+* Notes         : Host only.  Works on a serial tty, a pty or one end of a socketpair.
+*/
+
+#ifndef __UART_TRANSPORT_POSIX_H
+#define __UART_TRANSPORT_POSIX_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_transport.h"
+
+/* Functions --------------------------------------------------------------------------------------------*/
+int uartTransportPosixOpen(uart_transport_t *t, const char *path, uint32_t baud);
+void uartTransportPosixInit(uart_transport_t *t, int fd);
+int uartTransportPosixFd(uart_transport_t *t);
+void uartTransportPosixClose(uart_transport_t *t);
+
+#endif /* __UART_TRANSPORT_POSIX_H */
@@ -0,0 +1,518 @@
+/********************************************************************************************************==*
+*                                      UART test client for NNTS - Linux host
+* Filename      : uarttest.cpp
+**********************************************************************************************************
+* Notes         : Runs the shared client against a serial port or pty.  With -n the command is repeated
+*                 and the round-trip latency, link throughput and per-command metrics are reported.  -e polls the whole
+*                 environment in one pipelined batch, -E does the same poll one command at a time, for
+*                 comparison.  -f reads a set of fields through the query planner.  -m keeps the sensor
+*                 metadata cache in a file between runs.  -g downloads the engineering data to a file.
+*                 -R receives through the ring and a reader thread; -P adds a second thread sampling
+*                 CMD_ANSWER while the command runs, to check that transactions from two threads do not
+*                 interfere.  -A runs the command through the asynchronous engine on an epoll loop.  -L moves
+*                 the client's diagnostics to a log thread, so -v and -x do not slow the link down.  -o and -D
+*                 choose how readings are printed.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_client.h"
+#include "uart_query.h"
+#include "uart_cache.h"
+#include "uart_ring.h"
+#include "uart_evloop.h"
+#include "uart_transport_posix.h"
+#include "sensor_sim.h"
+#include "uart_rto.h"
+#include "uart_metrics.h"
+#include "uart_log.h"
+#include "uart_format.h"
+#include "uart_sched.h"
+#include "uart_sampler.h"
+#include "uart_stats.h"
+#include "uart_deadband.h"
+#include <sys/socket.h>
+#include <thread>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define POLL_COMMAND        0     /* one command, selected with -c */
+#define POLL_ENV_BATCH      1     /* environment in one pipelined batch */
+#define POLL_ENV_SEQUENTIAL 2     /* environment, one round trip per value */
+#define POLL_QUERY          3     /* fields selected with -f, through the query planner */
+#define POLL_ENGDATA        4     /* engineering data download to the -g file */
+#define POLL_SAMPLER        5     /* CMD_ANSWER at the fixed -F rate, through uart_sampler */
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uart_transport_t *lower;
+  uint64_t txBytes;
+  uint64_t rxBytes;
+} link_counter_t;
+
+typedef struct {
+  uart_async_t *async;
+  uint32_t toSubmit;
+  uint32_t done;
+  uint32_t failed;
+} async_run_t;
+
+/* Local variables --------------------------------------------------------------------------------------*/
+static sensor_sim_t sim;
+static uart_reading_t reading;
+static uint32_t queryFields, queryMaxAgeMs;
+static int engDataFd = -1;
+static uart_rxlink_t rxLink;
+static uart_transport_t asyncLink;
+static volatile int samplerStop, logStop;
+static uart_sched_t sched;
+static int useSched;
+static uart_stats_t answerStats;
+static uart_deadband_t deadband;
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static int countWrite(void *ctx, const uint8_t *buf, size_t len) {
+  link_counter_t *c = (link_counter_t *) ctx;
+  int n = uartTransportWrite(c->lower, buf, len);
+
+  if(n > 0)
+    c->txBytes += n;
+  return n;
+}
+
+static int countRead(void *ctx, uint8_t *buf, size_t len, uint32_t timeoutMs) {
+  link_counter_t *c = (link_counter_t *) ctx;
+  int n = uartTransportRead(c->lower, buf, len, timeoutMs);
+
+  if(n > 0)
+    c->rxBytes += n;
+  return n;
+}
+
+static int fdSinkWrite(void *ctx, uint32_t offset, const uint8_t *data, uint16_t len) {
+  return pwrite(*(int *) ctx, data, len, offset) == (ssize_t) len ? 0 : -1;
+}
+
+static void sampler(uint32_t periodMs, uint32_t *done, uint32_t *failed) {
+  answer_t answer;
+
+  while(!samplerStop) {
+    if(useSched)
+      uartSchedAcquire(&uartDefaultSession, UART_PRIO_SAFETY);
+    if(uartRead<CMD_ANSWER>(&answer) == 0)
+      (*done)++;
+    else
+      (*failed)++;
+    if(useSched)
+      uartSchedRelease(&uartDefaultSession);
+    usleep(periodMs * 1000);
+  }
+}
+
+static void asyncDone(void *arg, uart_request_t *req) {
+  async_run_t *run = (async_run_t *) arg;
+
+  run->done++;
+  if(req->status != UART_SUCCESS)
+    run->failed++;
+  if(run->toSubmit) {
+    run->toSubmit--;
+    uartAsyncSubmit(run->async, req);   /* same buffers, same command */
+  }
+}
+
+static double nowUs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static uint32_t runOnce(uart_cmd_t *cmd, uint32_t value, int mode) {
+  static uint8_t reply[UART_MAX_DATA_SIZE];
+  static const uint8_t envCmds[] = {CMD_TEMP, CMD_PRES, CMD_REL_HUM, CMD_ABS_HUM, CMD_CONC};
+  enviro_reply_t env;
+  float conc;
+  uint32_t ii, sts = 0;
+
+  if(mode == POLL_QUERY) {
+    if((sts = uartQuery(&reading, queryFields, queryMaxAgeMs)) == 0)
+      printf("cycle %u conc %f flamID %u temp %f pres %f relHum %f absHum %f\n", reading.value.cycleCount,
+             reading.value.concentration, reading.value.flamID, reading.value.temp, reading.value.pressure,
+             reading.value.relHumidity, reading.value.absHumidity);
+    return sts;
+  }
+
+  if(mode == POLL_ENGDATA) {
+    uart_engdata_sink_t sink = {&engDataFd, fdSinkWrite};
+    uart_engdata_stats_t stats;
+
+    if((sts = uartEngDataDownload(&sink, &stats)) == 0)
+      printf("%u bytes in %u chunks, %u retries, %u restarts, %u yields, %.1f ms, %.0f bytes/s\n", stats.bytes,
+             stats.chunks, stats.retries, stats.restarts, stats.yields, stats.elapsedUs / 1e3,
+             stats.bytes / (stats.elapsedUs / 1e6));
+    return sts;
+  }
+
+  if(mode == POLL_ENV_BATCH)
+    return ReadEnvironment(&env, &conc);
+
+  if(mode == POLL_ENV_SEQUENTIAL) {
+    for(ii = 0; ii < sizeof(envCmds); ii++)
+      sts |= ReadFloat(envCmds[ii], reply, sizeof(float));
+    return sts;
+  }
+
+  if(cmd->req_size)
+    return cmd->func(cmd->cmdID, (uint8_t *) &value, cmd->req_size);
+  if(cmd->res_size)
+    return cmd->func(cmd->cmdID, reply, cmd->res_size);
+  return cmd->func(cmd->cmdID, NULL, 0);
+}
+
+static uint32_t runCommand(uart_cmd_t *cmd, uint32_t value, int mode, uint32_t count, link_counter_t *counter) {
+  double start, t0, rtt, minRtt = 1e30, maxRtt = 0, elapsed;
+  uint32_t ii, sts = 0, failed = 0;
+
+  start = nowUs();
+  for(ii = 0; ii < (count ? count : 1); ii++) {
+    if(count)
+      uartCacheInvalidate();   /* time the link, not the metadata cache */
+    t0 = nowUs();
+    sts = runOnce(cmd, value, mode);
+    rtt = nowUs() - t0;
+    if(rtt < minRtt) minRtt = rtt;
+    if(rtt > maxRtt) maxRtt = rtt;
+    if(sts != 0)
+      failed++;
+  }
+  elapsed = nowUs() - start;
+
+  if(count == 0)
+    return sts;
+
+  printf("%u transactions, %u failed, %.3f s\n", count, failed, elapsed / 1e6);
+  printf("round trip: avg %.1f us, min %.1f us, max %.1f us\n", elapsed / count, minRtt, maxRtt);
+  printf("tx %llu bytes, rx %llu bytes, %.1f bytes/s\n", (unsigned long long) counter->txBytes,
+         (unsigned long long) counter->rxBytes, (counter->txBytes + counter->rxBytes) / (elapsed / 1e6));
+  return failed ? 1 : 0;
+}
+
+/* Print count samples of the fixed-rate sampler as CSV, then how well it kept time. */
+static uint32_t runSampler(uint32_t periodMs, uint32_t count) {
+  static uart_sampler_t sp;
+  uart_sampler_stats_t *st = &sp.stats;
+  uart_sample_entry_t e;
+  char line[UART_FMT_LINE_MAX];
+  uint32_t got = 0, printed = 0, total = count ? count : 10;
+  std::thread thread;
+
+  uartSamplerInit(&sp, &uartDefaultSession, periodMs);
+  thread = std::thread(uartSamplerRun, &sp);
+  while(got < total) {
+    if(!uartSamplerPop(&sp, &e)) {
+      usleep(1000);
+      continue;
+    }
+    got++;
+    /* the samples go through the answer pipeline; only what comes out of it is printed here */
+    if(!uartAnswerFeed(&e.answer, e.timeUs))
+      continue;
+    if(printed++ == 0)
+      printf("seq,timeMs,%s", UART_FMT_ANSWER_CSV_HEADER);
+    uartFormatAnswer(line, sizeof(line), &e.answer, UART_FMT_CSV, uartFmtDecimals);
+    printf("%u,%.3f,%s", e.seq, e.timeUs / 1e3, line);
+  }
+  uartSamplerStop(&sp);
+  thread.join();
+
+  printf("%u samples, %u failed, %u missed, %u dropped\n", st->samples, st->failed, st->missed, st->dropped);
+  printf("late: avg %.1f us, max %u us; interval min %u us, max %u us\n",
+         (double) st->lateSumUs / (st->samples + st->failed), st->lateMaxUs, st->gapMinUs, st->gapMaxUs);
+  return st->failed ? 1 : 0;
+}
+
+/* Keep depth requests queued on the async engine until count have completed. */
+static uint32_t runAsync(uart_cmd_t *cmd, uint32_t value, uint32_t count, uint32_t depth, int fd) {
+  static uint8_t reply[UART_MAX_DATA_SIZE];   /* requests complete one at a time */
+  uart_request_t reqs[8];
+  uart_async_t async;
+  uart_evloop_t loop;
+  async_run_t run;
+  uint32_t ii, total = count ? count : 1;
+  double start, elapsed;
+
+  if(depth > 8)
+    depth = 8;
+  if(depth > total)
+    depth = total;
+  if(uartEvLoopInit(&loop) != 0)
+    return 1;
+  uartAsyncInit(&async, &asyncLink);
+  uartEvLoopAdd(&loop, &async, fd);
+
+  run.async = &async;
+  run.toSubmit = total - depth;
+  run.done = 0;
+  run.failed = 0;
+
+  start = nowUs();
+  for(ii = 0; ii < depth; ii++) {
+    uartAsyncRequest(&reqs[ii], cmd->cmdID, reply, cmd->res_size, asyncDone, &run);
+    reqs[ii].txPayload = cmd->req_size ? (uint8_t *) &value : NULL;
+    reqs[ii].txLen = cmd->req_size;
+    reqs[ii].timeoutMs = rxTimeout;
+    reqs[ii].retries = numOfRetries;
+    uartAsyncSubmit(&async, &reqs[ii]);
+  }
+  while(run.done < total) {
+    if(uartEvLoopRunOnce(&loop, 1000) < 0)
+      break;
+  }
+  elapsed = nowUs() - start;
+  uartEvLoopClose(&loop);
+
+  printf("%u async transactions, %u failed, %u timeouts, %.3f s, %.1f us each\n", run.done, run.failed,
+         async.timeouts, elapsed / 1e6, elapsed / total);
+  return (run.failed || (run.done < total)) ? 1 : 0;
+}
+
+/* Round trip estimate of every command that was sampled or timed out. */
+static void printRto(void) {
+  uart_rto_t rto;
+  uint32_t ii;
+
+  for(ii = 0; ii < uartNumOfCmds; ii++) {
+    if((uartRtoGet(uart_cmds[ii].cmdID, &rto) != 0) || ((rto.samples == 0) && (rto.timeouts == 0)))
+      continue;
+    printf("rto 0x%02x: srtt %u us, rttvar %u us, timeout %u ms, %u samples, %u timeouts\n", uart_cmds[ii].cmdID,
+           rto.srttUs, rto.rttvarUs, uartRtoMs(uart_cmds[ii].cmdID, 0), rto.samples, rto.timeouts);
+  }
+}
+
+/* -B percent[:heartbeatMs]: the same relative band on every field. */
+static void parseDeadband(const char *arg, uart_db_cfg_t *cfg) {
+  char *end;
+  float rel = strtof(arg, &end) / 100.0f;
+  uint32_t ii;
+
+  for(ii = 0; ii < UART_DB_FIELDS; ii++) {
+    cfg->band[ii].abs = 0;
+    cfg->band[ii].rel = rel;
+  }
+  if(*end == ':')
+    cfg->heartbeatMs = strtoul(end + 1, NULL, 0);
+}
+
+static void usage(void) {
+  printf("usage: uarttest -p <device> | -S [-b baud] [-c cmdID] [-w value] [-e|-E]\n"
+         "                [-f fields [-a maxAgeMs]] [-m cacheFile] [-g file [-G]] [-F ms] [-W answers]\n"
+         "                [-B percent[:heartbeatMs]] [-R [-P ms [-Q]]] [-A depth] [-r retries] [-t timeoutMs]\n"
+         "                [-T budgetMs] [-n count] [-L]\n"
+         "                [-o human|csv|json] [-D decimals] [-v] [-x]\n"
+         "  -p  serial device or pty of the sensor\n"
+         "  -S  talk to an in-process sensor simulator over a socketpair\n"
+         "  -b  baud rate (default 38400)\n"
+         "  -c  command ID in hex (default 0x%02x)\n"
+         "  -w  value for write commands\n"
+         "  -e  poll temperature, pressure, humidity and concentration in one pipelined batch\n"
+         "  -E  the same poll, one command at a time\n"
+         "  -f  read fields through the query planner, a UART_FIELD_ mask in hex\n"
+         "  -a  reuse fields read less than this many ms ago (default: always read)\n"
+         "  -m  load the metadata cache from this file and save it back on exit\n"
+         "  -g  download the engineering data into this file\n"
+         "  -G  with -g, name each chunk with ENGDATA_SEEK and keep a request ahead; the sensor must honour it\n"
+         "  -F  sample CMD_ANSWER every ms on a fixed schedule, -n samples (default 10)\n"
+         "  -W  print statistics over windows of this many answers instead of each answer\n"
+         "  -B  report readings only when a field moves by more than percent, flamID changes or every\n"
+         "      heartbeatMs (default 60000), with the number held back\n"
+         "  -R  receive through the ring buffer and a reader thread\n"
+         "  -P  with -R, sample CMD_ANSWER from a second thread every ms while the command runs\n"
+         "  -Q  schedule the link by priority, the samples first; prints the wait per class\n"
+         "  -A  run the command through the asynchronous engine, depth requests queued\n"
+         "  -r  number of retries\n"
+         "  -t  fixed reply timeout in ms (default: adapted to each command's round trip time)\n"
+         "  -T  give up on a transaction after this many ms, retries included\n"
+         "  -n  repeat the command and report latency and throughput, the metadata cache bypassed\n"
+         "  -L  print diagnostics from a log thread instead of inline\n"
+         "  -o  print readings as text (default), CSV or JSON lines\n"
+         "  -D  decimals of the readings (default 6)\n"
+         "  -v  verbose, -x hexdump\n", CMD_VERSION);
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+int main(int argc, char **argv) {
+  uint8_t cmdID = CMD_VERSION;
+  uint32_t value = 0, sts = 0, baud = 38400, count = 0, samplePeriod = 0, samples = 0, sampleFails = 0;
+  uint32_t asyncDepth = 0;
+  char *port = NULL, *cacheFile = NULL, *engDataFile = NULL;
+  uart_transport_t serial, counted, ringed;
+  link_counter_t counter;
+  uart_cmd_t *cmd;
+  sensor_sim_cfg_t simCfg;
+  uart_transport_t simLink;
+  std::thread simThread, readerThread, samplerThread, logThread;
+  uart_log_stats_t logStats;
+  uart_stats_cfg_t statsCfg;
+  uart_db_cfg_t dbCfg;
+  int c, useSim = 0, useRing = 0, useLog = 0, useStats = 0, useDeadband = 0, mode = POLL_COMMAND, fds[2];
+
+  uartStatsDefaults(&statsCfg);
+  uartDeadbandDefaults(&dbCfg);
+  while((c = getopt(argc, argv, "p:Sb:c:w:eEf:a:m:g:GF:W:B:RP:QA:r:t:T:n:Lo:D:vxh")) != -1) {
+    switch(c) {
+      case 'p': port = optarg; break;
+      case 'S': useSim = 1; break;
+      case 'b': baud = strtoul(optarg, NULL, 0); break;
+      case 'c': cmdID = (uint8_t) strtoul(optarg, NULL, 16); break;
+      case 'w': value = strtoul(optarg, NULL, 0); break;
+      case 'e': mode = POLL_ENV_BATCH; break;
+      case 'E': mode = POLL_ENV_SEQUENTIAL; break;
+      case 'f': mode = POLL_QUERY; queryFields = strtoul(optarg, NULL, 16); break;
+      case 'a': queryMaxAgeMs = strtoul(optarg, NULL, 0); break;
+      case 'm': cacheFile = optarg; break;
+      case 'g': mode = POLL_ENGDATA; engDataFile = optarg; break;
+      case 'G': engDataSeek = 1; break;
+      case 'F': mode = POLL_SAMPLER; samplePeriod = strtoul(optarg, NULL, 0); break;
+      case 'W': statsCfg.windowSamples = strtoul(optarg, NULL, 0); useStats = 1; break;
+      case 'B': useDeadband = 1; parseDeadband(optarg, &dbCfg); break;
+      case 'R': useRing = 1; break;
+      case 'A': asyncDepth = strtoul(optarg, NULL, 0); break;
+      case 'P': samplePeriod = strtoul(optarg, NULL, 0); break;
+      case 'Q': useSched = 1; break;
+      case 'r': numOfRetries = strtoul(optarg, NULL, 0); break;
+      case 't': rxTimeout = strtoul(optarg, NULL, 0); break;
+      case 'T': rxBudget = strtoul(optarg, NULL, 0); break;
+      case 'n': count = strtoul(optarg, NULL, 0); break;
+      case 'L': useLog = 1; break;
+      case 'o':
+        if(strcmp(optarg, "csv") == 0)
+          uartFmtStyle = UART_FMT_CSV;
+        else if(strcmp(optarg, "json") == 0)
+          uartFmtStyle = UART_FMT_JSON;
+        break;
+      case 'D': uartFmtDecimals = strtoul(optarg, NULL, 0); break;
+      case 'v': verbose = 1; break;
+      case 'x': hexdump = 1; verbose = 1; break;
+      default: usage(); return 1;
+    }
+  }
+
+  if(engDataFile && ((engDataFd = open(engDataFile, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)) {
+    printf("Failed to open %s: %s (%d)\n", engDataFile, strerror(errno), errno);
+    return 1;
+  }
+
+  if(useSim) {
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+      printf("Failed to create socketpair: %s (%d)\n", strerror(errno), errno);
+      return 1;
+    }
+    uartTransportPosixInit(&serial, fds[0]);
+    uartTransportPosixInit(&simLink, fds[1]);
+    sensorSimDefaults(&simCfg);
+    sensorSimInit(&sim, &simCfg, &simLink);
+    simThread = std::thread(sensorSimRun, &sim);
+  } else if(port == NULL) {
+    usage();
+    return 1;
+  } else if(uartTransportPosixOpen(&serial, port, baud) != 0) {
+    printf("Failed to open %s: %s (%d)\n", port, strerror(errno), errno);
+    return 1;
+  }
+
+  if(useLog) {
+    uartLogStart();
+    logThread = std::thread(uartLogRun, &logStop);
+  }
+
+  memset(&counter, 0, sizeof(counter));
+  counter.lower = &serial;
+  counted.ctx = &counter;
+  counted.write = countWrite;
+  counted.read = countRead;
+  if(useRing) {
+    uartRxLinkInit(&rxLink, &counted, &ringed);
+    readerThread = std::thread(uartRxLinkRun, &rxLink);
+    uartSetTransport(&ringed);
+  } else {
+    uartSetTransport(&counted);
+  }
+  uartReadingInit(&reading);
+  if(cacheFile && (uartCacheLoad(cacheFile) != 0) && verbose)
+    printf("No usable metadata cache in %s\n", cacheFile);
+
+  if((cmd = uartFindCmd(cmdID)) == NULL) {
+    printf("No such command: 0x%x\n", cmdID);
+    sts = 1;
+  } else if(asyncDepth) {
+    asyncLink = counted;   /* straight on the descriptor: the loop waits on it with epoll */
+    sts = runAsync(cmd, value, count, asyncDepth, uartTransportPosixFd(&serial));
+  } else {
+    if(useSched)
+      uartSchedInit(&sched, &uartDefaultSession);
+    if(useStats) {
+      uartStatsInit(&answerStats, &statsCfg, NULL, NULL);
+      uartAnswerAddStage(&answerStats.stage);
+      printf("%s", UART_STATS_CSV_HEADER);
+    }
+    if(useDeadband) {
+      uartDeadbandInit(&deadband, &dbCfg, NULL, NULL);
+      uartAnswerAddStage(&deadband.stage);
+    }
+    if(useRing && samplePeriod && (mode != POLL_SAMPLER))
+      samplerThread = std::thread(sampler, samplePeriod, &samples, &sampleFails);
+    if(mode == POLL_SAMPLER)
+      sts = runSampler(samplePeriod, count);
+    else
+      sts = runCommand(cmd, value, mode, count, &counter);
+    if(useStats)
+      uartStatsFlush(&answerStats);
+    if(useDeadband)
+      printf("deadband: %u reported, %u held back\n", deadband.reports, deadband.suppressed);
+    if(samplerThread.joinable()) {
+      samplerStop = 1;
+      samplerThread.join();
+      printf("sampler: %u transactions, %u failed\n", samples, sampleFails);
+    }
+    if(useSched)
+      uartSchedDump(&sched);
+  }
+
+  if(useLog) {
+    logStop = 1;
+    logThread.join();
+    uartLogGetStats(&logStats);
+    printf("log: %u records, %u dropped\n", logStats.records, logStats.dropped);
+  }
+
+  if(cacheFile && (uartCacheSave(cacheFile) != 0))
+    printf("Failed to save metadata cache to %s: %s (%d)\n", cacheFile, strerror(errno), errno);
+  if(count) {
+    printf("metadata cache: %u hits, %u misses, %u invalidations\n", uartCacheStats.hits, uartCacheStats.misses,
+           uartCacheStats.invalidations);
+    printRto();
+    uartMetricsDump();
+  }
+
+  if(engDataFd >= 0)
+    close(engDataFd);
+  if(useRing) {
+    rxLink.stop = 1;
+    readerThread.join();
+  }
+  uartTransportPosixClose(&serial);
+  if(useSim) {
+    sim.stop = 1;
+    simThread.join();
+    uartTransportPosixClose(&simLink);
+  }
+  return sts;
+}
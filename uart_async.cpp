@@ -0,0 +1,234 @@
+/********************************************************************************************************==*
+*                                      Asynchronous requests for NNTS
+* Filename      : uart_async.cpp
+**********************************************************************************************************
+* Notes         : Replies are checked with the same rules as the blocking client (uartCheckReplyHdr,
+*                 uartCheckReply), so both report errors the same way.  Writes still go straight to the
+*                 transport; a request is at most a header and a small payload, which the UART driver
+*                 buffers without blocking.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_async.h"
+#include "uart_client.h"
+#include "uart_platform.h"
+#include "uart_metrics.h"
+#include "uart_rto.h"
+#include "uart_log.h"
+#include <string.h>
+#include <stdio.h>
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static void asyncStart(uart_async_t *a);
+
+static void asyncRearm(uart_async_t *a) {
+  if(a->rearm != NULL)
+    a->rearm(a->rearmCtx);
+}
+
+/*
+ * Nothing on the wire any more.  The sink goes with the attempt: the buffer may be freed by the time a late
+ * or duplicate reply comes in, so until the next send frames are only checked and dropped.
+ */
+static void asyncIdle(uart_async_t *a) {
+  a->inFlight = 0;
+  uartParserSetSink(&a->parser, NULL, 0);
+}
+
+/* Take the head request off the queue and tell its owner, then start the next one if asked to. */
+static void asyncFinish(uart_async_t *a, uint32_t status, int startNext) {
+  uart_request_t *req = a->head;
+
+  a->head = req->next;
+  if(a->head == NULL)
+    a->tail = NULL;
+  asyncIdle(a);
+
+  req->status = status;
+  req->next = NULL;
+  if(status == UART_SUCCESS)
+    a->completed++;
+  else
+    a->failed++;
+
+  a->inCallback++;
+  req->done(req->arg, req);   /* may submit more */
+  a->inCallback--;
+
+  if(startNext && !a->inFlight && (a->head != NULL))
+    asyncStart(a);
+  else
+    asyncRearm(a);
+}
+
+static int asyncSend(uart_async_t *a, uart_request_t *req) {
+  uint8_t header[RQST_HDR_LENGTH];
+  uint32_t timeoutMs;
+
+  if(uartMakeRqstHdr(header, req->cmdID, req->reserved, req->txPayload, req->txLen) != 0)
+    return -1;
+  if(uartTransportWrite(a->link, header, RQST_HDR_LENGTH) != RQST_HDR_LENGTH)
+    return -1;
+  if(req->txLen && (uartTransportWrite(a->link, req->txPayload, req->txLen) != req->txLen))
+    return -1;
+
+  uartMetricsAdd(req->cmdID, UART_MET_REQUESTS, 1);
+  uartMetricsAdd(req->cmdID, UART_MET_BYTES_OUT, RQST_HDR_LENGTH + req->txLen);
+  if(req->attempt == 0)
+    req->startUs = uartMicros();
+  else
+    uartMetricsAdd(req->cmdID, UART_MET_RETRIES, 1);
+
+  uartParserSetSink(&a->parser, req->rxPayload, req->rxLen);
+  timeoutMs = req->timeoutMs ? req->timeoutMs : uartRtoMs(req->cmdID, req->attempt);
+  req->deadlineUs = (timeoutMs != UART_WAIT_FOREVER) ? uartMicros() + (uint64_t) timeoutMs * 1000 : 0;
+  a->inFlight = 1;
+  return 0;
+}
+
+/* Put the head request on the wire; requests that cannot be sent fail right away. */
+static void asyncStart(uart_async_t *a) {
+  while((a->head != NULL) && !a->inFlight) {
+    if(asyncSend(a, a->head) == 0) {
+      asyncRearm(a);
+      return;
+    }
+    uartLog("Failed to send request: 0x%x\n", a->head->cmdID);
+    asyncFinish(a, UART_LOCAL_ERROR, 0);
+  }
+}
+
+/* The attempt on the wire failed with status: try again or give up. */
+static void asyncAttemptFailed(uart_async_t *a, uint32_t status) {
+  uart_request_t *req = a->head;
+
+  asyncIdle(a);
+  if(req->attempt++ < req->retries) {
+    if(asyncSend(a, req) == 0) {
+      asyncRearm(a);
+      return;
+    }
+    status = UART_LOCAL_ERROR;
+  }
+  asyncFinish(a, status, 1);
+}
+
+static int asyncOnFrame(void *ctx, const uartReplyHeader_t *reply, const uint8_t *data) {
+  uart_async_t *a = (uart_async_t *) ctx;
+  uart_request_t *req = a->head;
+  uint32_t status, rttUs;
+
+  if(!a->inFlight)
+    return 0;   /* late reply to a request that already timed out */
+
+  status = uartCheckReply(req->cmdID, reply, data, req->rxPayload, req->rxLen);
+  req->replyLen = reply->length;
+  if(status != UART_SUCCESS) {
+    asyncAttemptFailed(a, status);
+  } else {
+    rttUs = (uint32_t) (uartMicros() - req->startUs);
+    uartMetricsLatency(req->cmdID, rttUs);
+    if(req->attempt == 0)   /* after a resend it is unknown which request was answered */
+      uartRtoSample(req->cmdID, rttUs);
+    asyncFinish(a, status, 1);
+  }
+  return 0;
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartAsyncInit(uart_async_t *a, uart_transport_t *link) {
+  memset(a, 0, sizeof(*a));
+  a->link = link;
+  uartParserInit(&a->parser, asyncOnFrame, a);
+  a->parser.checkHeader = uartCheckReplyHdr;
+}
+
+/* Set up a plain read request; the caller may fill in txPayload, timeoutMs and retries afterwards. */
+void uartAsyncRequest(uart_request_t *req, uint8_t cmdID, uint8_t *rxPayload, uint16_t rxLen,
+                      uart_done_cb_t done, void *arg) {
+  memset(req, 0, sizeof(*req));
+  req->cmdID = cmdID;
+  req->rxPayload = rxPayload;
+  req->rxLen = rxLen;
+  req->done = done;
+  req->arg = arg;
+}
+
+/* Queue req.  It must stay valid until its callback has run. */
+void uartAsyncSubmit(uart_async_t *a, uart_request_t *req) {
+  req->next = NULL;
+  req->attempt = 0;
+  req->status = UART_LOCAL_ERROR;
+  req->replyLen = 0;
+
+  if(a->tail != NULL)
+    a->tail->next = req;
+  else
+    a->head = req;
+  a->tail = req;
+
+  if(!a->inFlight && !a->inCallback)
+    asyncStart(a);
+}
+
+/* Parse whatever the link has now, without waiting.  Returns 0, or -1 if the link failed. */
+int uartAsyncOnReadable(uart_async_t *a) {
+  uint8_t *space;
+  size_t room;
+  uint32_t crcErrors = a->parser.crcErrors;
+  uint8_t cmdID = a->inFlight ? a->head->cmdID : 0;
+  int n;
+
+  if(!a->inFlight)
+    uartParserSetSink(&a->parser, NULL, 0);   /* stray frames are checked and dropped */
+  for(;;) {
+    space = uartParserSpace(&a->parser, &room);
+    if((n = uartTransportRead(a->link, space, room, 0)) <= 0)
+      break;
+    uartParserCommit(&a->parser, n);
+  }
+
+  /* bad frames are charged to the request that was waiting for them, to "other" if none was */
+  uartMetricsAdd(cmdID, UART_MET_CRC_ERRORS, a->parser.crcErrors - crcErrors);
+
+  if(n < 0) {
+    uartAsyncCancelAll(a);
+    return -1;
+  }
+  return 0;
+}
+
+/* Handle an expired deadline; harmless when nothing expired. */
+void uartAsyncOnTimer(uart_async_t *a) {
+  uart_request_t *req = a->head;
+
+  if(!a->inFlight || (req->deadlineUs == 0) || (uartMicros() < req->deadlineUs))
+    return;
+
+  uartLog("Timed out waiting for reply: 0x%x\n", req->cmdID);
+  a->timeouts++;
+  uartMetricsAdd(req->cmdID, UART_MET_TIMEOUTS, 1);
+  uartRtoTimedOut(req->cmdID);
+  uartParserReset(&a->parser);
+  asyncAttemptFailed(a, UART_LOCAL_ERROR);
+}
+
+/* Milliseconds until uartAsyncOnTimer() has work, UART_WAIT_FOREVER if there is no deadline. */
+uint32_t uartAsyncNextTimeoutMs(uart_async_t *a) {
+  uint64_t now;
+
+  if(!a->inFlight || (a->head->deadlineUs == 0))
+    return UART_WAIT_FOREVER;
+  now = uartMicros();
+  if(now >= a->head->deadlineUs)
+    return 0;
+  return (uint32_t) ((a->head->deadlineUs - now + 999) / 1000);
+}
+
+/* Fail every queued request, e.g. when the link is gone. */
+void uartAsyncCancelAll(uart_async_t *a) {
+  uartParserReset(&a->parser);
+  while(a->head != NULL)
+    asyncFinish(a, UART_LOCAL_ERROR, 0);
+}
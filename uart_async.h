@@ -0,0 +1,78 @@
+/********************************************************************************************************==*
+*                                      Asynchronous requests for NNTS
+* Filename      : uart_async.h
+**********************************************************************************************************
+* Notes         : A uart_async_t owns one link and its parser.  Requests are queued with uartAsyncSubmit(),
+*                 which returns at once; the completion callback runs when the reply is in, or when the
+*                 last retry timed out.  Nothing in here blocks on the sensor: the event loop calls
+*                 uartAsyncOnReadable() when the link has data and uartAsyncOnTimer() when the time from
+*                 uartAsyncNextTimeoutMs() has passed.  host/uart_evloop.cpp drives engines from epoll,
+*                 uart_async_mbed.cpp from an EventQueue.
+*
+*                 One request is on the wire at a time, the others wait in submit order.  All calls for
+*                 one engine must come from the thread running its event loop.
+*/
+
+#ifndef __UART_ASYNC_H
+#define __UART_ASYNC_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_proto.h"
+#include "uart_transport.h"
+#include "uart_parser.h"
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+struct uart_request;
+typedef void (*uart_done_cb_t)(void *arg, struct uart_request *req);
+
+typedef struct uart_request {
+  uint8_t cmdID;
+  uint16_t reserved;        /* request header reserved field, see ENGDATA_SEEK */
+  uint8_t *txPayload;
+  uint16_t txLen;
+  uint8_t *rxPayload;
+  uint16_t rxLen;
+  uint32_t timeoutMs;       /* per attempt, 0 adapts it per command (uart_rto.h), UART_WAIT_FOREVER waits */
+  uint32_t retries;
+  uart_done_cb_t done;
+  void *arg;
+
+  /* filled in on completion */
+  uint32_t status;          /* UART_SUCCESS, the sensor's error status or UART_LOCAL_ERROR */
+  uint16_t replyLen;
+
+  /* engine private */
+  struct uart_request *next;
+  uint64_t deadlineUs;
+  uint64_t startUs;         /* first attempt sent */
+  uint32_t attempt;
+} uart_request_t;
+
+typedef struct {
+  uart_transport_t *link;
+  uart_parser_t parser;
+  uart_request_t *head;     /* on the wire when inFlight */
+  uart_request_t *tail;
+  int inFlight;
+  int inCallback;
+  /* optional: told when the deadline of the request on the wire changed */
+  void (*rearm)(void *ctx);
+  void *rearmCtx;
+
+  uint32_t completed;
+  uint32_t failed;
+  uint32_t timeouts;
+} uart_async_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartAsyncInit(uart_async_t *a, uart_transport_t *link);
+void uartAsyncRequest(uart_request_t *req, uint8_t cmdID, uint8_t *rxPayload, uint16_t rxLen,
+                      uart_done_cb_t done, void *arg);
+void uartAsyncSubmit(uart_async_t *a, uart_request_t *req);
+int uartAsyncOnReadable(uart_async_t *a);
+void uartAsyncOnTimer(uart_async_t *a);
+uint32_t uartAsyncNextTimeoutMs(uart_async_t *a);
+void uartAsyncCancelAll(uart_async_t *a);
+
+#endif /* __UART_ASYNC_H */
@@ -0,0 +1,48 @@
+/********************************************************************************************************==*
+*                                      EventQueue driver for asynchronous requests
+* Filename      : uart_async_mbed.cpp
+**********************************************************************************************************
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_async_mbed.h"
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static void mbedTimeout(uart_async_mbed_t *m) {
+  m->timerId = 0;
+  uartAsyncOnTimer(m->async);
+}
+
+/* Engine callback: the deadline changed, move the timeout event. */
+static void mbedRearm(void *ctx) {
+  uart_async_mbed_t *m = (uart_async_mbed_t *) ctx;
+  uint32_t ms = uartAsyncNextTimeoutMs(m->async);
+
+  if(m->timerId != 0) {
+    m->queue->cancel(m->timerId);
+    m->timerId = 0;
+  }
+  if(ms != UART_WAIT_FOREVER)
+    m->timerId = m->queue->call_in(std::chrono::milliseconds(ms), mbedTimeout, m);
+}
+
+static void mbedReadable(uart_async_mbed_t *m) {
+  uartAsyncOnReadable(m->async);
+}
+
+/* Interrupt context: just defer. */
+static void mbedSigio(uart_async_mbed_t *m) {
+  m->queue->call(mbedReadable, m);
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartAsyncMbedInit(uart_async_mbed_t *m, uart_async_t *a, BufferedSerial *serial, events::EventQueue *queue) {
+  m->async = a;
+  m->serial = serial;
+  m->queue = queue;
+  m->timerId = 0;
+  a->rearm = mbedRearm;
+  a->rearmCtx = m;
+  serial->sigio(callback(mbedSigio, m));
+}
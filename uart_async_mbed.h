@@ -0,0 +1,29 @@
+/********************************************************************************************************==*
+*                                      EventQueue driver for asynchronous requests
+* Filename      : uart_async_mbed.h
+**********************************************************************************************************
+* Notes         : The serial port's sigio callback, which runs in interrupt context, only defers to the
+*                 queue; parsing, completions and timeouts all run on the thread dispatching the queue.
+*                 Submit from that thread too, or defer with queue->call(uartAsyncSubmit, async, req).
+*/
+
+#ifndef __UART_ASYNC_MBED_H
+#define __UART_ASYNC_MBED_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "mbed.h"
+#include "uart_async.h"
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uart_async_t *async;
+  BufferedSerial *serial;
+  events::EventQueue *queue;
+  int timerId;       /* pending timeout event, 0 if none */
+} uart_async_mbed_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartAsyncMbedInit(uart_async_mbed_t *m, uart_async_t *a, BufferedSerial *serial, events::EventQueue *queue);
+
+#endif /* __UART_ASYNC_MBED_H */
@@ -0,0 +1,195 @@
+/********************************************************************************************************==*
+*                                      Sensor metadata cache for NNTS
+* Filename      : uart_cache.cpp
+**********************************************************************************************************
+* Notes         : The cache file is the cache_file_t image below followed by nothing else.  It is only
+*                 accepted when magic, size and checksum match, so a file written by a build with a
+*                 different layout is ignored rather than misread.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_cache.h"
+#include "uart_client.h"
+#include "checksum.h"
+#include "uart_log.h"
+#include "uart_platform.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define CACHE_MAGIC         0x4E4D4543    /* "CEMN" */
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uint32_t magic;
+  uint32_t size;
+  uint32_t valid;   /* bit per cacheEntries[] slot */
+  /* replies as they came off the wire */
+  uint8_t version[uart_cmd_desc<CMD_VERSION>::resSize];
+  uint8_t info[uart_cmd_desc<CMD_SENSOR_INFO>::resSize];
+  uint8_t flamID[uart_cmd_desc<CMD_ID>::resSize];
+  uint16_t cksum;
+} cache_file_t;
+
+typedef struct {
+  uint8_t cmdID;
+  uint16_t size;
+  void *data;
+} cache_entry_t;
+
+/* Local variables --------------------------------------------------------------------------------------*/
+static cache_file_t cache;
+static uint32_t lastCycle;
+static uart_mutex_t cacheLock;   /* the sampler and the console thread both read through the cache */
+
+static const cache_entry_t cacheEntries[] = {
+  {CMD_VERSION, sizeof(cache.version), cache.version},
+  {CMD_SENSOR_INFO, sizeof(cache.info), cache.info},
+  {CMD_ID, sizeof(cache.flamID), cache.flamID},
+};
+#define NUM_OF_ENTRIES      (sizeof(cacheEntries) / sizeof(cache_entry_t))
+
+/* Variables --------------------------------------------------------------------------------------------*/
+uart_cache_stats_t uartCacheStats;
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static int cacheFind(uint8_t cmdID) {
+  uint32_t ii;
+
+  for(ii = 0; ii < NUM_OF_ENTRIES; ii++) {
+    if(cacheEntries[ii].cmdID == cmdID)
+      return (int) ii;
+  }
+  return -1;
+}
+
+static uint16_t cacheChecksum(const cache_file_t *image) {
+  return crc_generate((uint8_t *) image, offsetof(cache_file_t, cksum), 0xFFFF);
+}
+
+static void cacheInvalidate(void) {
+  if(cache.valid)
+    uartCacheStats.invalidations++;
+  cache.valid = 0;
+}
+
+static void cacheObserve(const uartReplyHeader_t *reply, const uint8_t *payload) {
+  const cache_entry_t *entry;
+  uint32_t cycle;
+  int ii;
+
+  if(reply->cmdID == CMD_SHUTDOWN) {
+    cacheInvalidate();
+    lastCycle = 0;
+    return;
+  }
+
+  if((reply->cmdID == CMD_ANSWER) && (reply->length >= sizeof(uint32_t))) {
+    cycle = uartLoad32(payload);   /* cycleCount leads answer_t */
+    if(cycle < lastCycle) {
+      if(verbose)
+        uartLog("Cycle count went back (%u < %u), sensor was reset\n", cycle, lastCycle);
+      cacheInvalidate();
+    }
+    lastCycle = cycle;
+    return;
+  }
+
+  if(((ii = cacheFind(reply->cmdID)) < 0) || (reply->length != cacheEntries[ii].size))
+    return;
+
+  entry = &cacheEntries[ii];
+  if(cache.valid & (1u << ii)) {
+    if(memcmp(entry->data, payload, entry->size) == 0)
+      return;
+    uartLog("Reply 0x%x differs from cached copy, dropping cache\n", reply->cmdID);
+    cacheInvalidate();
+  }
+  memcpy(entry->data, payload, entry->size);
+  cache.valid |= 1u << ii;
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+/*
+ * Same contract as the read handlers: fill data with the reply to cmdID.  Cached commands are answered
+ * locally after the first good reply; anything else goes to the sensor.
+ */
+uint32_t uartCacheRead(uint8_t cmdID, uint8_t *data, uint16_t size) {
+  int ii = cacheFind(cmdID);
+
+  uartMutexLock(&cacheLock);
+  if((ii >= 0) && (cache.valid & (1u << ii)) && (size >= cacheEntries[ii].size)) {
+    memcpy(data, cacheEntries[ii].data, cacheEntries[ii].size);
+    memset(&data[cacheEntries[ii].size], 0, size - cacheEntries[ii].size);
+    uartCacheStats.hits++;
+    uartMutexUnlock(&cacheLock);
+    return 0;
+  }
+
+  if(ii >= 0)
+    uartCacheStats.misses++;
+  uartMutexUnlock(&cacheLock);   /* not held across the transaction */
+
+  return uartTransact(cmdID, NULL, 0, data, size);   /* uartCacheObserve() fills the entry */
+}
+
+/* Called for every good reply on uartDefaultSession.  payload may be NULL for replies without one. */
+void uartCacheObserve(const uartReplyHeader_t *reply, const uint8_t *payload) {
+  if(reply->status != UART_SUCCESS)
+    return;
+
+  uartMutexLock(&cacheLock);
+  cacheObserve(reply, payload);
+  uartMutexUnlock(&cacheLock);
+}
+
+void uartCacheInvalidate(void) {
+  uartMutexLock(&cacheLock);
+  cacheInvalidate();
+  uartMutexUnlock(&cacheLock);
+}
+
+/* Returns 0, or -1 if the file could not be written. */
+int uartCacheSave(const char *path) {
+  cache_file_t image;
+  FILE *fp;
+  int rc = 0;
+
+  uartMutexLock(&cacheLock);
+  image = cache;
+  uartMutexUnlock(&cacheLock);
+  image.magic = CACHE_MAGIC;
+  image.size = sizeof(cache_file_t);
+  image.cksum = cacheChecksum(&image);
+
+  if((fp = fopen(path, "wb")) == NULL)
+    return -1;
+  if(fwrite(&image, sizeof(image), 1, fp) != 1)
+    rc = -1;
+  if(fclose(fp) != 0)
+    rc = -1;
+  return rc;
+}
+
+/* Returns 0, or -1 if there is no usable cache file; the cache is left empty then. */
+int uartCacheLoad(const char *path) {
+  cache_file_t image;
+  FILE *fp;
+  size_t n;
+
+  if((fp = fopen(path, "rb")) == NULL)
+    return -1;
+  n = fread(&image, 1, sizeof(image), fp);
+  fclose(fp);
+
+  if((n != sizeof(image)) || (image.magic != CACHE_MAGIC) || (image.size != sizeof(cache_file_t)) ||
+     (image.cksum != cacheChecksum(&image)))
+    return -1;
+
+  uartMutexLock(&cacheLock);
+  cache = image;
+  uartMutexUnlock(&cacheLock);
+  return 0;
+}
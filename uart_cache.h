@@ -0,0 +1,44 @@
+/********************************************************************************************************==*
+*                                      Sensor metadata cache for NNTS
+* Filename      : uart_cache.h
+**********************************************************************************************************
+* Notes         : CMD_VERSION, CMD_SENSOR_INFO and CMD_ID do not change while the sensor is up, so the
+*                 first good reply of each is kept and later reads are answered locally.  The cache
+*                 belongs to the sensor on uartDefaultSession, the one the command handlers talk to: every
+*                 good reply on that session passes through uartCacheObserve(), replies on other sessions
+*                 and on the async engines do not.  The cache is dropped when
+*                   - CMD_SHUTDOWN succeeds,
+*                   - the CMD_ANSWER cycle count goes backwards, i.e. the sensor was reset,
+*                   - a reply for a cached command differs from the cached copy,
+*                 or when the application calls uartCacheInvalidate().
+*
+*                 uartCacheSave() and uartCacheLoad() keep the cache in a file across restarts.  A
+*                 loaded cache is trusted until one of the events above shows it is stale.  All functions
+*                 may be called from any thread.
+*/
+
+#ifndef __UART_CACHE_H
+#define __UART_CACHE_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_proto.h"
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t invalidations;
+} uart_cache_stats_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+uint32_t uartCacheRead(uint8_t cmdID, uint8_t *data, uint16_t size);
+void uartCacheObserve(const uartReplyHeader_t *reply, const uint8_t *payload);
+void uartCacheInvalidate(void);
+int uartCacheSave(const char *path);
+int uartCacheLoad(const char *path);
+
+/* Variables --------------------------------------------------------------------------------------------*/
+extern uart_cache_stats_t uartCacheStats;
+
+#endif /* __UART_CACHE_H */
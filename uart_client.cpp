@@ -0,0 +1,998 @@
+/********************************************************************************************************==*
+*                                      UART client for NNTS
+* Filename      : uart_client.cpp
+**********************************************************************************************************
+* Notes         : Split out of main.cpp so the same protocol code runs on the target and on a Linux host.
+*                 Diagnostics and hexdumps go through uartLog(), which stays off the link timing once the
+*                 log thread runs.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_client.h"
+#include "checksum.h"
+#include "uart_parser.h"
+#include "uart_cache.h"
+#include "uart_rto.h"
+#include "uart_metrics.h"
+#include "uart_log.h"
+#include "uart_format.h"
+#include "uart_platform.h"
+#include "uart_sched.h"
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define NUM_OF_CMDS         (sizeof(uart_cmds) / sizeof(uart_cmd_t))
+
+#define ENGDATA_AHEAD       1     /* chunk requests kept in flight beyond the one being received */
+#define ENGDATA_QUIET_MS    20    /* line idle time that ends a drain when rxTimeout is not set */
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uart_session_t *session;
+  uint8_t cmdID;
+  uint8_t *payload;
+  uint16_t payloadLen;
+  uint32_t status;
+  int done;
+} uart_rx_wait_t;
+
+typedef struct {
+  uint8_t *data;
+  uint32_t size;
+} engdata_mem_t;
+
+typedef struct {
+  uart_session_t *session;
+  uart_batch_entry_t *entries;
+  uint32_t sent;   /* requests on the wire */
+  uint32_t next;   /* first entry still waiting for its reply */
+  uint64_t startUs;
+  int done;
+} uart_batch_wait_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+static uint32_t uartSingleRecv(uart_session_t *s, uint8_t cmdID, uint8_t *payload, uint16_t payloadLen,
+                               uint32_t timeoutMs);
+static uint32_t uartRecvRetry(uart_session_t *s, uint8_t cmdID, uint8_t *payload, uint16_t payloadLen,
+                              uint32_t attempt, uint64_t deadlineUs);
+static uint8_t uartSendFrame(uart_session_t *s, uint8_t cmdID, uint16_t reserved, uint8_t *payload,
+                             uint16_t payloadLen);
+static uint32_t uartEngDataRun(uart_session_t *s, uart_engdata_sink_t *sink, uart_engdata_stats_t *stats);
+static uint8_t uartReSend(uart_session_t *s, uint8_t cmdID);
+static void DumpRqstHdr(const uint8_t *wire);
+static void DumpReplyHdr(const uartReplyHeader_t *);
+static void DumpHexa(uint8_t *p, uint32_t len);
+
+/* Variables --------------------------------------------------------------------------------------------*/
+int uartFP;
+uint32_t verbose = 0, hexdump = 0;
+uint32_t numOfRetries = 0;
+uint32_t rxTimeout = 0, rxBytes = 0, uartState = 0;
+uint32_t rxBudget = 0;
+uint32_t engDataSeek = 0;
+char *filename = NULL;
+#define UART_CMD_ENTRY(id, req, res, fn) {id, uart_cmd_desc<id>::reqSize, uart_cmd_desc<id>::resSize, fn},
+uart_cmd_t uart_cmds[] = {
+  UART_CMD_LIST(UART_CMD_ENTRY)
+};
+#undef UART_CMD_ENTRY
+const uint32_t uartNumOfCmds = NUM_OF_CMDS;
+
+static constexpr uart_cmd_index_t cmdIndex = uartMakeCmdIndex();
+static_assert(NUM_OF_CMDS < 256, "cmdIndex slots are 8 bit");
+
+uart_session_t uartDefaultSession;
+static uart_answer_stage_t *answerStages;
+
+uint8_t uartSend(uint8_t cmdID, uint8_t *payload, uint16_t payloadLen) {
+  return uartSessionSend(&uartDefaultSession, cmdID, 0, payload, payloadLen);
+}
+
+/* uartSend with the reserved header field set, for commands that take an argument there. */
+uint8_t uartSendRqst(uint8_t cmdID, uint16_t reserved, uint8_t *payload, uint16_t payloadLen) {
+  return uartSessionSend(&uartDefaultSession, cmdID, reserved, payload, payloadLen);
+}
+
+uint8_t uartSessionSend(uart_session_t *s, uint8_t cmdID, uint16_t reserved, uint8_t *payload,
+                        uint16_t payloadLen) {
+  uint8_t sts;
+
+  uartSessionLock(s);   /* header and payload go out back to back */
+  sts = uartSendFrame(s, cmdID, reserved, payload, payloadLen);
+  uartSessionUnlock(s);
+  return sts;
+}
+
+/*
+ * Build the request header in wire format, RQST_HDR_LENGTH bytes at wire, checksum included.  Returns 0, or 1
+ * if the payload is missing.
+ */
+uint8_t uartMakeRqstHdr(uint8_t *wire, uint8_t cmdID, uint16_t reserved, const uint8_t *payload,
+                        uint16_t payloadLen) {
+  uartRqstHeader_t header;
+  uint16_t cksum;
+
+  header.cmdID = cmdID;
+  header.length = payloadLen;
+  header.reserved = reserved;
+  header.cksum = 0;
+  uart_codec<uartRqstHeader_t>::encode(&header, wire);
+
+  cksum = crc_generate(wire, RQST_HDR_LENGTH, 0xFFFF);
+
+  if(payloadLen != 0) {
+    if(payload == NULL) {
+      uartLog("No payload given but payload lengh is non-zero\n");
+      return 1;
+    }
+    cksum = crc_generate(payload, payloadLen, cksum);
+  }
+  header.cksum = cksum;
+  uart_codec<uartRqstHeader_t>::encode(&header, wire);
+  return 0;
+}
+
+static uint8_t uartSendFrame(uart_session_t *s, uint8_t cmdID, uint16_t reserved, uint8_t *payload,
+                             uint16_t payloadLen) {
+  uint8_t header[RQST_HDR_LENGTH];
+
+  if(uartMakeRqstHdr(header, cmdID, reserved, payload, payloadLen) != 0)
+    return 1;
+
+  if(verbose) {
+    DumpRqstHdr(header);
+    if(hexdump)
+      DumpHexa(header, RQST_HDR_LENGTH);
+  }
+  
+  s->sentUs = uartMicros();
+  s->sentCmd = cmdID;
+  if(uartTransportWrite(s->link, header, RQST_HDR_LENGTH) != RQST_HDR_LENGTH) {
+    uartLog("Failed to send header: 0x%x, %s (%d)\n", cmdID, strerror(errno), errno);
+    return 1;
+  }
+  
+  if(s->numOfRetries != 0) {
+    memcpy(s->pktHdrCache, header, RQST_HDR_LENGTH);
+    s->payloadCacheLen = 0;
+  }
+
+  if(payloadLen) {
+    if(hexdump) {
+      uartLog("  Payload");
+      DumpHexa(payload, payloadLen);
+    }
+
+    if(uartTransportWrite(s->link, payload, payloadLen) != payloadLen) {
+      uartLog("Failed to send payload: 0x%x, %s (%d)\n", cmdID, strerror(errno), errno);
+      return 1;
+    }
+
+    if(s->numOfRetries != 0) {
+      memcpy(s->payloadCache, payload, payloadLen);
+      s->payloadCacheLen = payloadLen;
+    }
+  }
+
+  uartMetricsAdd(cmdID, UART_MET_REQUESTS, 1);
+  uartMetricsAdd(cmdID, UART_MET_BYTES_OUT, RQST_HDR_LENGTH + payloadLen);
+  return 0;
+}
+
+/* Absolute deadline for a transaction started now with a budget of budgetMs, 0 for none. */
+static uint64_t uartDeadline(uint32_t budgetMs) {
+  return budgetMs ? uartMicros() + (uint64_t) budgetMs * 1000 : 0;
+}
+
+/* ms cut to what is left until deadlineUs (0 = no deadline).  0 when nothing is left. */
+static uint32_t uartClipMs(uint32_t ms, uint64_t deadlineUs) {
+  uint64_t now, left;
+
+  if(deadlineUs == 0)
+    return ms;
+  now = uartMicros();
+  if(now >= deadlineUs)
+    return 0;
+  left = (deadlineUs - now + 999) / 1000;
+  return (left < ms) ? (uint32_t) left : ms;
+}
+
+/* Reply timeout for an attempt: the session's rxTimeout if set, the adaptive estimate otherwise. */
+static uint32_t uartAttemptMs(uart_session_t *s, uint8_t cmdID, uint32_t attempt) {
+  return s->rxTimeout ? s->rxTimeout : uartRtoMs(cmdID, attempt);
+}
+
+/*
+ * Receive the reply to the request just sent, resending it until the session's retries are used up or
+ * deadlineUs passes.  attempt is the number of tries already made.
+ */
+static uint32_t uartRecvRetry(uart_session_t *s, uint8_t cmdID, uint8_t *payload, uint16_t payloadLen,
+                              uint32_t attempt, uint64_t deadlineUs) {
+  uint32_t status, timeoutMs, pauseMs, rttUs, first = attempt;
+  uint64_t startUs;
+
+  for(;;) {
+    timeoutMs = uartClipMs(uartAttemptMs(s, cmdID, attempt), deadlineUs);
+    if(timeoutMs == 0) {
+      uartLog("Latency budget used up: 0x%x\n", cmdID);
+      return UART_LOCAL_ERROR;
+    }
+
+    startUs = uartMicros();
+    status = uartSingleRecv(s, cmdID, payload, payloadLen, timeoutMs);
+    if(status == UART_SUCCESS) {
+      if(s->sentCmd == cmdID) {
+        rttUs = (uint32_t) (uartMicros() - s->sentUs);
+        uartMetricsLatency(cmdID, rttUs);
+        if(attempt == 0)   /* after a resend it is unknown which request was answered */
+          uartRtoSample(cmdID, rttUs);
+      }
+      return status;
+    }
+
+    if(uartMicros() - startUs >= (uint64_t) timeoutMs * 1000) {
+      uartRtoTimedOut(cmdID);
+      pauseMs = 0;   /* waiting out the timeout was pause enough */
+    } else {
+      pauseMs = uartBackoffMs(attempt + 1 - first);
+    }
+    if(++attempt > s->numOfRetries)
+      return status;
+
+    if(pauseMs && ((pauseMs = uartClipMs(pauseMs, deadlineUs)) != 0))
+      uartSleepMs(pauseMs);
+    if(uartReSend(s, cmdID) != 0)
+      return UART_LOCAL_ERROR;
+  }
+}
+
+uint32_t uartRecv(uint8_t cmdID, uint8_t *payload, uint16_t payloadLen) {
+  return uartSessionRecv(&uartDefaultSession, cmdID, payload, payloadLen);
+}
+
+uint32_t uartSessionRecv(uart_session_t *s, uint8_t cmdID, uint8_t *payload, uint16_t payloadLen) {
+  uint32_t status;
+
+  uartSessionLock(s);
+  status = uartRecvRetry(s, cmdID, payload, payloadLen, 0, uartDeadline(s->rxBudget));
+  uartSessionUnlock(s);
+  return status;
+}
+
+/* Request and reply as one transaction: no other thread gets a frame onto the link in between. */
+uint32_t uartTransact(uint8_t cmdID, uint8_t *txPayload, uint16_t txLen, uint8_t *rxPayload, uint16_t rxLen) {
+  return uartSessionTransact(&uartDefaultSession, cmdID, txPayload, txLen, rxPayload, rxLen);
+}
+
+/* uartTransact that gives up once budgetMs have passed, retries included.  budgetMs 0 means no limit. */
+uint32_t uartTransactWithin(uint8_t cmdID, uint8_t *txPayload, uint16_t txLen, uint8_t *rxPayload, uint16_t rxLen,
+                            uint32_t budgetMs) {
+  return uartSessionTransactWithin(&uartDefaultSession, cmdID, txPayload, txLen, rxPayload, rxLen, budgetMs);
+}
+
+uint32_t uartSessionTransact(uart_session_t *s, uint8_t cmdID, uint8_t *txPayload, uint16_t txLen,
+                             uint8_t *rxPayload, uint16_t rxLen) {
+  return uartSessionTransactWithin(s, cmdID, txPayload, txLen, rxPayload, rxLen, s->rxBudget);
+}
+
+uint32_t uartSessionTransactWithin(uart_session_t *s, uint8_t cmdID, uint8_t *txPayload, uint16_t txLen,
+                                   uint8_t *rxPayload, uint16_t rxLen, uint32_t budgetMs) {
+  uint64_t deadlineUs = uartDeadline(budgetMs);
+  uint32_t status = 1;
+
+  uartSchedAcquire(s, UART_PRIO_NORMAL);
+  if(uartSessionSend(s, cmdID, 0, txPayload, txLen) == 0)
+    status = uartRecvRetry(s, cmdID, rxPayload, rxLen, 0, deadlineUs);
+  uartSchedRelease(s);
+  return status;
+}
+
+/*
+ * The link lock is recursive.  Hold it around a sequence of uartSend/uartRecv calls that must not be
+ * interleaved with transactions from other threads.
+ */
+void uartLock(void) {
+  uartSessionLock(&uartDefaultSession);
+}
+
+void uartUnlock(void) {
+  uartSessionUnlock(&uartDefaultSession);
+}
+
+void uartSessionLock(uart_session_t *s) {
+  uartMutexLock(&s->lock);
+  s->depth++;
+}
+
+void uartSessionUnlock(uart_session_t *s) {
+  s->depth--;
+  uartMutexUnlock(&s->lock);
+}
+
+/*
+ * Check a good frame against the request it answers.  The payload has already been streamed into the
+ * caller's buffer by the parser; data is NULL if it did not fit.
+ */
+uint32_t uartCheckReply(uint8_t cmdID, const uartReplyHeader_t *reply, const uint8_t *data,
+                        uint8_t *payload, uint16_t payloadLen) {
+  if(reply->status != UART_SUCCESS) {
+    if(reply->status >= 0x20) {
+      uartLog("Sensor hardware error: 0x%x\n", reply->status);
+    } else {
+      uartLog("Command returned error status: 0x%x\n", reply->status);
+      DumpReplyHdr(reply);
+      uartMetricsAdd(cmdID, (reply->status == UART_CRC_ERROR) ? UART_MET_CRC_ERRORS : UART_MET_ERROR_STATUS, 1);
+      return (reply->status);  /* Sensor sent communication error */
+    }
+  }
+
+  if(reply->cmdID != cmdID) {
+    uartLog("cmdID mismatch: expected 0x%x, received 0x%x\n", cmdID, reply->cmdID);
+    DumpReplyHdr(reply);
+    uartMetricsAdd(cmdID, UART_MET_ID_ERRORS, 1);
+    return UART_LOCAL_ERROR;
+  }
+
+  if(reply->length != 0) {  /* Is there a payload for this reply? */
+    if(data == NULL) {
+      uartLog("Buffer too small for payload (%d < %d)\n", payloadLen, reply->length);
+      uartMetricsAdd(cmdID, UART_MET_LENGTH_ERRORS, 1);
+      return UART_LOCAL_ERROR;
+    }
+
+    /* the payload is already in place, just clear what it did not cover */
+    memset(&payload[reply->length], 0, payloadLen - reply->length);
+  }
+
+  uartMetricsAdd(cmdID, UART_MET_SUCCESSES, 1);
+  uartMetricsAdd(cmdID, UART_MET_BYTES_IN, REPLY_HDR_LENGTH + reply->length);
+  return UART_SUCCESS;
+}
+
+/* Parser callback for a single outstanding request: one reply completes it. */
+static int uartOnReply(void *ctx, const uartReplyHeader_t *reply, const uint8_t *data) {
+  uart_rx_wait_t *wait = (uart_rx_wait_t *) ctx;
+
+  wait->done = 1;
+  wait->status = uartCheckReply(wait->cmdID, reply, data, wait->payload, wait->payloadLen);
+  if((wait->status == UART_SUCCESS) && (wait->session == &uartDefaultSession))
+    uartCacheObserve(reply, wait->payload);
+  return 1;
+}
+
+/* Only known commands with at most their documented reply size can start a reply. */
+int uartCheckReplyHdr(uart_parser_t *p, const uartReplyHeader_t *reply) {
+  uart_cmd_t *cmd = uartFindCmd(reply->cmdID);
+
+  (void) p;
+  return (cmd != NULL) && (reply->length <= cmd->res_size);
+}
+
+/*
+ * Read from the link into the parser until the frame callback sets *done or timeoutMs have passed.
+ * Returns 0, or 1 on a timeout or link error.
+ */
+static int uartPump(uart_session_t *s, const int *done, uint8_t cmdID, uint32_t timeoutMs) {
+  uint64_t deadlineUs = (timeoutMs == UART_WAIT_FOREVER) ? 0 : uartDeadline(timeoutMs);
+  uint32_t crcErrors, waitMs;
+  uint8_t *space;
+  size_t room;
+  int rxLen, sts = 0;
+
+  crcErrors = s->parser.crcErrors;
+
+  while(!*done) {
+    waitMs = deadlineUs ? uartClipMs(timeoutMs, deadlineUs) : UART_WAIT_FOREVER;
+    space = uartParserSpace(&s->parser, &room);
+    rxLen = waitMs ? uartTransportRead(s->link, space, room, waitMs) : 0;
+    if(rxLen == 0) {
+      uartLog("Timed out waiting for reply: 0x%x\n", cmdID);
+      uartMetricsAdd(cmdID, UART_MET_TIMEOUTS, 1);
+      uartParserReset(&s->parser);   /* a partial frame now is junk; start clean for the retry */
+      sts = 1;
+      break;
+    }
+    if(rxLen < 0) {
+      uartLog("Failed to get reply: %s (%d)\n", strerror(errno),  errno);
+      sts = 1;
+      break;
+    }
+    uartParserCommit(&s->parser, rxLen);
+  }
+
+  if(s->parser.crcErrors != crcErrors) {
+    uartLog("Checksum failed on %u frame(s), resynchronized\n", s->parser.crcErrors - crcErrors);
+    uartMetricsAdd(cmdID, UART_MET_CRC_ERRORS, s->parser.crcErrors - crcErrors);
+  }
+  return sts;
+}
+
+static uint32_t uartSingleRecv(uart_session_t *s, uint8_t cmdID, uint8_t *payload, uint16_t payloadLen,
+                               uint32_t timeoutMs) {
+  uart_rx_wait_t wait;
+
+  wait.session = s;
+  wait.cmdID = cmdID;
+  wait.payload = payload;
+  wait.payloadLen = payloadLen;
+  wait.status = UART_LOCAL_ERROR;
+  wait.done = 0;
+  s->parser.ctx = &wait;
+  uartParserSetSink(&s->parser, payload, payloadLen);
+
+  uartPump(s, &wait.done, cmdID, timeoutMs);
+
+  s->parser.ctx = NULL;
+  return wait.status;
+}
+
+/* First entry at or after the batch cursor still waiting for a reply to cmdID. */
+static int uartBatchFind(uart_batch_wait_t *batch, uint8_t cmdID) {
+  uint32_t ii;
+
+  for(ii = batch->next; ii < batch->sent; ii++) {
+    if(batch->entries[ii].cmdID == cmdID)
+      return (int) ii;
+  }
+  return -1;
+}
+
+/* Header check for a batch: also points the parser at the buffer of the entry the reply answers. */
+static int uartBatchRoute(uart_parser_t *p, const uartReplyHeader_t *reply) {
+  uart_batch_wait_t *batch = (uart_batch_wait_t *) p->ctx;
+  int ii;
+
+  if(!uartCheckReplyHdr(p, reply))
+    return 0;
+
+  if((ii = uartBatchFind(batch, reply->cmdID)) < 0)
+    uartParserSetSink(p, NULL, 0);   /* checked and dropped */
+  else
+    uartParserSetSink(p, batch->entries[ii].rxPayload, batch->entries[ii].rxLen);
+  return 1;
+}
+
+/*
+ * Replies arrive in request order.  A reply for a later entry means the ones before it were lost;
+ * they are marked failed and retried after the pipeline drains.
+ */
+static int uartOnBatchReply(void *ctx, const uartReplyHeader_t *reply, const uint8_t *data) {
+  uart_batch_wait_t *batch = (uart_batch_wait_t *) ctx;
+  uart_batch_entry_t *entry;
+  int ii;
+
+  if((ii = uartBatchFind(batch, reply->cmdID)) < 0) {
+    uartLog("Unexpected reply: 0x%x\n", reply->cmdID);
+    return 0;
+  }
+
+  for(; batch->next < (uint32_t) ii; batch->next++)
+    uartLog("No reply for 0x%x\n", batch->entries[batch->next].cmdID);
+
+  entry = &batch->entries[ii];
+  entry->status = uartCheckReply(entry->cmdID, reply, data, entry->rxPayload, entry->rxLen);
+  if(entry->status == UART_SUCCESS) {
+    uartMetricsLatency(entry->cmdID, (uint32_t) (uartMicros() - batch->startUs));
+    if(batch->session == &uartDefaultSession)
+      uartCacheObserve(reply, entry->rxPayload);
+  }
+  batch->next = ii + 1;
+  batch->done = (batch->next == batch->sent);
+  return batch->done;
+}
+
+/*
+ * Send every request of the batch back to back, then collect the replies in order.  Entries that
+ * failed are retried one at a time with the same retry count as uartRecv.  Returns the number of
+ * entries that still failed.
+ */
+uint32_t uartBatch(uart_batch_entry_t *entries, uint32_t count) {
+  return uartSessionBatch(&uartDefaultSession, entries, count);
+}
+
+uint32_t uartSessionBatch(uart_session_t *s, uart_batch_entry_t *entries, uint32_t count) {
+  uart_batch_wait_t batch;
+  uart_batch_entry_t *entry;
+  uint64_t deadlineUs = uartDeadline(s->rxBudget);
+  uint32_t ii, failed = 0, timeoutMs = 0;
+
+  batch.session = s;
+  batch.entries = entries;
+  batch.sent = 0;
+  batch.next = 0;
+  batch.startUs = uartMicros();
+  batch.done = 0;
+
+  uartSchedAcquire(s, UART_PRIO_NORMAL);
+  for(ii = 0; ii < count; ii++) {
+    entries[ii].status = UART_LOCAL_ERROR;
+    if((batch.sent == ii) &&
+       (uartSessionSend(s, entries[ii].cmdID, 0, entries[ii].txPayload, entries[ii].txLen) == 0)) {
+      batch.sent++;
+      timeoutMs += uartAttemptMs(s, entries[ii].cmdID, 0);   /* the replies come back one after the other */
+    }
+  }
+
+  if(batch.sent) {
+    s->parser.ctx = &batch;
+    s->parser.onFrame = uartOnBatchReply;
+    s->parser.checkHeader = uartBatchRoute;
+    timeoutMs = uartClipMs(timeoutMs, deadlineUs);
+    if(timeoutMs != 0)
+      uartPump(s, &batch.done, entries[batch.next < batch.sent ? batch.next : 0].cmdID, timeoutMs);
+    s->parser.onFrame = uartOnReply;
+    s->parser.checkHeader = uartCheckReplyHdr;
+    s->parser.ctx = NULL;
+  }
+
+  for(ii = 0; ii < count; ii++) {
+    entry = &entries[ii];
+    if((entry->status != UART_SUCCESS) && (s->numOfRetries != 0) &&
+       (uartSessionSend(s, entry->cmdID, 0, entry->txPayload, entry->txLen) == 0)) {
+      uartMetricsAdd(entry->cmdID, UART_MET_RETRIES, 1);
+      entry->status = uartRecvRetry(s, entry->cmdID, entry->rxPayload, entry->rxLen, 1, deadlineUs);
+    }
+    if(entry->status != UART_SUCCESS)
+      failed++;
+  }
+  uartSchedRelease(s);
+
+  return failed;
+}
+
+/* Ask for chunk, by number if the sensor can seek and for the next one in the dump otherwise. */
+static uint8_t uartEngDataRequest(uart_session_t *s, uint32_t chunk) {
+  if(!s->engSeek)
+    return uartSessionSend(s, CMD_ENGDATA, 0, NULL, 0);
+  if(chunk > ENGDATA_SEEK_MAX) {
+    uartLog("Engineering data chunk %u is beyond ENGDATA_SEEK\n", chunk);
+    return 1;
+  }
+  return uartSessionSend(s, CMD_ENGDATA, (uint16_t) (ENGDATA_SEEK | chunk), NULL, 0);
+}
+
+/* Anything the parser had to throw away; a frame may have gone with it. */
+static uint32_t uartRxFaults(uart_session_t *s) {
+  return s->parser.crcErrors + s->parser.lengthErrors + s->parser.skippedBytes;
+}
+
+/* Discard everything still on its way, so the next reply answers the next request. */
+static void uartDrain(uart_session_t *s) {
+  uint8_t junk[32];
+  uint32_t quiet = s->rxTimeout ? s->rxTimeout : ENGDATA_QUIET_MS;
+
+  while(uartTransportRead(s->link, junk, sizeof(junk), quiet) > 0)
+    ;
+  uartParserReset(&s->parser);
+}
+
+/*
+ * Without seek: run the dump the sensor is in the middle of out to a good final chunk, so the next
+ * request starts a new one.  A bad chunk may have been the final one, so that just means reading on, up
+ * to numOfRetries bad chunks.  Returns 0, or 1 if the link gave out first.
+ */
+static uint32_t uartEngDataSkip(uart_session_t *s) {
+  uint32_t failed = 0;
+
+  for(;;) {
+    if(uartEngDataRequest(s, 0) != 0)
+      return 1;
+    if(uartSingleRecv(s, CMD_ENGDATA, s->engWire, sizeof(s->engWire),
+                      uartAttemptMs(s, CMD_ENGDATA, 0)) == UART_SUCCESS) {
+      uart_codec<uart_engdata_t>::decode(s->engWire, &s->engChunk);
+      if(s->engChunk.length & FINAL_PACKET)
+        return 0;
+    } else {
+      if(failed++ >= s->numOfRetries)
+        return 1;
+      uartDrain(s);
+    }
+  }
+}
+
+/*
+ * Give up on a download.  Without seek the dump is run out unless final was its end, so the next download
+ * does not start in the middle of it.  Returns 1.
+ */
+static uint32_t uartEngDataAbort(uart_session_t *s, int final) {
+  uartDrain(s);
+  if(!s->engSeek && !final)
+    uartEngDataSkip(s);
+  return 1;
+}
+
+/*
+ * Download the engineering data dump into sink.  Returns 0, or 1 if the download failed or the sink
+ * aborted it.
+ *
+ * With engSeek set each request names its chunk (ENGDATA_SEEK).  The request for the next chunk is
+ * then already on the line while the current one is received and stored, so the sensor never waits for
+ * the host between chunks, and after a failure only that chunk is asked for again, up to numOfRetries
+ * times.  Without it the sensor simply sends the next chunk, which has moved on by the time a chunk is
+ * found bad: one request at a time, and a failure runs the dump out and starts it over, up to
+ * numOfRetries times for the whole download.
+ *
+ * The download runs at UART_PRIO_BULK.  With a scheduler on the session it stops sending ahead as soon
+ * as a higher class waits for the link and hands the link over at the next chunk boundary, with
+ * nothing outstanding; it carries on at the same chunk once they are through.
+ */
+uint32_t uartEngDataDownload(uart_engdata_sink_t *sink, uart_engdata_stats_t *stats) {
+  return uartSessionEngDataDownload(&uartDefaultSession, sink, stats);
+}
+
+uint32_t uartSessionEngDataDownload(uart_session_t *s, uart_engdata_sink_t *sink, uart_engdata_stats_t *stats) {
+  uint32_t sts;
+
+  uartSchedAcquire(s, UART_PRIO_BULK);   /* the whole pipeline is one transaction, bar yields */
+  sts = uartEngDataRun(s, sink, stats);
+  uartSchedRelease(s);
+  return sts;
+}
+
+static uint32_t uartEngDataRun(uart_session_t *s, uart_engdata_sink_t *sink, uart_engdata_stats_t *stats) {
+  uint8_t *chunkWire = s->engWire;
+  uart_engdata_t *chunkBuf = &s->engChunk;
+  uart_engdata_stats_t local;
+  uint32_t chunk = 0, sent = 0, retry = 0, offset = 0, len, status, faults;
+  uint32_t ahead = s->engSeek ? ENGDATA_AHEAD : 0;
+  uint64_t start = uartMicros();
+  int final = 0;
+
+  if(stats == NULL)
+    stats = &local;
+  memset(stats, 0, sizeof(*stats));
+
+  while(!final) {
+    if((sent == chunk) && uartSchedYield(s, UART_PRIO_BULK))
+      stats->yields++;
+    /* the current chunk is always asked for, the ones ahead only while nobody more urgent waits */
+    for(; (sent == chunk) || ((sent <= chunk + ahead) && !uartSchedPending(s, UART_PRIO_BULK)); sent++) {
+      if(uartEngDataRequest(s, sent) != 0)
+        return 1;
+    }
+
+    faults = uartRxFaults(s);
+    /* the chunk before this one may still be ahead of it on the line */
+    status = uartSingleRecv(s, CMD_ENGDATA, chunkWire, sizeof(s->engWire),
+                            (ahead + 1) * uartAttemptMs(s, CMD_ENGDATA, retry));
+    uart_codec<uart_engdata_t>::decode(chunkWire, chunkBuf);
+    len = chunkBuf->length & ~FINAL_PACKET;
+    if((status == UART_SUCCESS) && (len > ENGDATA_CHUNKSIZE)) {
+      uartLog("Bad engineering data chunk length: %u\n", len);
+      status = UART_LOCAL_ERROR;
+    }
+    if((status == UART_SUCCESS) && (uartRxFaults(s) != faults)) {
+      /* replies do not say which chunk they carry: if the parser dropped a frame on the way, this may
+       * well be the reply to the next request */
+      status = UART_LOCAL_ERROR;
+    }
+
+    if(status != UART_SUCCESS) {
+      if(retry++ >= s->numOfRetries) {
+        uartLog("Engineering data chunk %u failed\n", chunk);
+        return uartEngDataAbort(s, 0);
+      }
+      uartMetricsAdd(CMD_ENGDATA, UART_MET_RETRIES, 1);
+      uartDrain(s);   /* the replies to the requests after this one are out of step now */
+      if(!s->engSeek) {
+        /* asking again would get the chunk after this one */
+        if(uartEngDataSkip(s) != 0) {
+          uartLog("Engineering data chunk %u failed, could not restart the dump\n", chunk);
+          return 1;
+        }
+        stats->restarts++;
+        stats->chunks = 0;
+        chunk = 0;
+        offset = 0;
+      } else {
+        stats->retries++;
+      }
+      sent = chunk;
+      continue;
+    }
+
+    if(s->engSeek)
+      retry = 0;
+    final = chunkBuf->length & FINAL_PACKET;
+    if(sink->write(sink->ctx, offset, chunkBuf->data, (uint16_t) len) != 0) {
+      uartLog("Engineering data sink failed at offset %u\n", offset);
+      return uartEngDataAbort(s, final);
+    }
+    offset += len;
+    chunk++;
+    stats->chunks++;
+  }
+
+  /* requests sent past the end get an empty final chunk; collect them to leave the line idle */
+  for(; chunk < sent; chunk++) {
+    if(uartSingleRecv(s, CMD_ENGDATA, chunkWire, sizeof(s->engWire),
+                      uartAttemptMs(s, CMD_ENGDATA, 0)) != UART_SUCCESS) {
+      uartDrain(s);
+      break;
+    }
+  }
+
+  stats->bytes = offset;
+  stats->elapsedUs = (uint32_t) (uartMicros() - start);
+  return 0;
+}
+
+/* Keeps what fits in the buffer and skips the rest. */
+static int engDataMemWrite(void *ctx, uint32_t offset, const uint8_t *data, uint16_t len) {
+  engdata_mem_t *mem = (engdata_mem_t *) ctx;
+
+  if(offset < mem->size)
+    memcpy(&mem->data[offset], data, (mem->size - offset < len) ? mem->size - offset : len);
+  return 0;
+}
+
+static uint8_t uartReSend(uart_session_t *s, uint8_t cmdID) {
+  if(uartTransportWrite(s->link, s->pktHdrCache, RQST_HDR_LENGTH) != RQST_HDR_LENGTH) {
+    uartLog("Failed to ff header: 0x%x, %s (%d)\n", cmdID, strerror(errno), errno);
+    return 1;
+  }
+
+  if(s->payloadCacheLen) {
+    if(uartTransportWrite(s->link, s->payloadCache, s->payloadCacheLen) != s->payloadCacheLen) {
+      uartLog("Failed to send payload: 0x%x, %s (%d)\n", cmdID, strerror(errno), errno);
+      return 1;
+    }
+  }
+
+  uartMetricsAdd(cmdID, UART_MET_REQUESTS, 1);
+  uartMetricsAdd(cmdID, UART_MET_RETRIES, 1);
+  uartMetricsAdd(cmdID, UART_MET_BYTES_OUT, RQST_HDR_LENGTH + s->payloadCacheLen);
+  return 0;
+}
+
+uint32_t ReadFloat(uint8_t cmdID, uint8_t *data, uint16_t size) {
+  char line[UART_FMT_LINE_MAX];
+  float value;
+
+  if((size < sizeof(value)) || (uartTransact(cmdID, NULL, 0, data, size) != 0))
+    return 1;
+
+  uart_codec<float>::decode(data, &value);
+  if(!uartReadingFeed(cmdID, value, uartMicros()))
+    return 0;
+  uartLogText(line, uartFormatReading(line, sizeof(line), cmdID, value, uartFmtStyle, uartFmtDecimals));
+
+  return 0;
+}
+
+/*
+ * Full environment poll in one pipelined batch instead of one round trip per value.
+ * concentration may be NULL.  humidAirDensity is not reported by the sensor and is left alone.
+ */
+uint32_t ReadEnvironment(enviro_reply_t *env, float *concentration) {
+  uint8_t wire[5][sizeof(float)];
+  uart_batch_entry_t batch[5] = {
+    {CMD_TEMP, NULL, 0, wire[0], sizeof(float), 0},
+    {CMD_PRES, NULL, 0, wire[1], sizeof(float), 0},
+    {CMD_REL_HUM, NULL, 0, wire[2], sizeof(float), 0},
+    {CMD_ABS_HUM, NULL, 0, wire[3], sizeof(float), 0},
+    {CMD_CONC, NULL, 0, wire[4], sizeof(float), 0},
+  };
+  float *value[5] = {&env->temp, &env->pressure, &env->humidity, &env->absHumidity, concentration};
+  uint32_t ii, count = concentration ? 5 : 4;
+  char line[UART_FMT_LINE_MAX];
+  uint64_t now;
+
+  if(uartBatch(batch, count) != 0)
+    return 1;
+
+  now = uartMicros();
+  for(ii = 0; ii < count; ii++) {
+    uart_codec<float>::decode(wire[ii], value[ii]);
+    if(!uartReadingFeed(batch[ii].cmdID, *value[ii], now))
+      continue;
+    uartLogText(line, uartFormatReading(line, sizeof(line), batch[ii].cmdID, *value[ii], uartFmtStyle,
+                                        uartFmtDecimals));
+  }
+  return 0;
+}
+
+uint32_t ReadInteger(uint8_t cmdID, uint8_t *data, uint16_t size) {
+  uint32_t value;
+
+  if((size < sizeof(value)) || (uartCacheRead(cmdID, data, size) != 0))
+    return 1;
+
+  uart_codec<uint32_t>::decode(data, &value);
+  uartLog("Command[0x%02x]: %lu\n", cmdID, (unsigned long) value);
+
+  return 0;
+}
+
+uint32_t ReadSensorInfo(uint8_t cmdID, uint8_t *data, uint16_t size) {
+  uart_sensor_info_t sensor;
+
+  if((size < sizeof(sensor)) || (uartCacheRead(cmdID, data, size) != 0))
+    return 1;
+
+  uart_codec<uart_sensor_info_t>::decode(data, &sensor);
+  uartLog("Sensor Name: %.32s\nSensor Type: %d\nCalibration Date: %.16s\nManufactured Date: %.16s\n",
+         sensor.sensorName, sensor.sensorType, sensor.calDate, sensor.mfgDate);
+
+  return 0;
+}
+
+uint32_t ReadVersion(uint8_t cmdID, uint8_t *data, uint16_t size) {
+  uart_version_t version;
+  if((size < sizeof(version)) || (uartCacheRead(cmdID, data, size) != 0))
+    return 1;
+
+  uart_codec<uart_version_t>::decode(data, &version);
+  uartLog("SW Version: %u.%u.%u.%u, HW Version: %u.%u, Protocol: %u.%u\n",
+         version.sw_w, version.sw_x, version.sw_y, version.sw_z,
+         version.hw_w, version.hw_x, version.proto_w, version.proto_x);
+  return 0;
+}
+
+uint32_t ReadString(uint8_t cmdID, uint8_t *data, uint16_t size) {
+  if(uartTransact(cmdID, NULL, 0, data, size) != 0)
+    return 1;
+
+  uartLog("%s\n", data);
+  return 0;
+}
+
+
+
+uint32_t ReadByte(uint8_t cmdID, uint8_t *data, uint16_t size) {
+
+  if(uartTransact(cmdID, NULL, 0, data, size) != 0)
+    return 1;
+
+  uartLog("Command[0x%02x]: 0x%x\n", cmdID, *data);
+
+  return 0;
+}
+
+uint32_t WriteByte(uint8_t cmdID, uint8_t *data, uint16_t size) {
+  if(uartTransact(cmdID, data, size, NULL, 0) != 0)
+    return 1;
+
+  return 0;
+}
+
+uint32_t WriteFloat(uint8_t cmdID, uint8_t *data, uint16_t size) {
+  uint8_t wire[uart_codec<float>::wireSize];
+  uint32_t val;
+  float fval;
+
+  uart_codec<uint32_t>::decode(data, &val);
+  fval = ((float) val) / 100.0;
+  uart_codec<float>::encode(&fval, wire);
+
+  uartLog("%s: %d %f\n", __FUNCTION__, val, fval);
+  if(uartTransact(cmdID, wire, sizeof(wire), NULL, 0) != 0)
+    return 1;
+
+  return 0;
+}
+
+static void DumpRqstHdr(const uint8_t *wire) {
+  uartRqstHeader_t rqst;
+
+  uart_codec<uartRqstHeader_t>::decode(wire, &rqst);
+  uartLog("----\nREQUEST:\n");
+  uartLog("  Hdr Size: %u\n", RQST_HDR_LENGTH);
+  uartLog("  CmdID: 0x%x\n", rqst.cmdID);
+  uartLog("  Length: %d\n", rqst.length);
+  uartLog("  Reserved: 0x%x\n", rqst.reserved);
+  uartLog("  Checksum: 0x%x\n", rqst.cksum);
+}
+
+uint32_t ReadEngData(uint8_t cmdID, uint8_t *data, uint16_t size) {
+  uart_engdata_stats_t stats;
+  uart_engdata_sink_t sink;
+  engdata_mem_t mem;
+
+  mem.data = data;
+  mem.size = size;
+  sink.ctx = &mem;
+  sink.write = engDataMemWrite;
+  if(uartEngDataDownload(&sink, &stats) != 0)
+    return 1;
+
+  uartLog("Engineering data: %u bytes in %u chunks, %u retries, %u us, %u bytes/s\n", stats.bytes, stats.chunks,
+          stats.retries, stats.elapsedUs,
+          (uint32_t) ((uint64_t) stats.bytes * 1000000 / (stats.elapsedUs ? stats.elapsedUs : 1)));
+  if(stats.bytes > size)
+    uartLog("Buffer too small, kept the first %u bytes\n", size);
+  return 0;
+}
+
+static void DumpReplyHdr(const uartReplyHeader_t *reply) {
+  uartLog("----\nREPLY:\n");
+  uartLog("  CmdID: 0x%x\n", reply->cmdID);
+  uartLog("  Status: 0x%x\n", reply->status);
+  uartLog("  Length: %d\n", reply->length);
+  uartLog("  Checksum: 0x%x\n", reply->cksum);
+}
+
+uint32_t ReadAnswer(uint8_t cmdID, uint8_t *data, uint16_t size) {
+  char text[UART_FMT_LINE_MAX];
+  answer_t answer;
+
+  if((size < sizeof(answer)) || (uartTransact(cmdID, NULL, 0, data, size) != 0))
+    return 1;
+
+  uart_codec<answer_t>::decode(data, &answer);
+  if(!uartAnswerFeed(&answer, uartMicros()))
+    return 0;
+#ifdef FLAMMABLE
+  uartLogText(text, uartFormatAnswer(text, sizeof(text), &answer, uartFmtStyle, uartFmtDecimals));
+#endif
+  return 0;
+}
+
+/* Append stage to the answer pipeline.  The pipeline is not locked: set it up before answers flow, and
+ * feed it from one thread at a time. */
+void uartAnswerAddStage(uart_answer_stage_t *stage) {
+  uart_answer_stage_t **link = &answerStages;
+
+  while(*link != NULL)
+    link = &(*link)->next;
+  stage->next = NULL;
+  *link = stage;
+}
+
+/* Run answer, taken at timeUs, through the pipeline.  Returns 1 if it came out of the last stage. */
+int uartAnswerFeed(const answer_t *answer, uint64_t timeUs) {
+  uart_answer_stage_t *stage;
+
+  for(stage = answerStages; stage != NULL; stage = stage->next) {
+    if(!stage->process(stage, answer, timeUs))
+      return 0;
+  }
+  return 1;
+}
+
+/* The same for a float reading of cmdID. */
+int uartReadingFeed(uint8_t cmdID, float value, uint64_t timeUs) {
+  uart_answer_stage_t *stage;
+
+  for(stage = answerStages; stage != NULL; stage = stage->next) {
+    if((stage->reading != NULL) && !stage->reading(stage, cmdID, value, timeUs))
+      return 0;
+  }
+  return 1;
+}
+
+static void DumpHexa(uint8_t  *p, uint32_t len) {
+  uartLogHex(p, len);
+}
+
+void uartSetTransport(uart_transport_t *t) {
+  uartSessionInit(&uartDefaultSession, t);
+}
+
+/* Attach s to link t, with the retry and timeout settings that are in force now. */
+void uartSessionInit(uart_session_t *s, uart_transport_t *t) {
+  s->link = t;
+  s->depth = 0;
+  s->sched = NULL;
+  uartParserInit(&s->parser, uartOnReply, NULL);
+  s->parser.checkHeader = uartCheckReplyHdr;
+  s->numOfRetries = numOfRetries;
+  s->rxTimeout = rxTimeout;
+  s->rxBudget = rxBudget;
+  s->engSeek = engDataSeek;
+  s->sentUs = 0;
+  s->sentCmd = 0;
+  s->payloadCacheLen = 0;
+}
+
+/* Constant time: one load from the index generated with the table.  Called for every reply header. */
+uart_cmd_t *uartFindCmd(uint8_t cmdID) {
+  uint8_t slot = cmdIndex.slot[cmdID];
+
+  return slot ? &uart_cmds[slot - 1] : NULL;
+}
@@ -0,0 +1,206 @@
+/********************************************************************************************************==*
+*                                      UART client for NNTS
+* Filename      : uart_client.h
+**********************************************************************************************************
+* Notes         : Request/reply handling and command handlers.  Everything the client keeps about a link
+*                 lives in a uart_session_t, so one process can talk to any number of sensors; the
+*                 uartSession* functions take the session, the others use uartDefaultSession, the link
+*                 installed with uartSetTransport().  The command handlers always go through the default
+*                 session.  verbose and hexdump and the metrics stay process wide; the metadata cache
+*                 follows the default session only.
+*/
+
+#ifndef __UART_CLIENT_H
+#define __UART_CLIENT_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_proto.h"
+#include "uart_transport.h"
+#include "uart_parser.h"
+#include "uart_cmdtab.h"
+#include "uart_platform.h"
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uint8_t cmdID;
+  uint16_t req_size;   /* Request size */
+  uint16_t res_size;   /* Response size */
+  uint32_t (*func)(uint8_t cmdID, uint8_t *data, uint16_t size);
+} uart_cmd_t;
+
+/* One request of a pipelined batch, see uartBatch(). */
+typedef struct {
+  uint8_t cmdID;
+  uint8_t *txPayload;
+  uint16_t txLen;
+  uint8_t *rxPayload;
+  uint16_t rxLen;
+  uint32_t status;   /* UART_SUCCESS or the error of the last attempt */
+} uart_batch_entry_t;
+
+/* Where ReadEngData/uartEngDataDownload put the dump. */
+typedef struct {
+  void *ctx;
+  /* Store len bytes found at offset in the dump.  Return non-zero to abort the download. */
+  int (*write)(void *ctx, uint32_t offset, const uint8_t *data, uint16_t len);
+} uart_engdata_sink_t;
+
+typedef struct {
+  uint32_t bytes;
+  uint32_t chunks;
+  uint32_t retries;     /* chunks requested again after a failure */
+  uint32_t restarts;    /* downloads started over after a failure, without seek */
+  uint32_t elapsedUs;
+  uint32_t yields;      /* times the link was handed to a higher priority class, see uart_sched.h */
+} uart_engdata_stats_t;
+
+struct uart_sched;
+
+/*
+ * A stage of the answer pipeline.  Every answer_t that ReadAnswer decodes, or that is fed in with
+ * uartAnswerFeed(), goes through the stages in turn; a stage embeds this as its first member.  process
+ * returns non-zero to pass the answer on to the next stage, and after the last one to the console.
+ * The float readings of ReadFloat take the same way through reading, a stage without one passes them.
+ */
+typedef struct uart_answer_stage {
+  int (*process)(struct uart_answer_stage *stage, const answer_t *answer, uint64_t timeUs);
+  int (*reading)(struct uart_answer_stage *stage, uint8_t cmdID, float value, uint64_t timeUs);
+  struct uart_answer_stage *next;
+} uart_answer_stage_t;
+
+/* Per-link state.  The settings are copied from numOfRetries, rxTimeout, rxBudget and engDataSeek by
+ * uartSessionInit() and may be changed afterwards. */
+typedef struct {
+  uart_transport_t *link;
+  uart_parser_t parser;
+  uart_mutex_t lock;        /* one transaction on the link at a time */
+  uint32_t depth;           /* how often the owner of lock has taken it */
+  struct uart_sched *sched; /* orders waiting transactions by priority, NULL: first come first served */
+  uint32_t numOfRetries;
+  uint32_t rxTimeout;
+  uint32_t rxBudget;
+  uint32_t engSeek;
+
+  uint64_t sentUs;          /* when the last request went out, for the round trip estimate */
+  uint8_t sentCmd;
+  uint8_t pktHdrCache[RQST_HDR_LENGTH];   /* last request, for resending it */
+  uint8_t payloadCache[256];
+  uint16_t payloadCacheLen;
+  uint8_t engWire[uart_codec<uart_engdata_t>::wireSize];
+  uart_engdata_t engChunk;
+} uart_session_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartSetTransport(uart_transport_t *t);
+void uartSessionInit(uart_session_t *s, uart_transport_t *t);
+uart_cmd_t *uartFindCmd(uint8_t cmdID);
+
+uint8_t uartSend(uint8_t cmdID, uint8_t *payload, uint16_t payloadLen);
+uint8_t uartSendRqst(uint8_t cmdID, uint16_t reserved, uint8_t *payload, uint16_t payloadLen);
+uint32_t uartRecv(uint8_t cmdID, uint8_t *payload, uint16_t payloadLen);
+uint8_t uartMakeRqstHdr(uint8_t *wire, uint8_t cmdID, uint16_t reserved, const uint8_t *payload,
+                        uint16_t payloadLen);
+uint32_t uartCheckReply(uint8_t cmdID, const uartReplyHeader_t *reply, const uint8_t *data,
+                        uint8_t *payload, uint16_t payloadLen);
+int uartCheckReplyHdr(uart_parser_t *p, const uartReplyHeader_t *reply);
+uint32_t uartTransact(uint8_t cmdID, uint8_t *txPayload, uint16_t txLen, uint8_t *rxPayload, uint16_t rxLen);
+uint32_t uartTransactWithin(uint8_t cmdID, uint8_t *txPayload, uint16_t txLen, uint8_t *rxPayload, uint16_t rxLen,
+                            uint32_t budgetMs);
+void uartLock(void);
+void uartUnlock(void);
+uint32_t uartBatch(uart_batch_entry_t *entries, uint32_t count);
+uint32_t uartEngDataDownload(uart_engdata_sink_t *sink, uart_engdata_stats_t *stats);
+
+uint8_t uartSessionSend(uart_session_t *s, uint8_t cmdID, uint16_t reserved, uint8_t *payload,
+                        uint16_t payloadLen);
+uint32_t uartSessionRecv(uart_session_t *s, uint8_t cmdID, uint8_t *payload, uint16_t payloadLen);
+uint32_t uartSessionTransact(uart_session_t *s, uint8_t cmdID, uint8_t *txPayload, uint16_t txLen,
+                             uint8_t *rxPayload, uint16_t rxLen);
+uint32_t uartSessionTransactWithin(uart_session_t *s, uint8_t cmdID, uint8_t *txPayload, uint16_t txLen,
+                                   uint8_t *rxPayload, uint16_t rxLen, uint32_t budgetMs);
+void uartSessionLock(uart_session_t *s);
+void uartSessionUnlock(uart_session_t *s);
+uint32_t uartSessionBatch(uart_session_t *s, uart_batch_entry_t *entries, uint32_t count);
+uint32_t uartSessionEngDataDownload(uart_session_t *s, uart_engdata_sink_t *sink, uart_engdata_stats_t *stats);
+
+uint32_t ReadFloat(uint8_t cmdID, uint8_t *data, uint16_t size);
+uint32_t ReadInteger(uint8_t cmdID, uint8_t *data, uint16_t size);
+uint32_t ReadVersion(uint8_t cmdID, uint8_t *data, uint16_t size);
+uint32_t ReadString(uint8_t cmdID, uint8_t *data, uint16_t size);
+uint32_t ReadAnswer(uint8_t cmdID, uint8_t *data, uint16_t size);
+uint32_t ReadSensorInfo(uint8_t cmdID, uint8_t *data, uint16_t size);
+uint32_t ReadByte(uint8_t cmdID, uint8_t *data, uint16_t size);
+uint32_t WriteByte(uint8_t cmdID, uint8_t *data, uint16_t size);
+uint32_t WriteFloat(uint8_t cmdID, uint8_t *data, uint16_t size);
+uint32_t ReadEngData(uint8_t cmdID, uint8_t *data, uint16_t size);
+uint32_t ReadEnvironment(enviro_reply_t *env, float *concentration);
+void uartAnswerAddStage(uart_answer_stage_t *stage);
+int uartAnswerFeed(const answer_t *answer, uint64_t timeUs);
+int uartReadingFeed(uint8_t cmdID, float value, uint64_t timeUs);
+
+/*
+ * Typed transactions: sizes come from UART_CMD_LIST, so a payload of the wrong type does not compile.
+ * uartRead<CMD_TEMP>(&temp) is uartTransact(CMD_TEMP, NULL, 0, ...) with the reply decoded into temp;
+ * value is only written on success.  The forms with a session first go through that session.
+ */
+template<uint8_t CMD>
+uint32_t uartRead(uart_session_t *s, typename uart_cmd_desc<CMD>::reply_t *value) {
+  typedef uart_cmd_desc<CMD> desc;
+  static_assert(desc::reqSize == 0, "command takes a request payload, use uartTransact");
+  static_assert(desc::resSize != 0, "command has no reply payload, use uartWrite");
+  uint8_t buf[desc::resSize];
+  uint32_t sts;
+
+  sts = uartSessionTransact(s, CMD, NULL, 0, buf, desc::resSize);
+  if(sts == UART_SUCCESS)
+    uart_codec<typename desc::reply_t>::decode(buf, value);
+  return sts;
+}
+
+template<uint8_t CMD>
+uint32_t uartRead(typename uart_cmd_desc<CMD>::reply_t *value) {
+  typedef uart_cmd_desc<CMD> desc;
+  static_assert(desc::reqSize == 0, "command takes a request payload, use uartTransact");
+  static_assert(desc::resSize != 0, "command has no reply payload, use uartWrite");
+  uint8_t buf[desc::resSize];
+  uint32_t sts;
+
+  sts = uartTransact(CMD, NULL, 0, buf, desc::resSize);
+  if(sts == UART_SUCCESS)
+    uart_codec<typename desc::reply_t>::decode(buf, value);
+  return sts;
+}
+
+/* value is NULL for commands without a request payload. */
+template<uint8_t CMD>
+uint32_t uartWrite(uart_session_t *s, const typename uart_cmd_desc<CMD>::request_t *value) {
+  typedef uart_cmd_desc<CMD> desc;
+  static_assert(desc::resSize == 0, "command has a reply payload, use uartRead");
+  uint8_t buf[desc::reqSize ? desc::reqSize : 1];
+
+  uart_codec<typename desc::request_t>::encode(value, buf);
+  return uartSessionTransact(s, CMD, desc::reqSize ? buf : NULL, desc::reqSize, NULL, 0);
+}
+
+template<uint8_t CMD>
+uint32_t uartWrite(const typename uart_cmd_desc<CMD>::request_t *value) {
+  typedef uart_cmd_desc<CMD> desc;
+  static_assert(desc::resSize == 0, "command has a reply payload, use uartRead");
+  uint8_t buf[desc::reqSize ? desc::reqSize : 1];
+
+  uart_codec<typename desc::request_t>::encode(value, buf);
+  return uartTransact(CMD, desc::reqSize ? buf : NULL, desc::reqSize, NULL, 0);
+}
+
+/* Variables --------------------------------------------------------------------------------------------*/
+extern uart_cmd_t uart_cmds[];
+extern const uint32_t uartNumOfCmds;
+extern uart_session_t uartDefaultSession;
+extern uint32_t verbose, hexdump;
+extern uint32_t numOfRetries;   /* defaults for new sessions, and those below */
+extern uint32_t rxTimeout;   /* fixed reply timeout in ms, 0 adapts it per command, see uart_rto.h */
+extern uint32_t rxBudget;    /* total time a transaction may take with its retries in ms, 0 = no limit */
+extern uint32_t engDataSeek; /* the sensor honours ENGDATA_SEEK; its firmware does not define it, so 0 */
+
+#endif /* __UART_CLIENT_H */
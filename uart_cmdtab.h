@@ -0,0 +1,130 @@
+/********************************************************************************************************==*
+*                                      Command table for NNTS
+* Filename      : uart_cmdtab.h
+**********************************************************************************************************
+* Notes         : UART_CMD_LIST is the one place a command is described: its ID, the type of its request
+*                 payload, the type of its reply payload and its console handler.  Everything else is
+*                 generated from it - uart_cmds[], the 256-entry cmdID index behind uartFindCmd() and the
+*                 uart_cmd_desc<> specializations used by the typed uartRead<>/uartWrite<> calls.
+*
+*                 void means the command has no payload in that direction.  Sizes are wire sizes and
+*                 payloads are moved with uart_codec<> (uart_wire.h), so a reply is never read through a
+*                 cast pointer.
+*/
+
+#ifndef __UART_CMDTAB_H
+#define __UART_CMDTAB_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_proto.h"
+#include "uart_wire.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define UART_CMD_REQ_MAX    256   /* largest request payload, see payloadCache in uart_client.cpp */
+
+#ifdef FLAMMABLE
+#define UART_CMD_LIST_FLAM(X) \
+  X(CMD_CONC,        void,     float,              ReadFloat) \
+  X(CMD_ID,          void,     uint32_t,           ReadInteger)
+#else
+#define UART_CMD_LIST_FLAM(X)
+#endif
+
+#ifdef CMD_WRITE_FLOAT
+#define UART_CMD_LIST_WRITE_FLOAT(X) \
+  X(CMD_WRITE_FLOAT, float,    void,               WriteFloat)
+#else
+#define UART_CMD_LIST_WRITE_FLOAT(X)
+#endif
+
+/*       cmdID           request   reply               handler */
+#define UART_CMD_LIST(X) \
+  X(CMD_ANSWER,      void,     answer_t,           ReadAnswer) \
+  X(CMD_MEAS,        uint8_t,  void,               WriteByte) \
+  UART_CMD_LIST_FLAM(X) \
+  X(CMD_ENGDATA,     void,     uart_engdata_t,     ReadEngData) \
+  X(CMD_TEMP,        void,     float,              ReadFloat) \
+  X(CMD_PRES,        void,     float,              ReadFloat) \
+  X(CMD_REL_HUM,     void,     float,              ReadFloat) \
+  X(CMD_ABS_HUM,     void,     float,              ReadFloat) \
+  X(CMD_STATUS,      void,     uint8_t,            ReadByte) \
+  X(CMD_VERSION,     void,     uart_version_t,     ReadVersion) \
+  X(CMD_SENSOR_INFO, void,     uart_sensor_info_t, ReadSensorInfo) \
+  X(CMD_SHUTDOWN,    void,     void,               WriteByte) \
+  UART_CMD_LIST_WRITE_FLOAT(X)
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+/* Compile-time description of a command.  Using a cmdID that is not in UART_CMD_LIST does not compile. */
+template<uint8_t CMD> struct uart_cmd_desc;
+
+#define UART_CMD_DESC(id, req, res, fn) \
+  template<> struct uart_cmd_desc<id> { \
+    typedef req request_t; \
+    typedef res reply_t; \
+    static constexpr uint8_t cmdID = id; \
+    static constexpr uint16_t reqSize = uart_codec<req>::wireSize; \
+    static constexpr uint16_t resSize = uart_codec<res>::wireSize; \
+    static_assert(reqSize <= UART_CMD_REQ_MAX, #id ": request payload too large"); \
+    static_assert(resSize <= UART_MAX_DATA_SIZE - REPLY_HDR_LENGTH, #id ": reply payload too large"); \
+  };
+UART_CMD_LIST(UART_CMD_DESC)
+#undef UART_CMD_DESC
+
+/* cmdID -> position in uart_cmds[] plus one, 0 for commands not in the list. */
+typedef struct {
+  uint8_t slot[256];
+} uart_cmd_index_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+#define UART_CMD_ID(id, req, res, fn) id,
+
+constexpr uart_cmd_index_t uartMakeCmdIndex(void) {
+  const uint8_t ids[] = { UART_CMD_LIST(UART_CMD_ID) };
+  uart_cmd_index_t index = {};
+
+  for(uint32_t ii = 0; ii < sizeof(ids); ii++)
+    index.slot[ids[ii]] = (uint8_t) (ii + 1);
+  return index;
+}
+
+constexpr uint32_t uartCmdListCount(void) {
+  const uint8_t ids[] = { UART_CMD_LIST(UART_CMD_ID) };
+
+  return sizeof(ids);
+}
+
+/* Non-zero if no cmdID appears twice in UART_CMD_LIST. */
+constexpr int uartCmdListUnique(void) {
+  const uint8_t ids[] = { UART_CMD_LIST(UART_CMD_ID) };
+
+  for(uint32_t ii = 0; ii < sizeof(ids); ii++) {
+    for(uint32_t jj = ii + 1; jj < sizeof(ids); jj++) {
+      if(ids[ii] == ids[jj])
+        return 0;
+    }
+  }
+  return 1;
+}
+
+#undef UART_CMD_ID
+
+#define UART_CMD_RES_SIZE(id, req, res, fn) uart_cmd_desc<id>::resSize,
+
+/* Largest reply payload of any command in the list. */
+constexpr uint16_t uartCmdResMax(void) {
+  const uint16_t sizes[] = { UART_CMD_LIST(UART_CMD_RES_SIZE) };
+  uint16_t max = 0;
+
+  for(uint32_t ii = 0; ii < sizeof(sizes) / sizeof(sizes[0]); ii++) {
+    if(sizes[ii] > max)
+      max = sizes[ii];
+  }
+  return max;
+}
+
+#undef UART_CMD_RES_SIZE
+
+static_assert(uartCmdListUnique(), "cmdID listed twice in UART_CMD_LIST");
+
+#endif /* __UART_CMDTAB_H */
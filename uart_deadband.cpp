@@ -0,0 +1,203 @@
+/********************************************************************************************************==*
+*                                      Change-driven reporting for NNTS
+* Filename      : uart_deadband.cpp
+**********************************************************************************************************
+* Notes         : The band is measured from the value last reported, not the last one seen, so a slow
+*                 drift is reported once it adds up to a whole band.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_deadband.h"
+#include "uart_format.h"
+#include "uart_log.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static float dbValue(const answer_t *a, uint32_t field) {
+  switch(field) {
+    case 0: return a->concentration;
+    case 1: return a->temp;
+    case 2: return a->pressure;
+    case 3: return a->relHumidity;
+    default: return a->absHumidity;
+  }
+}
+
+/* Field of a float reading, or -1 for commands the deadband does not track. */
+static int dbField(uint8_t cmdID) {
+  switch(cmdID) {
+#ifdef FLAMMABLE
+    case CMD_CONC: return 0;
+#endif
+    case CMD_TEMP: return 1;
+    case CMD_PRES: return 2;
+    case CMD_REL_HUM: return 3;
+    case CMD_ABS_HUM: return 4;
+    default: return -1;
+  }
+}
+
+static int dbMoved(const uart_db_band_t *b, float last, float x) {
+  float d;
+
+  if(isnan(x) || isnan(last))
+    return isnan(x) != isnan(last);
+  d = fabsf(x - last);
+  if((b->abs <= 0) && (b->rel <= 0))
+    return d != 0;
+  return ((b->abs > 0) && (d > b->abs)) || ((b->rel > 0) && (d > b->rel * fabsf(last)));
+}
+
+/* why bits that are not about the value itself. */
+static uint32_t dbWhy(uart_deadband_t *db, uart_db_source_t *src, uint64_t timeUs) {
+  if(!src->valid)
+    return UART_DB_FIRST;
+  if(db->cfg.heartbeatMs && (timeUs - src->timeUs >= (uint64_t) db->cfg.heartbeatMs * 1000))
+    return UART_DB_HEARTBEAT;
+  return 0;
+}
+
+/* Report r, or count the reading as held back if why is 0.  The reading is consumed either way. */
+static int dbEmit(uart_deadband_t *db, uart_db_source_t *src, uart_db_report_t *r) {
+  char text[UART_FMT_LINE_MAX];
+
+  if(r->why == 0) {
+    src->suppressed++;
+    db->suppressed++;
+    return 0;
+  }
+  r->suppressed = src->suppressed;
+  src->valid = 1;
+  src->timeUs = r->timeUs;
+  src->suppressed = 0;
+  db->reports++;
+
+  if(db->report != NULL)
+    db->report(db->ctx, r);
+  else
+    uartLogText(text, uartDeadbandFormat(text, sizeof(text), r, uartFmtStyle, uartFmtDecimals));
+  return 0;
+}
+
+static int dbProcess(uart_answer_stage_t *stage, const answer_t *answer, uint64_t timeUs) {
+  uart_deadband_t *db = (uart_deadband_t *) stage;
+  uart_db_report_t r;
+  uint32_t ii;
+
+  r.cmdID = CMD_ANSWER;
+  r.answer = answer;
+  r.value = 0;
+  r.timeUs = timeUs;
+  r.why = dbWhy(db, &db->answerSrc, timeUs);
+  if(db->answerSrc.valid) {
+    if(answer->flamID != db->answer.flamID)
+      r.why |= UART_DB_FLAM;
+    for(ii = 0; ii < UART_DB_FIELDS; ii++) {
+      if(dbMoved(&db->cfg.band[ii], dbValue(&db->answer, ii), dbValue(answer, ii))) {
+        r.why |= UART_DB_MOVED;
+        break;
+      }
+    }
+  }
+  if(r.why)
+    db->answer = *answer;
+  return dbEmit(db, &db->answerSrc, &r);
+}
+
+static int dbReading(uart_answer_stage_t *stage, uint8_t cmdID, float value, uint64_t timeUs) {
+  uart_deadband_t *db = (uart_deadband_t *) stage;
+  uart_db_report_t r;
+  int field = dbField(cmdID);
+
+  if(field < 0)
+    return 1;
+  r.cmdID = cmdID;
+  r.answer = NULL;
+  r.value = value;
+  r.timeUs = timeUs;
+  r.why = dbWhy(db, &db->readingSrc[field], timeUs);
+  if(db->readingSrc[field].valid && dbMoved(&db->cfg.band[field], db->reading[field], value))
+    r.why |= UART_DB_MOVED;
+  if(r.why)
+    db->reading[field] = value;
+  return dbEmit(db, &db->readingSrc[field], &r);
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+/*
+ * Bands of a few sensor resolution steps: 0.05 concentration, 0.1 degrees, 0.05 pressure, 0.5 relative
+ * and 0.05 absolute humidity, with a heartbeat a minute.  Set them to the noise of the sensor at hand.
+ */
+void uartDeadbandDefaults(uart_db_cfg_t *cfg) {
+  static const float band[UART_DB_FIELDS] = {0.05f, 0.1f, 0.05f, 0.5f, 0.05f};
+  uint32_t ii;
+
+  for(ii = 0; ii < UART_DB_FIELDS; ii++) {
+    cfg->band[ii].abs = band[ii];
+    cfg->band[ii].rel = 0;
+  }
+  cfg->heartbeatMs = 60000;
+}
+
+/* report may be NULL.  Add the stage to the pipeline with uartAnswerAddStage(&db->stage). */
+void uartDeadbandInit(uart_deadband_t *db, const uart_db_cfg_t *cfg, uart_db_report_cb_t report, void *ctx) {
+  db->stage.process = dbProcess;
+  db->stage.reading = dbReading;
+  db->stage.next = NULL;
+  db->cfg = *cfg;
+  db->report = report;
+  db->ctx = ctx;
+  memset(&db->answerSrc, 0, sizeof(db->answerSrc));
+  memset(db->readingSrc, 0, sizeof(db->readingSrc));
+  db->reports = 0;
+  db->suppressed = 0;
+}
+
+/*
+ * The reading as uartFormatAnswer() or uartFormatReading() write it, with the held back count added: a
+ * last CSV column, a "suppressed" JSON member, or in text a "Suppressed:" line after an answer and
+ * "(n suppressed)" after a reading.  Returns the length, or 0 if it did not fit.
+ */
+uint32_t uartDeadbandFormat(char *buf, uint32_t size, const uart_db_report_t *r, uint32_t style, uint32_t decimals) {
+  char suffix[32];
+  uint32_t len, pos, n;
+  int w;
+
+  if(r->answer != NULL)
+    len = uartFormatAnswer(buf, size, r->answer, style, decimals);
+  else
+    len = uartFormatReading(buf, size, r->cmdID, r->value, style, decimals);
+  if(len == 0)
+    return 0;
+
+  switch(style) {
+    case UART_FMT_CSV:
+      w = snprintf(suffix, sizeof(suffix), ",%lu", (unsigned long) r->suppressed);
+      pos = len - 1;
+      break;
+    case UART_FMT_JSON:
+      w = snprintf(suffix, sizeof(suffix), ",\"suppressed\":%lu", (unsigned long) r->suppressed);
+      pos = len - 2;
+      break;
+    default:
+      if(r->answer != NULL) {
+        w = snprintf(suffix, sizeof(suffix), "Suppressed: %lu\n", (unsigned long) r->suppressed);
+        pos = len;
+      } else {
+        w = snprintf(suffix, sizeof(suffix), " (%lu suppressed)", (unsigned long) r->suppressed);
+        pos = len - 1;
+      }
+      break;
+  }
+  n = (uint32_t) w;
+  if(len + n >= size) {
+    buf[0] = '\0';
+    return 0;
+  }
+  memmove(buf + pos + n, buf + pos, len - pos + 1);
+  memcpy(buf + pos, suffix, n);
+  return len + n;
+}
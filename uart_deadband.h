@@ -0,0 +1,87 @@
+/********************************************************************************************************==*
+*                                      Change-driven reporting for NNTS
+* Filename      : uart_deadband.h
+**********************************************************************************************************
+* Notes         : An answer pipeline stage (uart_client.h) that reports a reading only when it matters:
+*                 the first one, a field that moved out of its deadband around the value last reported,
+*                 a change of flamID, or heartbeatMs without a report.  Each report carries the number of
+*                 readings held back since the one before, so a quiet sensor is still seen to be alive and
+*                 polled.  Held back readings are never formatted.
+*
+*                 A field moves when it differs from the last reported value by more than abs, or by more
+*                 than rel times that value; a band of 0 leaves that test out, with both 0 any change
+*                 counts.  A NaN moves unless the last value was NaN as well.
+*
+*                 answer_t readings and the float readings of CMD_CONC, CMD_TEMP, CMD_PRES, CMD_REL_HUM and
+*                 CMD_ABS_HUM are tracked apart; other commands pass.  The stage takes what it reports off
+*                 the pipeline, so it goes last.
+*/
+
+#ifndef __UART_DEADBAND_H
+#define __UART_DEADBAND_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_client.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define UART_DB_FIELDS          5     /* concentration, temp, pressure, relHumidity, absHumidity */
+
+/* why a reading was reported, see uart_db_report_t */
+#define UART_DB_FIRST           0x01
+#define UART_DB_MOVED           0x02
+#define UART_DB_FLAM            0x04
+#define UART_DB_HEARTBEAT       0x08
+
+/* CSV column names of a reported answer in uartDeadbandFormat() */
+#define UART_DB_ANSWER_CSV_HEADER   "cycle,conc,flamID,temp,pres,relHum,absHum,suppressed\n"
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  float abs;
+  float rel;
+} uart_db_band_t;
+
+typedef struct {
+  uart_db_band_t band[UART_DB_FIELDS];
+  uint32_t heartbeatMs;       /* 0: no heartbeat */
+} uart_db_cfg_t;
+
+typedef struct {
+  uint8_t cmdID;              /* CMD_ANSWER, or the command of a float reading */
+  const answer_t *answer;     /* CMD_ANSWER only */
+  float value;                /* float readings only */
+  uint64_t timeUs;
+  uint32_t suppressed;        /* readings of the same source held back since its last report */
+  uint32_t why;               /* UART_DB_ bits */
+} uart_db_report_t;
+
+/* Gets each report.  Without one the report is printed in uartFmtStyle through uartLogText(). */
+typedef void (*uart_db_report_cb_t)(void *ctx, const uart_db_report_t *r);
+
+/* What was last reported from one source. */
+typedef struct {
+  int valid;
+  uint64_t timeUs;
+  uint32_t suppressed;
+} uart_db_source_t;
+
+typedef struct {
+  uart_answer_stage_t stage;  /* first: the pipeline sees the deadband through it */
+  uart_db_cfg_t cfg;
+  uart_db_report_cb_t report;
+  void *ctx;
+  uart_db_source_t answerSrc;
+  answer_t answer;
+  uart_db_source_t readingSrc[UART_DB_FIELDS];
+  float reading[UART_DB_FIELDS];
+  uint32_t reports;
+  uint32_t suppressed;        /* all held back readings */
+} uart_deadband_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartDeadbandDefaults(uart_db_cfg_t *cfg);
+void uartDeadbandInit(uart_deadband_t *db, const uart_db_cfg_t *cfg, uart_db_report_cb_t report, void *ctx);
+uint32_t uartDeadbandFormat(char *buf, uint32_t size, const uart_db_report_t *r, uint32_t style, uint32_t decimals);
+
+#endif /* __UART_DEADBAND_H */
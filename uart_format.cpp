@@ -0,0 +1,269 @@
+/********************************************************************************************************==*
+*                                      Reading formatter for NNTS
+* Filename      : uart_format.cpp
+**********************************************************************************************************
+* Notes         : Digits are produced backwards into a small scratch buffer and copied out once.  The only
+*                 floating point is splitting a value into its integer part and its scaled fraction; the
+*                 integer part only needs 64-bit division above 2^32.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_format.h"
+#include <string.h>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define fmtLiteral(o, s)    fmtPut(o, s, sizeof(s) - 1)
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  char *p;
+  char *end;        /* last byte, kept for the NUL */
+  int full;
+} fmt_out_t;
+
+/* Local variables --------------------------------------------------------------------------------------*/
+static const char fmtPairs[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+static const uint32_t fmtPow10[UART_FMT_DECIMALS_MAX + 1] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+static const char fmtHex[] = "0123456789abcdef";
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static void fmtInit(fmt_out_t *o, char *buf, uint32_t size) {
+  o->p = buf;
+  o->end = buf + (size ? size - 1 : 0);
+  o->full = (size == 0);
+}
+
+static uint32_t fmtDone(fmt_out_t *o, char *buf, uint32_t size) {
+  if(o->full) {
+    if(size)
+      buf[0] = '\0';
+    return 0;
+  }
+  *o->p = '\0';
+  return (uint32_t) (o->p - buf);
+}
+
+static void fmtPut(fmt_out_t *o, const char *s, uint32_t n) {
+  if(o->full || ((uint32_t) (o->end - o->p) < n)) {
+    o->full = 1;
+    return;
+  }
+  memcpy(o->p, s, n);
+  o->p += n;
+}
+
+/* Exactly n digits of v, leading zeros included, written backwards ending at p. */
+static char *fmtFixedBack(char *p, uint32_t v, uint32_t n) {
+  for(; n >= 2; n -= 2) {
+    p -= 2;
+    memcpy(p, &fmtPairs[(v % 100) * 2], 2);
+    v /= 100;
+  }
+  if(n)
+    *--p = (char) ('0' + v % 10);
+  return p;
+}
+
+/* Digits of v without leading zeros, written backwards ending at p. */
+static char *fmtUintBack(char *p, uint64_t v) {
+  uint32_t lo;
+
+  while(v > 0xFFFFFFFFu) {
+    p = fmtFixedBack(p, (uint32_t) (v % 100000000), 8);
+    v /= 100000000;
+  }
+  for(lo = (uint32_t) v; lo >= 100; lo /= 100) {
+    p -= 2;
+    memcpy(p, &fmtPairs[(lo % 100) * 2], 2);
+  }
+  if(lo >= 10) {
+    p -= 2;
+    memcpy(p, &fmtPairs[lo * 2], 2);
+  } else {
+    *--p = (char) ('0' + lo);
+  }
+  return p;
+}
+
+static void fmtUint(fmt_out_t *o, uint32_t v) {
+  char tmp[10], *p = fmtUintBack(tmp + sizeof(tmp), v);
+
+  fmtPut(o, p, (uint32_t) (tmp + sizeof(tmp) - p));
+}
+
+static void fmtInt(fmt_out_t *o, int32_t v) {
+  char tmp[11], *p = fmtUintBack(tmp + sizeof(tmp), (v < 0) ? 0u - (uint32_t) v : (uint32_t) v);
+
+  if(v < 0)
+    *--p = '-';
+  fmtPut(o, p, (uint32_t) (tmp + sizeof(tmp) - p));
+}
+
+/* "0x%02x" */
+static void fmtCmd(fmt_out_t *o, uint8_t cmdID) {
+  char tmp[4] = {'0', 'x', fmtHex[cmdID >> 4], fmtHex[cmdID & 0xF]};
+
+  fmtPut(o, tmp, sizeof(tmp));
+}
+
+/* "%.*f" with round half to even on exact ties, as printf does. */
+static void fmtFloat(fmt_out_t *o, float value, uint32_t decimals, int json) {
+  char tmp[32], *p = tmp + sizeof(tmp);
+  uint32_t bits, fi;
+  uint64_t ip;
+  double frac, rem;
+  float mag;
+
+  if(decimals > UART_FMT_DECIMALS_MAX)
+    decimals = UART_FMT_DECIMALS_MAX;
+  memcpy(&bits, &value, sizeof(bits));
+  mag = (bits & 0x80000000u) ? -value : value;
+
+  if(value != value) {
+    if(json)
+      fmtLiteral(o, "null");
+    else
+      fmtLiteral(o, "nan");
+    return;
+  }
+  if(mag >= 18446744073709551616.0f) {   /* 2^64, infinity included */
+    if(json) {
+      fmtLiteral(o, "null");
+      return;
+    }
+    if(bits & 0x80000000u)
+      fmtLiteral(o, "-");
+    fmtPut(o, ((bits & 0x7FFFFFFFu) == 0x7F800000u) ? "inf" : "ovf", 3);
+    return;
+  }
+
+  ip = (uint64_t) mag;
+  frac = ((double) mag - (double) ip) * fmtPow10[decimals];   /* exact: 24 bits times at most 5^9 */
+  fi = (uint32_t) frac;
+  rem = frac - fi;
+  if((rem > 0.5) || ((rem == 0.5) && ((decimals ? fi : (uint32_t) ip) & 1))) {
+    if(++fi == fmtPow10[decimals]) {
+      fi = 0;
+      ip++;
+    }
+  }
+
+  if(decimals) {
+    p = fmtFixedBack(p, fi, decimals);
+    *--p = '.';
+  }
+  p = fmtUintBack(p, ip);
+  if(bits & 0x80000000u)
+    *--p = '-';
+  fmtPut(o, p, (uint32_t) (tmp + sizeof(tmp) - p));
+}
+
+/* Field separator, plus the quoted key for JSON; the first field opens the object instead. */
+static void fmtField(fmt_out_t *o, const char *key, int first, int json) {
+  if(json) {
+    fmtPut(o, first ? "{\"" : ",\"", 2);
+    fmtPut(o, key, (uint32_t) strlen(key));
+    fmtLiteral(o, "\":");
+  } else if(!first) {
+    fmtLiteral(o, ",");
+  }
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+uint32_t uartFormatFloat(char *buf, uint32_t size, float value, uint32_t decimals) {
+  fmt_out_t o;
+
+  fmtInit(&o, buf, size);
+  fmtFloat(&o, value, decimals, 0);
+  return fmtDone(&o, buf, size);
+}
+
+/* One scalar reading: "Command[0x21]: 23.500000", "0x21,23.500000" or {"cmd":"0x21","value":23.500000}. */
+uint32_t uartFormatReading(char *buf, uint32_t size, uint8_t cmdID, float value, uint32_t style,
+                           uint32_t decimals) {
+  fmt_out_t o;
+
+  fmtInit(&o, buf, size);
+  switch(style) {
+    case UART_FMT_CSV:
+      fmtCmd(&o, cmdID);
+      fmtLiteral(&o, ",");
+      fmtFloat(&o, value, decimals, 0);
+      break;
+    case UART_FMT_JSON:
+      fmtLiteral(&o, "{\"cmd\":\"");
+      fmtCmd(&o, cmdID);
+      fmtLiteral(&o, "\",\"value\":");
+      fmtFloat(&o, value, decimals, 1);
+      fmtLiteral(&o, "}");
+      break;
+    default:
+      fmtLiteral(&o, "Command[");
+      fmtCmd(&o, cmdID);
+      fmtLiteral(&o, "]: ");
+      fmtFloat(&o, value, decimals, 0);
+      break;
+  }
+  fmtLiteral(&o, "\n");
+  return fmtDone(&o, buf, size);
+}
+
+/* A whole answer_t, as ReadAnswer prints it or as one CSV/JSON record. */
+uint32_t uartFormatAnswer(char *buf, uint32_t size, const answer_t *answer, uint32_t style, uint32_t decimals) {
+  fmt_out_t o;
+  int json = (style == UART_FMT_JSON);
+
+  fmtInit(&o, buf, size);
+  switch(style) {
+    case UART_FMT_CSV:
+    case UART_FMT_JSON:
+      fmtField(&o, "cycle", 1, json);
+      fmtUint(&o, answer->cycleCount);
+      fmtField(&o, "conc", 0, json);
+      fmtFloat(&o, answer->concentration, decimals, json);
+      fmtField(&o, "flamID", 0, json);
+      fmtUint(&o, answer->flamID);
+      fmtField(&o, "temp", 0, json);
+      fmtFloat(&o, answer->temp, decimals, json);
+      fmtField(&o, "pres", 0, json);
+      fmtFloat(&o, answer->pressure, decimals, json);
+      fmtField(&o, "relHum", 0, json);
+      fmtFloat(&o, answer->relHumidity, decimals, json);
+      fmtField(&o, "absHum", 0, json);
+      fmtFloat(&o, answer->absHumidity, decimals, json);
+      if(json)
+        fmtLiteral(&o, "}");
+      fmtLiteral(&o, "\n");
+      break;
+    default:
+      fmtLiteral(&o, "Cycle: ");
+      fmtUint(&o, answer->cycleCount);
+      fmtLiteral(&o, "\nGas: ");
+      fmtInt(&o, (int32_t) answer->flamID);
+      fmtLiteral(&o, "\nConcentration: ");
+      fmtFloat(&o, answer->concentration, decimals, 0);
+      fmtLiteral(&o, "\nTEMP: ");
+      fmtFloat(&o, answer->temp, decimals, 0);
+      fmtLiteral(&o, "\nPRESS: ");
+      fmtFloat(&o, answer->pressure, decimals, 0);
+      fmtLiteral(&o, "\nREL_HUM: ");
+      fmtFloat(&o, answer->relHumidity, decimals, 0);
+      fmtLiteral(&o, "\nABS_HUM: ");
+      fmtFloat(&o, answer->absHumidity, decimals, 0);
+      fmtLiteral(&o, "\n");
+      break;
+  }
+  return fmtDone(&o, buf, size);
+}
+
+/* Variables --------------------------------------------------------------------------------------------*/
+uint32_t uartFmtStyle = UART_FMT_HUMAN;
+uint32_t uartFmtDecimals = 6;
@@ -0,0 +1,44 @@
+/********************************************************************************************************==*
+*                                      Reading formatter for NNTS
+* Filename      : uart_format.h
+**********************************************************************************************************
+* Notes         : Turns readings into text without printf: the fraction is scaled to an integer once and
+*                 the digits come two at a time from a table.  For decimals 0..UART_FMT_DECIMALS_MAX the
+*                 digits are the ones printf("%.*f") gives, rounding included, since a float times a power
+*                 of ten up to 1e9 is exact in a double.  Magnitudes of 2^64 and up are written as "ovf".
+*
+*                 Every function writes a NUL-terminated line into the caller's buffer and returns its
+*                 length, or 0 (and an empty string) if it did not fit.  UART_FMT_HUMAN is the text the
+*                 handlers always printed; UART_FMT_CSV and UART_FMT_JSON give one record per line for
+*                 loggers, JSON writes null for NaN and infinity.
+*/
+
+#ifndef __UART_FORMAT_H
+#define __UART_FORMAT_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_proto.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define UART_FMT_HUMAN          0
+#define UART_FMT_CSV            1
+#define UART_FMT_JSON           2
+
+#define UART_FMT_DECIMALS_MAX   9
+#define UART_FMT_LINE_MAX       256     /* enough for any line below at UART_FMT_DECIMALS_MAX */
+
+/* CSV column names, in the order uartFormatAnswer() writes them */
+#define UART_FMT_ANSWER_CSV_HEADER  "cycle,conc,flamID,temp,pres,relHum,absHum\n"
+
+/* Functions --------------------------------------------------------------------------------------------*/
+uint32_t uartFormatFloat(char *buf, uint32_t size, float value, uint32_t decimals);
+uint32_t uartFormatReading(char *buf, uint32_t size, uint8_t cmdID, float value, uint32_t style,
+                           uint32_t decimals);
+uint32_t uartFormatAnswer(char *buf, uint32_t size, const answer_t *answer, uint32_t style, uint32_t decimals);
+
+/* Variables --------------------------------------------------------------------------------------------*/
+extern uint32_t uartFmtStyle;      /* style of the readings the handlers print */
+extern uint32_t uartFmtDecimals;   /* decimals of those readings, 6 as with %f */
+
+#endif /* __UART_FORMAT_H */
@@ -0,0 +1,394 @@
+/********************************************************************************************************==*
+*                                      Deferred diagnostics for NNTS
+* Filename      : uart_log.cpp
+**********************************************************************************************************
+* Notes         : A bounded multi-producer ring with a sequence number per record.  A record at position
+*                 pos is free while its sequence is pos, filled once it is pos + 1, and handed back to the
+*                 producers as pos + UART_LOG_RECORDS when the drain thread is done with it.
+*
+*                 The format is walked twice: when logging, to take each argument off the va_list with
+*                 its real type, and when draining, to hand each conversion to printf with that type
+*                 again.  Only the second walk produces text.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_log.h"
+#include "uart_platform.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define LOG_MASK            (UART_LOG_RECORDS - 1)
+#define LOG_NO_STRING       0xFFFF    /* %s argument that did not fit in the record */
+#define LOG_SPEC_MAX        16        /* longest conversion handed to printf, "%-08.3lx" and the like */
+
+#define LOG_KIND_FORMAT     0         /* fmt and args */
+#define LOG_KIND_HEX        1         /* hexdump bytes, args[0] offset, args[1] last */
+#define LOG_KIND_TEXT       2         /* text printed as it is */
+
+static_assert((UART_LOG_RECORDS & LOG_MASK) == 0, "UART_LOG_RECORDS must be a power of two");
+static_assert(UART_LOG_DATA <= 255, "record data length is 8 bit");
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  std::atomic<uint32_t> seq;
+  const char *fmt;
+  uint8_t kind;
+  uint8_t argc;
+  uint8_t dataLen;
+  uint64_t args[UART_LOG_ARGS];
+  uint8_t data[UART_LOG_DATA];
+} log_rec_t;
+
+/* One conversion of a format string. */
+typedef struct {
+  const char *start;            /* the '%' */
+  const char *end;              /* one past the conversion character */
+  int precision;                /* -1 if not given */
+  char length;                  /* 0, h, H (hh), l, L (ll), q (L), z, j or t */
+  char conv;
+} log_spec_t;
+
+/* Local variables --------------------------------------------------------------------------------------*/
+static log_rec_t logRing[UART_LOG_RECORDS];
+static std::atomic<uint32_t> logHead(0);      /* next position to claim, shared by the producers */
+static uint32_t logTail;                      /* next position to drain, drain thread only */
+static std::atomic<int> logDeferred(0);
+static std::atomic<uint32_t> logDropped(0);
+static uint32_t logRecords, logReported;
+static int logReady;
+
+/* Local functions --------------------------------------------------------------------------------------*/
+/* Next conversion at or after p, NULL when there is none.  "%%" comes back as a conversion of its own. */
+static const char *logNextSpec(const char *p, log_spec_t *spec) {
+  if((p = strchr(p, '%')) == NULL)
+    return NULL;
+
+  spec->start = p++;
+  spec->precision = -1;
+  spec->length = 0;
+  while((*p != '\0') && (strchr("-+ #0", *p) != NULL))
+    p++;
+  while((*p >= '0') && (*p <= '9'))
+    p++;
+  if(*p == '.') {
+    spec->precision = 0;
+    for(p++; (*p >= '0') && (*p <= '9'); p++)
+      spec->precision = spec->precision * 10 + (*p - '0');
+  }
+
+  switch(*p) {
+    case 'h': spec->length = (p[1] == 'h') ? 'H' : 'h'; break;
+    case 'l': spec->length = (p[1] == 'l') ? 'L' : 'l'; break;
+    case 'L': spec->length = 'q'; break;
+    case 'z': case 'j': case 't': spec->length = *p; break;
+    default: break;
+  }
+  if(spec->length != 0)
+    p += ((spec->length == 'H') || (spec->length == 'L')) ? 2 : 1;
+
+  spec->conv = *p;
+  spec->end = (*p != '\0') ? p + 1 : p;
+  return spec->start;
+}
+
+static int logIsFloat(char conv) {
+  return (conv != '\0') && (strchr("fFeEgGaA", conv) != NULL);
+}
+
+/* Take the argument for spec off ap and store it in rec; strings are copied into rec->data. */
+static void logCapture(log_rec_t *rec, const log_spec_t *spec, va_list *ap) {
+  uint64_t *arg = &rec->args[rec->argc++];
+  const char *s;
+  uint32_t n, room;
+  double d;
+
+  if(logIsFloat(spec->conv)) {
+    d = (spec->length == 'q') ? (double) va_arg(*ap, long double) : va_arg(*ap, double);
+    memcpy(arg, &d, sizeof(d));
+    return;
+  }
+
+  switch(spec->conv) {
+    case 's':
+      s = va_arg(*ap, const char *);
+      room = UART_LOG_DATA - rec->dataLen;
+      if((s == NULL) || (room == 0)) {
+        *arg = LOG_NO_STRING;
+        break;
+      }
+      for(n = 0; (n < room - 1) && ((spec->precision < 0) || (n < (uint32_t) spec->precision)) && s[n]; n++)
+        ;
+      memcpy(&rec->data[rec->dataLen], s, n);
+      rec->data[rec->dataLen + n] = '\0';
+      *arg = rec->dataLen;
+      rec->dataLen += n + 1;
+      break;
+    case 'p':
+      *arg = (uintptr_t) va_arg(*ap, void *);
+      break;
+    default:
+      switch(spec->length) {
+        case 'l': *arg = (uint64_t) va_arg(*ap, long); break;
+        case 'L': *arg = (uint64_t) va_arg(*ap, long long); break;
+        case 'z': *arg = (uint64_t) va_arg(*ap, size_t); break;
+        case 'j': *arg = (uint64_t) va_arg(*ap, intmax_t); break;
+        case 't': *arg = (uint64_t) va_arg(*ap, ptrdiff_t); break;
+        default: *arg = (uint64_t) va_arg(*ap, int); break;   /* char and short arrive as int */
+      }
+      break;
+  }
+}
+
+/* printf one conversion with the argument it was captured with. */
+static void logEmit(const log_rec_t *rec, const log_spec_t *spec, uint64_t arg) {
+  char f[LOG_SPEC_MAX];
+  size_t len = spec->end - spec->start;
+  double d;
+
+  if(len >= sizeof(f)) {
+    fwrite(spec->start, 1, len, stdout);
+    return;
+  }
+  memcpy(f, spec->start, len);
+  f[len] = '\0';
+
+  if(logIsFloat(spec->conv)) {
+    memcpy(&d, &arg, sizeof(d));
+    if(spec->length == 'q')
+      printf(f, (long double) d);
+    else
+      printf(f, d);
+    return;
+  }
+
+  switch(spec->conv) {
+    case 's': printf(f, (arg == LOG_NO_STRING) ? "" : (const char *) &rec->data[arg]); break;
+    case 'p': printf(f, (void *) (uintptr_t) arg); break;
+    default:
+      switch(spec->length) {
+        case 'l': printf(f, (long) arg); break;
+        case 'L': printf(f, (long long) arg); break;
+        case 'z': printf(f, (size_t) arg); break;
+        case 'j': printf(f, (intmax_t) arg); break;
+        case 't': printf(f, (ptrdiff_t) arg); break;
+        default: printf(f, (int) arg); break;
+      }
+      break;
+  }
+}
+
+/* Bytes offset.. of a hexdump, eight to a line, in the layout DumpHexa always had. */
+static void logHexLines(uint32_t offset, const uint8_t *p, uint32_t len, int last) {
+  uint32_t ii;
+
+  for(ii = 0; ii < len; ii++) {
+    if(((offset + ii) % 8) == 0)
+      printf("\n    [%02u]: ", offset + ii);
+    printf("0x%02x ", p[ii]);
+  }
+  if(last)
+    printf("\n");
+}
+
+static void logFormat(const log_rec_t *rec) {
+  const char *p = rec->fmt;
+  log_spec_t spec;
+  uint32_t argc = 0;
+
+  if(rec->kind == LOG_KIND_HEX) {
+    logHexLines((uint32_t) rec->args[0], rec->data, rec->dataLen, (int) rec->args[1]);
+    return;
+  }
+  if(rec->kind == LOG_KIND_TEXT) {
+    fwrite(rec->data, 1, rec->dataLen, stdout);
+    return;
+  }
+
+  while(logNextSpec(p, &spec) != NULL) {
+    fwrite(p, 1, spec.start - p, stdout);
+    if(spec.conv == '%')
+      putchar('%');
+    else if(argc < rec->argc)
+      logEmit(rec, &spec, rec->args[argc++]);
+    else
+      fwrite(spec.start, 1, spec.end - spec.start, stdout);   /* more conversions than UART_LOG_ARGS */
+    p = spec.end;
+  }
+  fputs(p, stdout);
+}
+
+/*
+ * Claim the next count free records, all of them or none: returns 0 and the first position, or -1 (and
+ * counts them dropped) if the ring has no room for them all.  Records are freed in order, so the last of
+ * them being free means the ones before it are as well.
+ */
+static int logClaim(uint32_t *pos, uint32_t count) {
+  uint32_t at = logHead.load(std::memory_order_relaxed);
+  int32_t diff;
+
+  if(count > UART_LOG_RECORDS) {
+    logDropped.fetch_add(count, std::memory_order_relaxed);
+    return -1;
+  }
+  for(;;) {
+    diff = (int32_t) (logRing[(at + count - 1) & LOG_MASK].seq.load(std::memory_order_acquire) - (at + count - 1));
+    if(diff == 0) {
+      if(logHead.compare_exchange_weak(at, at + count, std::memory_order_relaxed))
+        break;
+    } else if(diff < 0) {
+      logDropped.fetch_add(count, std::memory_order_relaxed);
+      return -1;
+    } else {
+      at = logHead.load(std::memory_order_relaxed);
+    }
+  }
+
+  *pos = at;
+  return 0;
+}
+
+/* The record claimed at pos, made ready to be filled with kind. */
+static log_rec_t *logRecord(uint32_t pos, uint8_t kind) {
+  log_rec_t *rec = &logRing[pos & LOG_MASK];
+
+  rec->kind = kind;
+  rec->argc = 0;
+  rec->dataLen = 0;
+  return rec;
+}
+
+static void logPublish(log_rec_t *rec, uint32_t pos) {
+  rec->seq.store(pos + 1, std::memory_order_release);
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartLog(const char *fmt, ...) {
+  log_rec_t *rec;
+  log_spec_t spec;
+  const char *p;
+  uint32_t pos;
+  va_list ap;
+
+  va_start(ap, fmt);
+  if(!logDeferred.load(std::memory_order_acquire)) {
+    vprintf(fmt, ap);
+  } else if(logClaim(&pos, 1) == 0) {
+    rec = logRecord(pos, LOG_KIND_FORMAT);
+    rec->fmt = fmt;
+    for(p = fmt; (rec->argc < UART_LOG_ARGS) && (logNextSpec(p, &spec) != NULL); p = spec.end) {
+      if(spec.conv != '%')
+        logCapture(rec, &spec, &ap);
+    }
+    logPublish(rec, pos);
+  }
+  va_end(ap);
+}
+
+/*
+ * Copy len bytes into as many records of kind as it takes, claimed together so the bytes are printed
+ * whole or not at all.  Returns 0, or -1 if they were dropped.
+ */
+static int logBytes(uint8_t kind, const uint8_t *p, uint32_t len) {
+  log_rec_t *rec;
+  uint32_t pos, offset = 0, n;
+
+  if(logClaim(&pos, len ? (len + UART_LOG_DATA - 1) / UART_LOG_DATA : 1) != 0)
+    return -1;
+  do {
+    n = (len - offset < UART_LOG_DATA) ? len - offset : UART_LOG_DATA;
+    rec = logRecord(pos, kind);
+    rec->fmt = NULL;
+    rec->args[0] = offset;
+    rec->args[1] = (offset + n == len);
+    memcpy(rec->data, &p[offset], n);
+    rec->dataLen = (uint8_t) n;
+    logPublish(rec, pos++);
+    offset += n;
+  } while(offset < len);
+  return 0;
+}
+
+/* Hexdump of len bytes. */
+void uartLogHex(const uint8_t *p, uint32_t len) {
+  if(!logDeferred.load(std::memory_order_acquire))
+    logHexLines(0, p, len, 1);
+  else
+    logBytes(LOG_KIND_HEX, p, len);
+}
+
+/* Text that is already formatted, e.g. by uart_format.h, printed as it is. */
+void uartLogText(const char *text, uint32_t len) {
+  if(!logDeferred.load(std::memory_order_acquire))
+    fwrite(text, 1, len, stdout);
+  else
+    logBytes(LOG_KIND_TEXT, (const uint8_t *) text, len);
+}
+
+/*
+ * Format every record that is ready.  Returns the number formatted.  Only one thread may drain: the one
+ * in uartLogRun(), or any thread while that is not running.
+ */
+uint32_t uartLogDrain(void) {
+  log_rec_t *rec;
+  uint32_t n = 0, dropped;
+
+  for(;;) {
+    rec = &logRing[logTail & LOG_MASK];
+    if(rec->seq.load(std::memory_order_acquire) != logTail + 1)
+      break;
+    logFormat(rec);
+    rec->seq.store(logTail + UART_LOG_RECORDS, std::memory_order_release);
+    logTail++;
+    n++;
+  }
+  logRecords += n;
+
+  dropped = logDropped.load(std::memory_order_relaxed);
+  if(dropped != logReported) {
+    printf("Log ring full, %u record(s) dropped\n", dropped - logReported);
+    logReported = dropped;
+  }
+  if(n)
+    fflush(stdout);
+  return n;
+}
+
+/*
+ * From now on uartLog() only records.  uartLogRun() does this itself; calling it before starting that
+ * thread makes sure nothing logged in the meantime is printed inline.
+ */
+void uartLogStart(void) {
+  uint32_t ii;
+
+  if(!logReady) {
+    for(ii = 0; ii < UART_LOG_RECORDS; ii++)
+      logRing[ii].seq.store(ii, std::memory_order_relaxed);
+    logReady = 1;
+  }
+  logDeferred.store(1, std::memory_order_release);
+}
+
+/*
+ * Drain thread: formats what uartLog() recorded until *stop is set, then prints what is left and goes
+ * back to printing directly.  Run it at a lower priority than anything on the link.
+ */
+void uartLogRun(volatile int *stop) {
+  uartLogStart();
+  while(!*stop) {
+    if(uartLogDrain() == 0)
+      uartSleepMs(UART_LOG_POLL_MS);
+  }
+
+  logDeferred.store(0, std::memory_order_release);
+  uartLogDrain();
+}
+
+void uartLogGetStats(uart_log_stats_t *stats) {
+  stats->records = logRecords;
+  stats->dropped = logDropped.load(std::memory_order_relaxed);
+}
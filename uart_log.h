@@ -0,0 +1,68 @@
+/********************************************************************************************************==*
+*                                      Deferred diagnostics for NNTS
+* Filename      : uart_log.h
+**********************************************************************************************************
+* Notes         : uartLog() takes a printf format and its arguments.  Until uartLogRun() is started it
+*                 prints straight away, as printf would.  While it runs, the call only copies the format
+*                 pointer and the raw arguments into a preallocated record and returns; the text is
+*                 produced later by the thread in uartLogRun(), so a slow console never stretches a
+*                 transaction.  The format must be a string literal: only its address is kept.
+*
+*                 Any thread may log.  A record is claimed with one compare-and-swap and nothing waits
+*                 for the drain thread: when the ring is full the record is dropped and counted, and
+*                 the drain thread reports the loss.  Strings (%s) are copied into the record, up to
+*                 UART_LOG_DATA bytes for all of them together.  Text and hexdumps longer than that take
+*                 several records, claimed together, so a line is printed whole or dropped whole.
+*
+*                 RAM: a record takes UART_LOG_ARGS * 8 + UART_LOG_DATA bytes plus 16 of header, 144 on
+*                 the target.  The target (32 KB on an xDot) gets 16 records, 2.3 KB, and a
+*                 UART_LOG_STACK_SIZE stack for the drain thread, 3.8 KB in all; a burst of more than 16
+*                 lines between two drains is counted as dropped.  The host keeps 64 records, 9.5 KB.
+*/
+
+#ifndef __UART_LOG_H
+#define __UART_LOG_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#ifndef UART_LOG_RECORDS
+#ifdef __MBED__
+#define UART_LOG_RECORDS    16      /* records in the ring, a power of two */
+#else
+#define UART_LOG_RECORDS    64
+#endif
+#endif
+
+#ifndef UART_LOG_STACK_SIZE
+#define UART_LOG_STACK_SIZE 1536    /* drain thread stack on the target: printf and one record */
+#endif
+
+#define UART_LOG_ARGS       8       /* arguments per record */
+#define UART_LOG_DATA       64      /* bytes per record for strings and hexdump */
+#define UART_LOG_POLL_MS    20      /* how often the drain thread looks for records */
+
+#if defined(__GNUC__)
+#define UART_LOG_PRINTF     __attribute__((format(printf, 1, 2)))
+#else
+#define UART_LOG_PRINTF
+#endif
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uint32_t records;     /* records formatted by the drain thread */
+  uint32_t dropped;     /* records lost to a full ring */
+} uart_log_stats_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartLog(const char *fmt, ...) UART_LOG_PRINTF;
+void uartLogHex(const uint8_t *p, uint32_t len);
+void uartLogText(const char *text, uint32_t len);
+uint32_t uartLogDrain(void);
+void uartLogStart(void);
+void uartLogRun(volatile int *stop);
+void uartLogGetStats(uart_log_stats_t *stats);
+
+#endif /* __UART_LOG_H */
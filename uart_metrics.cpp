@@ -0,0 +1,161 @@
+/********************************************************************************************************==*
+*                                      Link metrics for NNTS
+* Filename      : uart_metrics.cpp
+**********************************************************************************************************
+* Notes         : One slot per entry of uart_cmds[] plus one for unknown cmdIDs.  Writers only ever add,
+*                 with relaxed ordering - the counters are statistics, nothing is published through them.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_metrics.h"
+#include "uart_client.h"
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define MET_SLOTS           (uartCmdListCount() + 1)
+#define MET_UNKNOWN         uartCmdListCount()
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  std::atomic<uint32_t> count[UART_MET_COUNT];
+  std::atomic<uint32_t> latency[UART_LAT_BUCKETS];
+  std::atomic<uint32_t> latMaxUs;
+} met_slot_t;
+
+/* Local variables --------------------------------------------------------------------------------------*/
+static met_slot_t metTable[MET_SLOTS];
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static met_slot_t *metFind(uint8_t cmdID) {
+  uart_cmd_t *cmd = uartFindCmd(cmdID);
+
+  return &metTable[cmd ? (uint32_t) (cmd - uart_cmds) : MET_UNKNOWN];
+}
+
+static uint32_t metLoad(const std::atomic<uint32_t> &a) {
+  return a.load(std::memory_order_relaxed);
+}
+
+/* Adds slot into m, so the same code builds one command's snapshot and the total. */
+static void metAccumulate(const met_slot_t *slot, uart_metrics_t *m) {
+  uint32_t ii, max;
+
+  m->requests += metLoad(slot->count[UART_MET_REQUESTS]);
+  m->successes += metLoad(slot->count[UART_MET_SUCCESSES]);
+  m->crcErrors += metLoad(slot->count[UART_MET_CRC_ERRORS]);
+  m->lengthErrors += metLoad(slot->count[UART_MET_LENGTH_ERRORS]);
+  m->idErrors += metLoad(slot->count[UART_MET_ID_ERRORS]);
+  m->errorStatus += metLoad(slot->count[UART_MET_ERROR_STATUS]);
+  m->retries += metLoad(slot->count[UART_MET_RETRIES]);
+  m->timeouts += metLoad(slot->count[UART_MET_TIMEOUTS]);
+  m->bytesOut += metLoad(slot->count[UART_MET_BYTES_OUT]);
+  m->bytesIn += metLoad(slot->count[UART_MET_BYTES_IN]);
+  for(ii = 0; ii < UART_LAT_BUCKETS; ii++)
+    m->latency[ii] += metLoad(slot->latency[ii]);
+  max = metLoad(slot->latMaxUs);
+  if(max > m->latMaxUs)
+    m->latMaxUs = max;
+}
+
+/* Round trip time below which a fraction of the samples in latency[] fall, from the bucket bounds. */
+static uint32_t metPercentileUs(const uart_metrics_t *m, uint32_t permille) {
+  uint32_t ii, bound, total = 0, seen = 0;
+
+  for(ii = 0; ii < UART_LAT_BUCKETS; ii++)
+    total += m->latency[ii];
+  if(total == 0)
+    return 0;
+
+  for(ii = 0; ii < UART_LAT_BUCKETS - 1; ii++) {
+    seen += m->latency[ii];
+    bound = (uint32_t) UART_LAT_BASE_US << ii;
+    if((uint64_t) seen * 1000 >= (uint64_t) total * permille)
+      return (bound < m->latMaxUs) ? bound : m->latMaxUs;
+  }
+  return m->latMaxUs;
+}
+
+static void metPrint(const char *name, const uart_metrics_t *m) {
+  printf("%-6s %8lu %8lu %6lu %6lu %6lu %6lu %6lu %6lu %9lu %9lu  <%lu/<%lu/%lu\r\n", name,
+         (unsigned long) m->requests, (unsigned long) m->successes, (unsigned long) m->crcErrors,
+         (unsigned long) m->lengthErrors, (unsigned long) m->idErrors, (unsigned long) m->errorStatus,
+         (unsigned long) m->retries, (unsigned long) m->timeouts, (unsigned long) m->bytesOut,
+         (unsigned long) m->bytesIn, (unsigned long) metPercentileUs(m, 500),
+         (unsigned long) metPercentileUs(m, 990), (unsigned long) m->latMaxUs);
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+#if UART_METRICS
+void uartMetricsAdd(uint8_t cmdID, uint32_t counter, uint32_t n) {
+  if(counter < UART_MET_COUNT)
+    metFind(cmdID)->count[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+void uartMetricsLatency(uint8_t cmdID, uint32_t us) {
+  met_slot_t *slot = metFind(cmdID);
+  uint32_t bucket = 0, max;
+
+  if(us >= UART_LAT_BASE_US) {
+    bucket = 32 - __builtin_clz(us / UART_LAT_BASE_US);
+    if(bucket > UART_LAT_BUCKETS - 1)
+      bucket = UART_LAT_BUCKETS - 1;
+  }
+  slot->latency[bucket].fetch_add(1, std::memory_order_relaxed);
+
+  max = metLoad(slot->latMaxUs);
+  while((us > max) && !slot->latMaxUs.compare_exchange_weak(max, us, std::memory_order_relaxed))
+    ;
+}
+#endif
+
+/* Snapshot of cmdID; commands outside uart_cmds[] all report the shared slot. */
+void uartMetricsGet(uint8_t cmdID, uart_metrics_t *m) {
+  memset(m, 0, sizeof(*m));
+  metAccumulate(metFind(cmdID), m);
+}
+
+void uartMetricsTotal(uart_metrics_t *m) {
+  uint32_t ii;
+
+  memset(m, 0, sizeof(*m));
+  for(ii = 0; ii < MET_SLOTS; ii++)
+    metAccumulate(&metTable[ii], m);
+}
+
+void uartMetricsReset(void) {
+  uint32_t ii, jj;
+
+  for(ii = 0; ii < MET_SLOTS; ii++) {
+    for(jj = 0; jj < UART_MET_COUNT; jj++)
+      metTable[ii].count[jj].store(0, std::memory_order_relaxed);
+    for(jj = 0; jj < UART_LAT_BUCKETS; jj++)
+      metTable[ii].latency[jj].store(0, std::memory_order_relaxed);
+    metTable[ii].latMaxUs.store(0, std::memory_order_relaxed);
+  }
+}
+
+/* One line per command that has seen traffic, then the total.  Latency is p50/p99/max in us. */
+void uartMetricsDump(void) {
+  uart_metrics_t m;
+  char name[8];
+  uint32_t ii;
+
+  printf("cmd        rqst     good    crc    len     id    sts  retry  tmout       out        in  "
+         "p50/p99/max us\r\n");
+  for(ii = 0; ii < MET_SLOTS; ii++) {
+    memset(&m, 0, sizeof(m));
+    metAccumulate(&metTable[ii], &m);
+    if((m.requests == 0) && (m.successes == 0) && (m.crcErrors == 0))
+      continue;
+    if(ii == MET_UNKNOWN)
+      snprintf(name, sizeof(name), "other");
+    else
+      snprintf(name, sizeof(name), "0x%02X", uart_cmds[ii].cmdID);
+    metPrint(name, &m);
+  }
+  uartMetricsTotal(&m);
+  metPrint("total", &m);
+}
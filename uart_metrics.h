@@ -0,0 +1,75 @@
+/********************************************************************************************************==*
+*                                      Link metrics for NNTS
+* Filename      : uart_metrics.h
+**********************************************************************************************************
+* Notes         : Counters and a round trip histogram per command, kept by the blocking client and the
+*                 asynchronous engine alike.  Updating a counter is one relaxed atomic add on a slot
+*                 found through the cmdID index, so they stay on in production builds; build with
+*                 UART_METRICS=0 to compile them out altogether.
+*
+*                 Replies with a cmdID outside uart_cmds[] share one extra slot.  uartMetricsGet() takes
+*                 a snapshot: every counter is read atomically, but the set as a whole is not.
+*
+*                 Latency bucket 0 holds round trips under UART_LAT_BASE_US, bucket i those under
+*                 UART_LAT_BASE_US << i, the last bucket everything longer.  A round trip runs from the
+*                 request to its good reply, including any resends of the same frame.
+*/
+
+#ifndef __UART_METRICS_H
+#define __UART_METRICS_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_proto.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#ifndef UART_METRICS
+#define UART_METRICS            1
+#endif
+
+#define UART_LAT_BUCKETS        16
+#define UART_LAT_BASE_US        64
+
+/* counters, see uart_metrics_t */
+#define UART_MET_REQUESTS       0
+#define UART_MET_SUCCESSES      1
+#define UART_MET_CRC_ERRORS     2
+#define UART_MET_LENGTH_ERRORS  3
+#define UART_MET_ID_ERRORS      4
+#define UART_MET_ERROR_STATUS   5
+#define UART_MET_RETRIES        6
+#define UART_MET_TIMEOUTS       7
+#define UART_MET_BYTES_OUT      8
+#define UART_MET_BYTES_IN       9
+#define UART_MET_COUNT          10
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uint32_t requests;        /* request frames sent, retries included */
+  uint32_t successes;       /* good replies */
+  uint32_t crcErrors;       /* replies with a bad checksum, and requests the sensor reported as such */
+  uint32_t lengthErrors;    /* replies longer than the caller's buffer */
+  uint32_t idErrors;        /* good frames answering a different cmdID */
+  uint32_t errorStatus;     /* replies with any other error status */
+  uint32_t retries;         /* requests sent again after a failure */
+  uint32_t timeouts;        /* attempts that got no reply in time */
+  uint32_t bytesOut;        /* request bytes written, resends included */
+  uint32_t bytesIn;         /* bytes of good reply frames */
+  uint32_t latency[UART_LAT_BUCKETS];
+  uint32_t latMaxUs;
+} uart_metrics_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+#if UART_METRICS
+void uartMetricsAdd(uint8_t cmdID, uint32_t counter, uint32_t n);
+void uartMetricsLatency(uint8_t cmdID, uint32_t us);
+#else
+static inline void uartMetricsAdd(uint8_t, uint32_t, uint32_t) {}
+static inline void uartMetricsLatency(uint8_t, uint32_t) {}
+#endif
+void uartMetricsGet(uint8_t cmdID, uart_metrics_t *m);
+void uartMetricsTotal(uart_metrics_t *m);
+void uartMetricsReset(void);
+void uartMetricsDump(void);
+
+#endif /* __UART_METRICS_H */
@@ -0,0 +1,298 @@
+/********************************************************************************************************==*
+*                                      Reply frame parser for NNTS
+* Filename      : uart_parser.cpp
+**********************************************************************************************************
+* Notes         : The reply checksum covers the header with a zeroed cksum field followed by the payload.
+*
+*                 Resynchronizing after a bad checksum means rescanning header bytes 1..5 and the payload
+*                 that was already written to its destination.  The rescan writes any new payload to the
+*                 start of the same destination while reading further along it, so writes always trail
+*                 reads and the bytes can be replayed in place.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_parser.h"
+#include "checksum.h"
+#include "uart_wire.h"
+#include <string.h>
+#include <atomic>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define PARSER_HEADER       0
+#define PARSER_PAYLOAD      1
+
+#define PARSER_OK           0
+#define PARSER_STOP         1
+#define PARSER_CRC_FAIL     2
+
+static_assert(UART_RXPOOL_COUNT <= 32, "receive pool is tracked in a 32-bit mask");
+
+/* Local variables --------------------------------------------------------------------------------------*/
+#if UART_RXPOOL_COUNT
+static uart_rxbuf_t rxPool[UART_RXPOOL_COUNT];
+static std::atomic<uint32_t> rxPoolBusy(0);
+#endif
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static void parserRestart(uart_parser_t *p) {
+  if(p->owned != NULL) {
+    uartRxBufFree(p->owned);
+    p->owned = NULL;
+  }
+  p->state = PARSER_HEADER;
+  p->hdrFill = 0;
+  p->payload = NULL;
+  p->payFill = 0;
+}
+
+static int parserComplete(uart_parser_t *p) {
+  int stop;
+
+  if(p->crc != p->reply.cksum) {
+    p->crcErrors++;
+    return PARSER_CRC_FAIL;   /* frame left in place for parserReplay() */
+  }
+
+  p->frames++;
+  if(p->owned != NULL)
+    p->owned->reply = p->reply;
+  stop = p->onFrame(p->ctx, &p->reply, p->payload);
+  parserRestart(p);
+  return stop ? PARSER_STOP : PARSER_OK;
+}
+
+static int parserHeader(uart_parser_t *p) {
+  uint8_t zeroed[REPLY_HDR_LENGTH];
+
+  uart_codec<uartReplyHeader_t>::decode(p->hdrBytes, &p->reply);
+  if((p->reply.length > UART_MAX_DATA_SIZE - REPLY_HDR_LENGTH) ||
+     ((p->checkHeader != NULL) && !p->checkHeader(p, &p->reply))) {
+    p->lengthErrors++;
+    p->skippedBytes++;
+    memmove(p->hdrBytes, &p->hdrBytes[1], REPLY_HDR_LENGTH - 1);
+    p->hdrFill = REPLY_HDR_LENGTH - 1;
+    return PARSER_OK;
+  }
+
+  memcpy(zeroed, p->hdrBytes, REPLY_HDR_LENGTH - sizeof(uint16_t));   /* cksum is the last field */
+  memset(&zeroed[REPLY_HDR_LENGTH - sizeof(uint16_t)], 0, sizeof(uint16_t));
+  p->crc = crc_generate(zeroed, REPLY_HDR_LENGTH, 0xFFFF);
+  p->payFill = 0;
+  p->payload = NULL;
+
+  if(p->reply.length == 0)
+    return parserComplete(p);
+
+  if(!p->usePool) {
+    if(p->reply.length <= p->sinkLen)
+      p->payload = p->sink;
+  } else if(p->reply.length <= UART_RXBUF_SIZE) {
+    p->owned = uartRxBufAlloc();
+    if(p->owned != NULL)
+      p->payload = p->owned->data;
+    else
+      p->noBuffer++;
+  }
+  p->state = PARSER_PAYLOAD;
+  return PARSER_OK;
+}
+
+/* Account for len bytes just written at uartParserSpace(). */
+static int parserStep(uart_parser_t *p, size_t len) {
+  if(p->state == PARSER_HEADER) {
+    p->hdrFill += len;
+    if(p->hdrFill < REPLY_HDR_LENGTH)
+      return PARSER_OK;
+    return parserHeader(p);
+  }
+
+  p->crc = crc_generate(p->payload ? &p->payload[p->payFill] : p->scratch, len, p->crc);
+  p->payFill += len;
+  if(p->payFill < p->reply.length)
+    return PARSER_OK;
+  return parserComplete(p);
+}
+
+/*
+ * Rescan the frame that just failed its checksum, minus its first byte.  A failure during the rescan
+ * moves the unread bytes up behind the new failed frame and starts again, so this never recurses; if the
+ * new frame's buffer has no room for them they are dropped with it.
+ */
+static int parserReplay(uart_parser_t *p) {
+  uint8_t head[REPLY_HDR_LENGTH - 1], *src, *space;
+  uart_rxbuf_t *srcBuf;
+  uint32_t srcLen, pos, rem;
+  size_t room, n;
+  int rc;
+
+  memcpy(head, &p->hdrBytes[1], sizeof(head));
+  src = p->payload;
+  srcLen = p->payload ? p->reply.length : 0;
+  p->skippedBytes += (p->payload ? 1 : 1 + p->reply.length);
+  srcBuf = p->owned;
+  p->owned = NULL;
+  parserRestart(p);
+
+  for(;;) {
+    /* five header bytes never complete a frame, they just seed the header */
+    memcpy(p->hdrBytes, head, sizeof(head));
+    p->hdrFill = sizeof(head);
+
+    rc = PARSER_OK;
+    for(pos = 0; (pos < srcLen) && (rc == PARSER_OK); pos += n) {
+      space = uartParserSpace(p, &room);
+      n = (srcLen - pos < room) ? srcLen - pos : room;
+      memmove(space, &src[pos], n);
+      rc = parserStep(p, n);
+    }
+    rem = srcLen - pos;
+
+    if(rc != PARSER_CRC_FAIL) {
+      p->skippedBytes += rem;   /* bytes after a frame that stopped the parser */
+      if(srcBuf != NULL)
+        uartRxBufFree(srcBuf);
+      return rc;
+    }
+
+    /* failed again: the new candidate plus what is left of the old one becomes the next source */
+    memcpy(head, &p->hdrBytes[1], sizeof(head));
+    p->skippedBytes++;
+    if(p->reply.length == 0) {
+      src = &src[pos];   /* nothing was written, keep reading where we are */
+      srcLen = rem;
+    } else {
+      /* the candidate's buffer may be a different, smaller sink picked by checkHeader */
+      if((p->payload != NULL) &&
+         (p->reply.length + rem <= (p->owned ? (uint32_t) UART_RXBUF_SIZE : (uint32_t) p->sinkLen))) {
+        memmove(&p->payload[p->reply.length], &src[pos], rem);
+        src = p->payload;
+        srcLen = p->reply.length + rem;
+      } else {
+        p->skippedBytes += p->reply.length + rem;
+        src = NULL;
+        srcLen = 0;
+      }
+      if(srcBuf != NULL)
+        uartRxBufFree(srcBuf);
+      srcBuf = p->owned;
+      p->owned = NULL;
+    }
+    parserRestart(p);
+  }
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+/* Payloads are checked and dropped until a sink is set or the pool is chosen. */
+void uartParserInit(uart_parser_t *p, uart_frame_cb_t onFrame, void *ctx) {
+  memset(p, 0, sizeof(*p));
+  p->onFrame = onFrame;
+  p->ctx = ctx;
+  parserRestart(p);
+}
+
+/* Drop any partial frame. */
+void uartParserReset(uart_parser_t *p) {
+  parserRestart(p);
+}
+
+/* Payloads of the following frames go to dest.  Larger payloads are checked and dropped. */
+void uartParserSetSink(uart_parser_t *p, uint8_t *dest, uint16_t destLen) {
+  p->sink = dest;
+  p->sinkLen = destLen;
+  p->usePool = 0;
+}
+
+/* Payloads of the following frames go to pool buffers; see uartParserTakeBuffer().  Needs UART_RXPOOL_COUNT. */
+void uartParserUsePool(uart_parser_t *p) {
+  p->sink = NULL;
+  p->sinkLen = 0;
+  p->usePool = 1;
+}
+
+/*
+ * Parse len bytes.  Returns the number consumed, which is short of len only when the frame callback
+ * stopped the parser; the caller keeps the rest for later.
+ */
+size_t uartParserFeed(uart_parser_t *p, const uint8_t *data, size_t len) {
+  uint8_t *space;
+  size_t room, n, pos;
+
+  for(pos = 0; pos < len; pos += n) {
+    space = uartParserSpace(p, &room);
+    n = (len - pos < room) ? len - pos : room;
+    memcpy(space, &data[pos], n);
+    if(uartParserCommit(p, n)) {
+      pos += n;
+      break;
+    }
+  }
+  return pos;
+}
+
+/*
+ * Receive directly into the parser: uartParserSpace() returns where the next bytes go and how many are
+ * needed there, uartParserCommit() accounts for the len bytes written.  Never asking for more than the
+ * current frame needs means a read never runs into the next frame.
+ */
+uint8_t *uartParserSpace(uart_parser_t *p, size_t *room) {
+  uint32_t need;
+
+  if(p->state == PARSER_HEADER) {
+    *room = REPLY_HDR_LENGTH - p->hdrFill;
+    return &p->hdrBytes[p->hdrFill];
+  }
+
+  need = p->reply.length - p->payFill;
+  if(p->payload == NULL) {
+    *room = (need < PARSER_SCRATCH) ? need : PARSER_SCRATCH;
+    return p->scratch;
+  }
+  *room = need;
+  return &p->payload[p->payFill];
+}
+
+/* Returns non-zero when the frame callback asked to stop. */
+int uartParserCommit(uart_parser_t *p, size_t len) {
+  int rc = parserStep(p, len);
+
+  if(rc == PARSER_CRC_FAIL)
+    rc = parserReplay(p);
+  return rc == PARSER_STOP;
+}
+
+/* Called from the frame callback to keep the pool buffer holding the payload; free it when done. */
+uart_rxbuf_t *uartParserTakeBuffer(uart_parser_t *p) {
+  uart_rxbuf_t *buf = p->owned;
+
+  p->owned = NULL;
+  return buf;
+}
+
+#if UART_RXPOOL_COUNT
+uart_rxbuf_t *uartRxBufAlloc(void) {
+  uint32_t busy = rxPoolBusy.load(std::memory_order_relaxed);
+  uint32_t ii;
+
+  for(;;) {
+    for(ii = 0; (ii < UART_RXPOOL_COUNT) && (busy & (1u << ii)); ii++)
+      ;
+    if(ii == UART_RXPOOL_COUNT)
+      return NULL;
+    if(rxPoolBusy.compare_exchange_weak(busy, busy | (1u << ii), std::memory_order_acquire))
+      return &rxPool[ii];
+  }
+}
+
+void uartRxBufFree(uart_rxbuf_t *buf) {
+  rxPoolBusy.fetch_and(~(1u << (buf - rxPool)), std::memory_order_release);
+}
+#else
+uart_rxbuf_t *uartRxBufAlloc(void) {
+  return NULL;
+}
+
+void uartRxBufFree(uart_rxbuf_t *buf) {
+  (void) buf;
+}
+#endif
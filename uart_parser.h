@@ -0,0 +1,96 @@
+/********************************************************************************************************==*
+*                                      Reply frame parser for NNTS
+* Filename      : uart_parser.h
+**********************************************************************************************************
+* Notes         : Byte stream state machine.  Bytes can be fed in chunks of any size; every complete reply
+*                 with a good checksum is handed to the frame callback.  A header with an impossible
+*                 length, one rejected by the optional header check, or a frame with a bad checksum
+*                 costs one byte: the parser slips one byte and hunts for the next header in the bytes
+*                 it already holds.
+*
+*                 The header is collected in a small struct and the payload is written straight to its
+*                 destination - the buffer given with uartParserSetSink() or, for callers that need to
+*                 own the frame, a buffer from the static receive pool.  The checksum is updated as the
+*                 bytes arrive, so nothing is copied or read twice on the good path.
+*
+*                 The pool is opt-in: build with UART_RXPOOL_COUNT set to the number of buffers wanted.
+*                 Each holds the largest reply in uart_cmds[] (uart_engdata_t, 516 bytes), so two cost
+*                 about 1 KB of RAM.  Without it uartParserUsePool() leaves every payload to be dropped.
+*/
+
+#ifndef __UART_PARSER_H
+#define __UART_PARSER_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include "uart_proto.h"
+#include "uart_cmdtab.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#ifndef UART_RXPOOL_COUNT
+#define UART_RXPOOL_COUNT   0     /* buffers in the receive pool, 0: no pool */
+#endif
+#ifndef UART_RXBUF_SIZE
+#define UART_RXBUF_SIZE     uartCmdResMax()   /* largest pooled payload */
+#endif
+
+#define PARSER_SCRATCH      32    /* landing area for payload bytes that have nowhere to go */
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uartReplyHeader_t reply;
+  uint8_t data[UART_RXBUF_SIZE];
+} uart_rxbuf_t;
+
+/* Return non-zero to stop: uartParserFeed() returns without consuming the bytes after this frame.
+ * payload is NULL when the frame did not fit its destination; reply->length still tells its size. */
+typedef int (*uart_frame_cb_t)(void *ctx, const uartReplyHeader_t *reply, const uint8_t *payload);
+/* Return non-zero if the header could start a frame.  Rejecting junk early matters: a garbage header
+ * with a large but legal length would otherwise hold up the parser until that many bytes arrive.
+ * The callback may also route the payload by calling uartParserSetSink(). */
+struct uart_parser;
+typedef int (*uart_header_cb_t)(struct uart_parser *p, const uartReplyHeader_t *reply);
+
+typedef struct uart_parser {
+  uart_frame_cb_t onFrame;
+  uart_header_cb_t checkHeader;   /* optional */
+  void *ctx;
+
+  /* destination for the next payload */
+  uint8_t *sink;
+  uint16_t sinkLen;
+  int usePool;
+
+  /* frame in progress */
+  int state;
+  uint8_t hdrBytes[REPLY_HDR_LENGTH];
+  uint32_t hdrFill;
+  uartReplyHeader_t reply;
+  uint8_t *payload;        /* NULL while discarding a payload that does not fit */
+  uint32_t payFill;
+  uint16_t crc;
+  uart_rxbuf_t *owned;     /* pool buffer holding the payload, if any */
+  uint8_t scratch[PARSER_SCRATCH];
+
+  uint32_t frames;         /* frames delivered */
+  uint32_t crcErrors;      /* candidate frames dropped for a bad checksum */
+  uint32_t lengthErrors;   /* candidate headers dropped for an impossible length or by checkHeader */
+  uint32_t skippedBytes;   /* bytes discarded while hunting for a header */
+  uint32_t noBuffer;       /* payloads discarded because the pool was empty */
+} uart_parser_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartParserInit(uart_parser_t *p, uart_frame_cb_t onFrame, void *ctx);
+void uartParserReset(uart_parser_t *p);
+void uartParserSetSink(uart_parser_t *p, uint8_t *dest, uint16_t destLen);
+void uartParserUsePool(uart_parser_t *p);
+size_t uartParserFeed(uart_parser_t *p, const uint8_t *data, size_t len);
+uint8_t *uartParserSpace(uart_parser_t *p, size_t *room);
+int uartParserCommit(uart_parser_t *p, size_t len);
+uart_rxbuf_t *uartParserTakeBuffer(uart_parser_t *p);
+
+uart_rxbuf_t *uartRxBufAlloc(void);
+void uartRxBufFree(uart_rxbuf_t *buf);
+
+#endif /* __UART_PARSER_H */
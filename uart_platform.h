@@ -0,0 +1,67 @@
+/********************************************************************************************************==*
+*                                      Platform services for NNTS
+* Filename      : uart_platform.h
+**********************************************************************************************************
+* Notes         : The few OS services the protocol code needs beyond the transport.  Implemented in
+*                 uart_platform_mbed.cpp on the target and host/uart_platform_posix.cpp on Linux.
+*
+*                 uart_mutex_t is recursive on both platforms, rtos::Mutex always is.  uart_event_t is a
+*                 sticky auto-reset flag: a signal given while nobody waits is seen by the next wait.
+*/
+
+#ifndef __UART_PLATFORM_H
+#define __UART_PLATFORM_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include <stdint.h>
+#ifdef __MBED__
+#include "rtos/Mutex.h"
+#include "rtos/EventFlags.h"
+#else
+#include <mutex>
+#include <condition_variable>
+#endif
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+#ifdef __MBED__
+typedef rtos::Mutex uart_mutex_t;
+typedef rtos::EventFlags uart_event_t;
+#else
+typedef std::recursive_mutex uart_mutex_t;
+typedef struct {
+  std::mutex lock;
+  std::condition_variable cond;
+  int set = 0;
+} uart_event_t;
+#endif
+
+/* Functions --------------------------------------------------------------------------------------------*/
+uint64_t uartMicros(void);   /* monotonic time since an arbitrary start */
+
+static inline uint32_t uartMillis(void) {
+  return (uint32_t) (uartMicros() / 1000);
+}
+
+static inline void uartMutexLock(uart_mutex_t *m) {
+  m->lock();
+}
+
+/* Returns 1 with the mutex taken, 0 if another thread holds it. */
+static inline int uartMutexTryLock(uart_mutex_t *m) {
+#ifdef __MBED__
+  return m->trylock() ? 1 : 0;
+#else
+  return m->try_lock() ? 1 : 0;
+#endif
+}
+
+static inline void uartMutexUnlock(uart_mutex_t *m) {
+  m->unlock();
+}
+
+void uartEventSignal(uart_event_t *ev);
+int uartEventWait(uart_event_t *ev, uint32_t timeoutMs);   /* 1 if signalled, 0 on timeout */
+void uartSleepMs(uint32_t ms);
+
+#endif /* __UART_PLATFORM_H */
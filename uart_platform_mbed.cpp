@@ -0,0 +1,38 @@
+/********************************************************************************************************==*
+*                                      Platform services for NNTS - Mbed OS
+* Filename      : uart_platform_mbed.cpp
+**********************************************************************************************************
+* Notes         : The microsecond ticker is 32 bits wide in hardware; ticker_read_us() extends it to 64.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "mbed.h"
+#include "uart_platform.h"
+#include "uart_transport.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define EVENT_FLAG          0x1
+
+/* Functions --------------------------------------------------------------------------------------------*/
+uint64_t uartMicros(void) {
+  return ticker_read_us(get_us_ticker_data());
+}
+
+void uartEventSignal(uart_event_t *ev) {
+  ev->set(EVENT_FLAG);
+}
+
+int uartEventWait(uart_event_t *ev, uint32_t timeoutMs) {
+  uint32_t flags;
+
+  if(timeoutMs == UART_WAIT_FOREVER)
+    flags = ev->wait_any(EVENT_FLAG);
+  else
+    flags = ev->wait_any_for(EVENT_FLAG, std::chrono::milliseconds(timeoutMs));
+  return (flags & osFlagsError) ? 0 : 1;
+}
+
+void uartSleepMs(uint32_t ms) {
+  ThisThread::sleep_for(std::chrono::milliseconds(ms));
+}
@@ -0,0 +1,131 @@
+/********************************************************************************************************==*
+*                                      UART protocol definitions for NNTS
+* Filename      : uart_proto.h
+**********************************************************************************************************
+* Notes         : Command IDs, status codes and packet layouts shared by the client and the host tools.
+*/
+
+#ifndef __UART_PROTO_H
+#define __UART_PROTO_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define DOBLUE      "\033[0;34;2m"
+#define DORED       "\033[0;31;2m"
+#define DONONE      "\033[0m"
+/*
+ * Conversion macros for switching between Little and Big Endian.
+*/
+#define FLAMMABLE
+#define SWAP16(num)        ((uint16_t) ((((num) & 0xff00) >> 8) | (((num) & 0x00ff) << 8)))
+#define SWAP32(num)        ((uint32_t) ((((num) & 0xff000000u) >> 24) | (((num) & 0x00ff0000u) >> 8) | \
+                                        (((num) & 0x0000ff00u) << 8) | (((num) & 0x000000ffu) << 24)))
+
+/* Command Status */
+#define UART_SUCCESS           0x00
+#define UART_CRC_ERROR         0x01
+#define UART_BAD_PARAM         0x02
+#define UART_EXE_FAILED        0x03
+#define UART_NO_MEM            0x04
+#define UART_UNKNOWN_CMD       0x05
+
+#define UART_LOCAL_ERROR       0xFF   /* Error generated locally - not from sensor */
+
+/* commands */
+#define CMD_ANSWER       0x01
+#define CMD_ENGDATA      0x09
+#ifdef FLAMMABLE
+#define CMD_CONC         0x03
+#define CMD_ID           0x04
+#endif
+
+#define CMD_TEMP         0x21
+#define CMD_PRES         0x22
+#define CMD_REL_HUM      0x23
+#define CMD_ABS_HUM      0x24
+
+#define CMD_STATUS       0x41
+#define CMD_VERSION      0x42
+#define CMD_SENSOR_INFO  0x43
+
+#define CMD_MEAS               0x61
+#define CMD_SHUTDOWN           0x62
+/*
+ * CMD_WRITE_FLOAT: none of the documented commands takes a float.  Define it in the build to the cmdID of a
+ * float setting on the firmware at hand to get WriteFloat into the command table.
+ */
+
+#define RQST_HDR_LENGTH     8u          /* header sizes on the wire, see uart_wire.h */
+#define REPLY_HDR_LENGTH    6u
+#define UART_MAX_DATA_SIZE  (1024*8)    /* maximum packet:  header + payload */
+#define ENGDATA_CHUNKSIZE   512         /* size of each chunk of engineering data */
+#define FINAL_PACKET        0x8000      /* bit to indicate last chunk of engineering data */
+#define ENGDATA_SEEK        0x8000      /* CMD_ENGDATA reserved field: send the chunk in the low bits */
+#define ENGDATA_SEEK_MAX    0x7FFF      /* last chunk ENGDATA_SEEK can name */
+
+#define GAS_NAME_LENGTH     64
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uint16_t cmdID;
+  uint16_t length;
+  uint16_t reserved;
+  uint16_t cksum;
+} uartRqstHeader_t;
+
+typedef struct {
+  uint8_t cmdID;
+  uint8_t status;
+  uint16_t length;
+  uint16_t cksum;
+} uartReplyHeader_t;
+
+typedef struct {
+  uint8_t sw_w;
+  uint8_t sw_x;
+  uint8_t sw_y;
+  uint8_t sw_z;
+  uint8_t hw_w;
+  uint8_t hw_x;
+  uint8_t proto_w;
+  uint8_t proto_x;
+} uart_version_t;
+
+typedef struct {
+  uint8_t sensorName[32];  /* Serial name (zero-padded ASCII string) */
+  uint32_t sensorType;   /* Sensor Type/Model */
+  uint8_t calDate[16];   /* Calibration date */
+  uint8_t mfgDate[16];   /* Manufacturing  date */
+} uart_sensor_info_t;
+
+#ifdef FLAMMABLE
+typedef struct {
+  uint32_t cycleCount;
+  float concentration;
+  uint32_t flamID;
+  float temp;
+  float pressure;
+  float relHumidity;
+  float absHumidity;
+} answer_t;
+
+typedef struct {
+  uint32_t length;
+  uint8_t data[ENGDATA_CHUNKSIZE];
+} uart_engdata_t;
+#else
+#error Need to define expected answer type!
+#endif
+
+typedef struct {
+  float temp;
+  float pressure;
+  float humidity;
+  float absHumidity;
+  float humidAirDensity;
+} enviro_reply_t;
+
+#endif /* __UART_PROTO_H */
@@ -0,0 +1,178 @@
+/********************************************************************************************************==*
+*                                      Field query planner for NNTS
+* Filename      : uart_query.cpp
+**********************************************************************************************************
+* Notes         : With seven fields there are only a handful of commands that can deliver them, so the
+*                 planner simply tries every subset and keeps the cheapest one that covers the request.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_query.h"
+#include "uart_platform.h"
+#include "uart_log.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uint8_t cmdID;
+  uint32_t fields;
+} query_source_t;
+
+/* Local variables --------------------------------------------------------------------------------------*/
+static const query_source_t querySources[] = {
+  {CMD_ANSWER, UART_FIELD_ALL},
+  {CMD_CONC, UART_FIELD_CONC},
+  {CMD_ID, UART_FIELD_FLAM_ID},
+  {CMD_TEMP, UART_FIELD_TEMP},
+  {CMD_PRES, UART_FIELD_PRES},
+  {CMD_REL_HUM, UART_FIELD_REL_HUM},
+  {CMD_ABS_HUM, UART_FIELD_ABS_HUM},
+};
+#define NUM_OF_SOURCES      (sizeof(querySources) / sizeof(query_source_t))
+
+/* Where each field lives in answer_t, in UART_FIELD_ bit order. */
+static const uint8_t fieldOffset[UART_NUM_FIELDS] = {
+  offsetof(answer_t, cycleCount),
+  offsetof(answer_t, concentration),
+  offsetof(answer_t, flamID),
+  offsetof(answer_t, temp),
+  offsetof(answer_t, pressure),
+  offsetof(answer_t, relHumidity),
+  offsetof(answer_t, absHumidity),
+};
+
+static_assert(NUM_OF_SOURCES <= 8, "plans are enumerated as an 8-bit subset mask");
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static uint32_t queryFieldIndex(uint32_t field) {
+  uint32_t ii = 0;
+
+  while(!(field & 1)) {
+    field >>= 1;
+    ii++;
+  }
+  return ii;
+}
+
+/* Store a reply in the record: CMD_ANSWER carries the whole answer_t, the others one 32-bit field. */
+static void queryStore(uart_reading_t *rec, uint32_t fields, const uint8_t *data, uint32_t nowMs) {
+  uint32_t ii, bits;
+
+  if(fields == UART_FIELD_ALL) {
+    uart_codec<answer_t>::decode(data, &rec->value);
+  } else {
+    bits = uartLoad32(data);   /* every single field is a 32-bit integer or float */
+    memcpy((uint8_t *) &rec->value + fieldOffset[queryFieldIndex(fields)], &bits, sizeof(bits));
+  }
+
+  for(ii = 0; ii < UART_NUM_FIELDS; ii++) {
+    if(fields & (1u << ii))
+      rec->stampMs[ii] = nowMs;
+  }
+  rec->valid |= fields;
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartReadingInit(uart_reading_t *rec) {
+  memset(rec, 0, sizeof(*rec));
+}
+
+/*
+ * Cheapest set of commands that delivers all of fields.  Only commands present in uart_cmds[] are
+ * considered; their cost is the request and reply bytes on the line plus one round trip each.
+ * Returns 0, or 1 if no combination of known commands covers the fields.
+ */
+uint32_t uartQueryPlan(uint32_t fields, uart_query_plan_t *plan) {
+  uint32_t cost[NUM_OF_SOURCES], subset, ii, total, covered, best = 0, bestCost = 0xFFFFFFFF;
+  uart_cmd_t *cmd;
+
+  for(ii = 0; ii < NUM_OF_SOURCES; ii++) {
+    cmd = uartFindCmd(querySources[ii].cmdID);
+    if(cmd == NULL)
+      cost[ii] = 0xFFFFFFFF;   /* not supported by this build */
+    else
+      cost[ii] = RQST_HDR_LENGTH + cmd->req_size + REPLY_HDR_LENGTH + cmd->res_size + UART_QUERY_RTT_BYTES;
+  }
+
+  for(subset = 0; subset < (1u << NUM_OF_SOURCES); subset++) {
+    total = 0;
+    covered = 0;
+    for(ii = 0; (ii < NUM_OF_SOURCES) && (total < bestCost); ii++) {
+      if(!(subset & (1u << ii)))
+        continue;
+      if(cost[ii] == 0xFFFFFFFF)
+        total = 0xFFFFFFFF;
+      else
+        total += cost[ii];
+      covered |= querySources[ii].fields;
+    }
+    if(((covered & fields) == fields) && (total < bestCost)) {
+      best = subset;
+      bestCost = total;
+    }
+  }
+
+  memset(plan, 0, sizeof(*plan));
+  if(bestCost == 0xFFFFFFFF)
+    return 1;
+
+  for(ii = 0; ii < NUM_OF_SOURCES; ii++) {
+    if(best & (1u << ii)) {
+      plan->cmdID[plan->count++] = querySources[ii].cmdID;
+      plan->fields |= querySources[ii].fields;
+    }
+  }
+  plan->cost = bestCost;
+  return 0;
+}
+
+/*
+ * Bring the wanted fields of rec up to date.  Fields read less than maxAgeMs ago are reused; with
+ * maxAgeMs 0 all of them are read.  Fields are only updated from replies that succeeded, so on a
+ * failure rec still holds the last good readings.  Returns 0 if every wanted field is fresh.
+ */
+uint32_t uartQuery(uart_reading_t *rec, uint32_t fields, uint32_t maxAgeMs) {
+  uart_batch_entry_t batch[UART_QUERY_MAX_CMDS];
+  uint8_t reply[UART_QUERY_MAX_CMDS][uart_codec<answer_t>::wireSize];
+  uint32_t need = fields & UART_FIELD_ALL, nowMs = uartMillis(), ii, jj, failed;
+  uart_query_plan_t plan;
+  uart_cmd_t *cmd;
+
+  for(ii = 0; (ii < UART_NUM_FIELDS) && maxAgeMs; ii++) {
+    if((rec->valid & (1u << ii)) && (nowMs - rec->stampMs[ii] < maxAgeMs))
+      need &= ~(1u << ii);
+  }
+  if(need == 0)
+    return 0;
+
+  if(uartQueryPlan(need, &plan) != 0) {
+    uartLog("No command set delivers fields 0x%x\n", need);
+    return 1;
+  }
+  if(verbose)
+    uartLog("Query 0x%02x: %u command(s), cost %u\n", need, plan.count, plan.cost);
+
+  for(ii = 0; ii < plan.count; ii++) {
+    cmd = uartFindCmd(plan.cmdID[ii]);
+    batch[ii].cmdID = plan.cmdID[ii];
+    batch[ii].txPayload = NULL;
+    batch[ii].txLen = 0;
+    batch[ii].rxPayload = reply[ii];
+    batch[ii].rxLen = cmd->res_size;
+  }
+  failed = uartBatch(batch, plan.count);
+
+  nowMs = uartMillis();
+  for(ii = 0; ii < plan.count; ii++) {
+    if(batch[ii].status != UART_SUCCESS)
+      continue;
+    for(jj = 0; querySources[jj].cmdID != plan.cmdID[ii]; jj++)
+      ;
+    queryStore(rec, querySources[jj].fields, reply[ii], nowMs);
+  }
+
+  return failed ? 1 : 0;
+}
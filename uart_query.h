@@ -0,0 +1,54 @@
+/********************************************************************************************************==*
+*                                      Field query planner for NNTS
+* Filename      : uart_query.h
+**********************************************************************************************************
+* Notes         : Callers ask for readings by field instead of by command.  The planner picks the
+*                 cheapest set of commands from uart_cmds[] that covers the fields still missing - a
+*                 single CMD_ANSWER carries every field, the single value commands carry one each - and
+*                 runs them as one pipelined batch.
+*/
+
+#ifndef __UART_QUERY_H
+#define __UART_QUERY_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_client.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define UART_FIELD_CYCLE_COUNT   0x01
+#define UART_FIELD_CONC          0x02
+#define UART_FIELD_FLAM_ID       0x04
+#define UART_FIELD_TEMP          0x08
+#define UART_FIELD_PRES          0x10
+#define UART_FIELD_REL_HUM       0x20
+#define UART_FIELD_ABS_HUM       0x40
+#define UART_FIELD_ALL           0x7F
+#define UART_NUM_FIELDS          7
+
+#define UART_QUERY_MAX_CMDS      UART_NUM_FIELDS
+
+#ifndef UART_QUERY_RTT_BYTES
+#define UART_QUERY_RTT_BYTES     32    /* cost of one extra round trip, in bytes of line time */
+#endif
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  answer_t value;
+  uint32_t valid;                       /* UART_FIELD_ bits holding a reading */
+  uint32_t stampMs[UART_NUM_FIELDS];    /* uartMillis() when each field was read */
+} uart_reading_t;
+
+typedef struct {
+  uint32_t count;
+  uint8_t cmdID[UART_QUERY_MAX_CMDS];
+  uint32_t fields;   /* fields the commands deliver, at least the ones asked for */
+  uint32_t cost;     /* line bytes plus UART_QUERY_RTT_BYTES per round trip */
+} uart_query_plan_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartReadingInit(uart_reading_t *rec);
+uint32_t uartQueryPlan(uint32_t fields, uart_query_plan_t *plan);
+uint32_t uartQuery(uart_reading_t *rec, uint32_t fields, uint32_t maxAgeMs);
+
+#endif /* __UART_QUERY_H */
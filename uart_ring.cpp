@@ -0,0 +1,139 @@
+/********************************************************************************************************==*
+*                                      Receive ring for NNTS
+* Filename      : uart_ring.cpp
+**********************************************************************************************************
+* Notes         : head and tail run freely and are masked on use, so a full ring and an empty one are
+*                 told apart without giving up a slot.  The producer publishes bytes with a release store
+*                 of head, the consumer frees them with a release store of tail.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_ring.h"
+#include <string.h>
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static int ringWrite(void *ctx, const uint8_t *buf, size_t len) {
+  uart_rxlink_t *l = (uart_rxlink_t *) ctx;
+
+  return uartTransportWrite(l->lower, buf, len);
+}
+
+static int ringRead(void *ctx, uint8_t *buf, size_t len, uint32_t timeoutMs) {
+  uart_rxlink_t *l = (uart_rxlink_t *) ctx;
+  uint64_t deadline = 0;
+  uint32_t n, now;
+
+  if(timeoutMs != UART_WAIT_FOREVER)
+    deadline = uartMicros() + (uint64_t) timeoutMs * 1000;
+
+  for(;;) {
+    if((n = uartRingPop(&l->ring, buf, (uint32_t) len)) != 0) {
+      if(l->wantSpace.exchange(0))
+        uartEventSignal(&l->rxSpace);
+      return (int) n;
+    }
+    if(l->failed.load(std::memory_order_acquire))
+      return -1;
+
+    if(timeoutMs == UART_WAIT_FOREVER) {
+      uartEventWait(&l->rxReady, UART_WAIT_FOREVER);
+    } else {
+      now = (uint32_t) ((deadline > uartMicros()) ? (deadline - uartMicros() + 999) / 1000 : 0);
+      if((now == 0) || !uartEventWait(&l->rxReady, now))
+        return (int) uartRingPop(&l->ring, buf, (uint32_t) len);   /* 0 unless bytes raced the timeout */
+    }
+  }
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartRingInit(uart_ring_t *r, uint8_t *buf, uint32_t size) {
+  r->buf = buf;
+  r->mask = size - 1;
+  r->head.store(0, std::memory_order_relaxed);
+  r->tail.store(0, std::memory_order_relaxed);
+}
+
+/* Producer: contiguous free space at the head, so the reader can receive straight into the ring. */
+uint8_t *uartRingSpace(uart_ring_t *r, uint32_t *room) {
+  uint32_t head = r->head.load(std::memory_order_relaxed);
+  uint32_t used = head - r->tail.load(std::memory_order_acquire);
+  uint32_t toEnd = r->mask + 1 - (head & r->mask);
+
+  *room = r->mask + 1 - used;
+  if(*room > toEnd)
+    *room = toEnd;
+  return &r->buf[head & r->mask];
+}
+
+/* Producer: publish len bytes written at uartRingSpace(). */
+void uartRingCommit(uart_ring_t *r, uint32_t len) {
+  r->head.store(r->head.load(std::memory_order_relaxed) + len, std::memory_order_release);
+}
+
+/* Consumer: copy out up to len bytes.  Returns the number copied. */
+uint32_t uartRingPop(uart_ring_t *r, uint8_t *dst, uint32_t len) {
+  uint32_t tail = r->tail.load(std::memory_order_relaxed);
+  uint32_t avail = r->head.load(std::memory_order_acquire) - tail;
+  uint32_t first;
+
+  if(len > avail)
+    len = avail;
+  first = r->mask + 1 - (tail & r->mask);
+  if(first > len)
+    first = len;
+  memcpy(dst, &r->buf[tail & r->mask], first);
+  memcpy(&dst[first], r->buf, len - first);
+  r->tail.store(tail + len, std::memory_order_release);
+  return len;
+}
+
+uint32_t uartRingCount(uart_ring_t *r) {
+  return r->head.load(std::memory_order_acquire) - r->tail.load(std::memory_order_acquire);
+}
+
+/* Set up the ring on top of lower; t becomes the transport the protocol code reads from. */
+void uartRxLinkInit(uart_rxlink_t *l, uart_transport_t *lower, uart_transport_t *t) {
+  static_assert((UART_RING_SIZE & (UART_RING_SIZE - 1)) == 0, "UART_RING_SIZE must be a power of two");
+
+  l->lower = lower;
+  uartRingInit(&l->ring, l->buf, UART_RING_SIZE);
+  l->stop = 0;
+  l->failed.store(0, std::memory_order_relaxed);
+  l->wantSpace.store(0, std::memory_order_relaxed);
+  l->fullWaits = 0;
+  t->ctx = l;
+  t->write = ringWrite;
+  t->read = ringRead;
+}
+
+/* Body of the reader thread.  Returns when stop is set or the lower transport fails. */
+void uartRxLinkRun(uart_rxlink_t *l) {
+  uint8_t *space;
+  uint32_t room;
+  int n;
+
+  while(!l->stop) {
+    space = uartRingSpace(&l->ring, &room);
+    if(room == 0) {
+      l->fullWaits++;
+      l->wantSpace.store(1);
+      uartRingSpace(&l->ring, &room);   /* the consumer may have missed the flag */
+      if(room == 0)
+        uartEventWait(&l->rxSpace, UART_RING_POLL_MS);
+      l->wantSpace.store(0);
+      continue;
+    }
+
+    n = uartTransportRead(l->lower, space, room, UART_RING_POLL_MS);
+    if(n < 0) {
+      l->failed.store(1, std::memory_order_release);
+      uartEventSignal(&l->rxReady);
+      return;
+    }
+    if(n > 0) {
+      uartRingCommit(&l->ring, (uint32_t) n);
+      uartEventSignal(&l->rxReady);
+    }
+  }
+}
@@ -0,0 +1,73 @@
+/********************************************************************************************************==*
+*                                      Receive ring for NNTS
+* Filename      : uart_ring.h
+**********************************************************************************************************
+* Notes         : A reader thread owns the UART receive side and pushes whatever arrives into a lock-free
+*                 single-producer/single-consumer byte ring; the protocol code reads from the ring through
+*                 an ordinary uart_transport_t.  Writes go straight to the lower transport, whole frames
+*                 are kept together by the client's transaction lock.
+*
+*                 When the ring is full the reader waits for the consumer and leaves the bytes in the
+*                 lower transport, so an overrun happens there, as it would on the bare UART.
+*
+*                 On the target BufferedSerial already buffers the receive side, so the ring only has to
+*                 cover the time the consumer is busy: 512 bytes, 130 ms at 38400 baud, and a
+*                 UART_RING_STACK_SIZE stack for the reader, 1.5 KB in all.  The host keeps 4 KB.
+*/
+
+#ifndef __UART_RING_H
+#define __UART_RING_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <atomic>
+#include "uart_transport.h"
+#include "uart_platform.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#ifndef UART_RING_SIZE
+#ifdef __MBED__
+#define UART_RING_SIZE      512     /* receive ring in bytes, a power of two */
+#else
+#define UART_RING_SIZE      4096
+#endif
+#endif
+
+#ifndef UART_RING_STACK_SIZE
+#define UART_RING_STACK_SIZE 1024   /* reader thread stack on the target: reads into the ring, no printf */
+#endif
+
+#define UART_RING_POLL_MS   100     /* longest the reader waits before checking stop */
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uint8_t *buf;
+  uint32_t mask;                  /* size - 1 */
+  std::atomic<uint32_t> head;     /* written by the producer only */
+  std::atomic<uint32_t> tail;     /* written by the consumer only */
+} uart_ring_t;
+
+typedef struct {
+  uart_transport_t *lower;
+  uart_ring_t ring;
+  uint8_t buf[UART_RING_SIZE];
+  uart_event_t rxReady;           /* bytes were pushed */
+  uart_event_t rxSpace;           /* bytes were popped */
+  volatile int stop;
+  std::atomic<int> failed;        /* the lower transport failed, reported once the ring is empty */
+  std::atomic<int> wantSpace;     /* the reader waits on rxSpace */
+  uint32_t fullWaits;             /* times the reader found the ring full */
+} uart_rxlink_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartRingInit(uart_ring_t *r, uint8_t *buf, uint32_t size);
+uint8_t *uartRingSpace(uart_ring_t *r, uint32_t *room);
+void uartRingCommit(uart_ring_t *r, uint32_t len);
+uint32_t uartRingPop(uart_ring_t *r, uint8_t *dst, uint32_t len);
+uint32_t uartRingCount(uart_ring_t *r);
+
+void uartRxLinkInit(uart_rxlink_t *l, uart_transport_t *lower, uart_transport_t *t);
+void uartRxLinkRun(uart_rxlink_t *l);
+
+#endif /* __UART_RING_H */
@@ -0,0 +1,95 @@
+/********************************************************************************************************==*
+*                                      Adaptive reply timeouts for NNTS
+* Filename      : uart_rto.cpp
+**********************************************************************************************************
+* Notes         : One estimator per entry of uart_cmds[], found through the same O(1) index as the
+*                 command itself.  Commands outside the table always get UART_RTO_INIT_MS.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_rto.h"
+#include "uart_client.h"
+#include <string.h>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define RTO_GRANULARITY_US  1000  /* G in RFC 6298: the timeout resolution of the transport */
+
+/* Local variables --------------------------------------------------------------------------------------*/
+static uart_rto_t rtoTable[uartCmdListCount()];
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static uart_rto_t *rtoFind(uint8_t cmdID) {
+  uart_cmd_t *cmd = uartFindCmd(cmdID);
+
+  return cmd ? &rtoTable[cmd - uart_cmds] : NULL;
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+/* Round trip of a first attempt, request sent to reply checked. */
+void uartRtoSample(uint8_t cmdID, uint32_t rttUs) {
+  uart_rto_t *rto = rtoFind(cmdID);
+  uint32_t delta;
+
+  if(rto == NULL)
+    return;
+
+  if(rto->samples++ == 0) {
+    rto->srttUs = rttUs;
+    rto->rttvarUs = rttUs / 2;
+    return;
+  }
+
+  delta = (rto->srttUs > rttUs) ? rto->srttUs - rttUs : rttUs - rto->srttUs;
+  rto->rttvarUs = rto->rttvarUs - rto->rttvarUs / 4 + delta / 4;   /* beta = 1/4 */
+  rto->srttUs = rto->srttUs - rto->srttUs / 8 + rttUs / 8;         /* alpha = 1/8 */
+}
+
+void uartRtoTimedOut(uint8_t cmdID) {
+  uart_rto_t *rto = rtoFind(cmdID);
+
+  if(rto != NULL)
+    rto->timeouts++;
+}
+
+/* Reply timeout for attempt 0, 1, ... of cmdID, backed off and clamped. */
+uint32_t uartRtoMs(uint8_t cmdID, uint32_t attempt) {
+  uart_rto_t *rto = rtoFind(cmdID);
+  uint32_t ms, var;
+
+  if((rto == NULL) || (rto->samples == 0)) {
+    ms = UART_RTO_INIT_MS;
+  } else {
+    var = 4 * rto->rttvarUs;
+    ms = (rto->srttUs + ((var > RTO_GRANULARITY_US) ? var : RTO_GRANULARITY_US) + 999) / 1000;
+    if(ms < UART_RTO_MIN_MS)
+      ms = UART_RTO_MIN_MS;
+  }
+
+  for(; attempt && (ms < UART_RTO_MAX_MS); attempt--)
+    ms *= 2;
+  return (ms < UART_RTO_MAX_MS) ? ms : UART_RTO_MAX_MS;
+}
+
+/* Pause before retry attempt (1, 2, ...) after a failure that was not a timeout. */
+uint32_t uartBackoffMs(uint32_t attempt) {
+  uint32_t ms = UART_BACKOFF_BASE_MS;
+
+  for(; (attempt > 1) && (ms < UART_BACKOFF_MAX_MS); attempt--)
+    ms *= 2;
+  return (ms < UART_BACKOFF_MAX_MS) ? ms : UART_BACKOFF_MAX_MS;
+}
+
+/* Returns 0 and the estimator state of cmdID, or -1 if cmdID is not in uart_cmds[]. */
+int uartRtoGet(uint8_t cmdID, uart_rto_t *rto) {
+  uart_rto_t *entry = rtoFind(cmdID);
+
+  if(entry == NULL)
+    return -1;
+  *rto = *entry;
+  return 0;
+}
+
+void uartRtoReset(void) {
+  memset(rtoTable, 0, sizeof(rtoTable));
+}
@@ -0,0 +1,50 @@
+/********************************************************************************************************==*
+*                                      Adaptive reply timeouts for NNTS
+* Filename      : uart_rto.h
+**********************************************************************************************************
+* Notes         : Retransmission timeout per command, estimated as in TCP (RFC 6298): a smoothed round
+*                 trip time and its mean deviation are kept per cmdID, and the timeout is
+*                 SRTT + 4 * RTTVAR, clamped to [UART_RTO_MIN_MS, UART_RTO_MAX_MS].  Only replies to a
+*                 first attempt are sampled - after a resend it is unknown which request was answered.
+*
+*                 Every retry doubles the timeout of the attempt before it, up to UART_RTO_MAX_MS.  A
+*                 retry after a failure that came back quickly (an error status, a bad frame) first
+*                 waits a backoff that also doubles, up to UART_BACKOFF_MAX_MS, so a sick sensor is not
+*                 hammered.
+*
+*                 Fed by the synchronous client, with the link lock held, and by the asynchronous engines
+*                 from their event loop.  Not locked: the estimate is per command, not per link, and an
+*                 update lost to two links sampling at once only delays it by one sample.
+*/
+
+#ifndef __UART_RTO_H
+#define __UART_RTO_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_proto.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define UART_RTO_INIT_MS        1000  /* timeout before a command has been sampled */
+#define UART_RTO_MIN_MS         10
+#define UART_RTO_MAX_MS         8000
+#define UART_BACKOFF_BASE_MS    2
+#define UART_BACKOFF_MAX_MS     250
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uint32_t srttUs;      /* smoothed round trip time */
+  uint32_t rttvarUs;    /* round trip time variation */
+  uint32_t samples;
+  uint32_t timeouts;    /* attempts that timed out */
+} uart_rto_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartRtoSample(uint8_t cmdID, uint32_t rttUs);
+void uartRtoTimedOut(uint8_t cmdID);
+uint32_t uartRtoMs(uint8_t cmdID, uint32_t attempt);
+uint32_t uartBackoffMs(uint32_t attempt);
+int uartRtoGet(uint8_t cmdID, uart_rto_t *rto);
+void uartRtoReset(void);
+
+#endif /* __UART_RTO_H */
@@ -0,0 +1,142 @@
+/********************************************************************************************************==*
+*                                      Fixed-rate sampler for NNTS
+* Filename      : uart_sampler.cpp
+**********************************************************************************************************
+* Notes         : The ring follows uart_ring.cpp: head and tail run freely and are masked on use, the
+*                 sampler publishes a sample with a release store of head, the consumer frees its slot
+*                 with a release store of tail.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_sampler.h"
+#include "uart_sched.h"
+#include <string.h>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define SAMPLER_MASK        (UART_SAMPLER_RING - 1)
+
+static_assert((UART_SAMPLER_RING & SAMPLER_MASK) == 0, "UART_SAMPLER_RING must be a power of two");
+
+/* Local functions --------------------------------------------------------------------------------------*/
+/* ms left until deadlineUs, at least 1 so the transaction gets one attempt. */
+static uint32_t samplerBudgetMs(uint64_t deadlineUs) {
+  uint64_t now = uartMicros();
+
+  return ((deadlineUs > now) && (deadlineUs - now >= 1000)) ? (uint32_t) ((deadlineUs - now) / 1000) : 1;
+}
+
+/* Trigger and read one answer, done by deadlineUs.  Returns UART_SUCCESS or the error. */
+static uint32_t samplerRead(uart_sampler_t *sp, answer_t *answer, uint64_t deadlineUs) {
+  uint8_t buf[uart_cmd_desc<CMD_ANSWER>::resSize];
+  uint32_t sts = UART_SUCCESS;
+
+  uartSchedAcquire(sp->session, UART_PRIO_SAFETY);
+  if(sp->trigger)
+    sts = uartSessionTransactWithin(sp->session, CMD_MEAS, &sp->measArg, sizeof(sp->measArg), NULL, 0,
+                                    samplerBudgetMs(deadlineUs));
+  if(sts == UART_SUCCESS)
+    sts = uartSessionTransactWithin(sp->session, CMD_ANSWER, NULL, 0, buf, sizeof(buf), samplerBudgetMs(deadlineUs));
+  uartSchedRelease(sp->session);
+
+  if(sts == UART_SUCCESS)
+    uart_codec<answer_t>::decode(buf, answer);
+  return sts;
+}
+
+static void samplerPush(uart_sampler_t *sp, uint32_t seq, uint64_t timeUs, const answer_t *answer) {
+  uint32_t head = sp->head.load(std::memory_order_relaxed);
+  uart_sample_entry_t *e;
+
+  if(head - sp->tail.load(std::memory_order_acquire) == UART_SAMPLER_RING) {
+    sp->stats.dropped++;
+    return;
+  }
+  e = &sp->ring[head & SAMPLER_MASK];
+  e->seq = seq;
+  e->timeUs = timeUs;
+  e->answer = *answer;
+  sp->head.store(head + 1, std::memory_order_release);
+  sp->stats.samples++;
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+/* Sample through session s every periodMs, at least 1.  trigger and measArg may be set before the start. */
+void uartSamplerInit(uart_sampler_t *sp, uart_session_t *s, uint32_t periodMs) {
+  sp->session = s;
+  sp->periodMs = periodMs ? periodMs : 1;
+  sp->trigger = 0;
+  sp->measArg = 0;
+  sp->stop = 0;
+  sp->head.store(0, std::memory_order_relaxed);
+  sp->tail.store(0, std::memory_order_relaxed);
+  memset(&sp->stats, 0, sizeof(sp->stats));
+}
+
+/* Thread body: the first sample is due at once, then one every periodMs until uartSamplerStop(). */
+void uartSamplerRun(uart_sampler_t *sp) {
+  uart_sampler_stats_t *st = &sp->stats;
+  uint64_t periodUs = (uint64_t) sp->periodMs * 1000, due = uartMicros(), now, prev = 0, skipped;
+  uint32_t seq = 0, late, gap;
+  answer_t answer;
+
+  while(!sp->stop) {
+    while(((now = uartMicros()) < due) && !sp->stop) {
+      if(due - now >= 1000)
+        uartEventWait(&sp->wake, (uint32_t) ((due - now) / 1000));
+      else if(!UART_SAMPLER_SPIN)
+        uartEventWait(&sp->wake, 1);   /* at least one tick */
+    }
+    if(sp->stop)
+      break;
+
+    late = (uint32_t) (now - due);
+    st->lateSumUs += late;
+    if(late > st->lateMaxUs)
+      st->lateMaxUs = late;
+    if(prev) {
+      gap = (uint32_t) (now - prev);
+      if((st->gapMinUs == 0) || (gap < st->gapMinUs))
+        st->gapMinUs = gap;
+      if(gap > st->gapMaxUs)
+        st->gapMaxUs = gap;
+    }
+    prev = now;
+
+    if(samplerRead(sp, &answer, due + periodUs) == UART_SUCCESS)
+      samplerPush(sp, seq, now, &answer);
+    else
+      st->failed++;
+
+    seq++;
+    due += periodUs;
+    now = uartMicros();
+    if(now > due) {
+      skipped = (now - due) / periodUs;
+      st->missed += (uint32_t) skipped;
+      seq += (uint32_t) skipped;
+      due += skipped * periodUs;
+    }
+  }
+}
+
+/* Ask uartSamplerRun() to return; it does once the sample in progress, if any, is done. */
+void uartSamplerStop(uart_sampler_t *sp) {
+  sp->stop = 1;
+  uartEventSignal(&sp->wake);
+}
+
+/* Consumer: take the oldest sample.  Returns 1, or 0 if there is none. */
+int uartSamplerPop(uart_sampler_t *sp, uart_sample_entry_t *e) {
+  uint32_t tail = sp->tail.load(std::memory_order_relaxed);
+
+  if(tail == sp->head.load(std::memory_order_acquire))
+    return 0;
+  *e = sp->ring[tail & SAMPLER_MASK];
+  sp->tail.store(tail + 1, std::memory_order_release);
+  return 1;
+}
+
+uint32_t uartSamplerCount(uart_sampler_t *sp) {
+  return sp->head.load(std::memory_order_acquire) - sp->tail.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,86 @@
+/********************************************************************************************************==*
+*                                      Fixed-rate sampler for NNTS
+* Filename      : uart_sampler.h
+**********************************************************************************************************
+* Notes         : uartSamplerRun() is a thread body that reads CMD_ANSWER every periodMs, optionally after
+*                 triggering a measurement with CMD_MEAS, and pushes each good answer_t with its time stamp
+*                 into a preallocated single-producer/single-consumer ring.  The consumer pops them with
+*                 uartSamplerPop() from any one other thread.
+*
+*                 Deadlines are absolute, due = start + n * periodMs, so late samples do not shift the
+*                 ones after them.  A sample that could not go out before its successor was due is missed:
+*                 n skips ahead, and seq shows the gap.  The wait sleeps in whole ms.  On the host it spins
+*                 the last fraction of one, so the lateness stays in the us range on an idle link; on the
+*                 target it sleeps one more tick instead, since spinning above normal priority would starve
+*                 every other thread, and a sample may be up to a tick late.
+*
+*                 The transactions run at UART_PRIO_SAFETY, see uart_sched.h, and may take one period
+*                 with their retries.  When the ring is full the new sample is dropped and counted.
+*/
+
+#ifndef __UART_SAMPLER_H
+#define __UART_SAMPLER_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include <atomic>
+#include "uart_client.h"
+#include "uart_platform.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#ifndef UART_SAMPLER_RING
+#define UART_SAMPLER_RING   32      /* samples in the ring, a power of two */
+#endif
+
+#ifndef UART_SAMPLER_SPIN
+#ifdef __MBED__
+#define UART_SAMPLER_SPIN   0       /* spin out the last ms before a deadline instead of sleeping */
+#else
+#define UART_SAMPLER_SPIN   1
+#endif
+#endif
+
+#ifndef UART_SAMPLER_STACK_SIZE
+#define UART_SAMPLER_STACK_SIZE 2048    /* sampler thread stack on the target: a transaction with retries */
+#endif
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uint32_t seq;             /* deadline number since the start; gaps are missed or failed samples */
+  uint64_t timeUs;          /* uartMicros() when the request went out */
+  answer_t answer;
+} uart_sample_entry_t;
+
+/* Written by the sampler thread only; read while it runs, each counter is current but not the set. */
+typedef struct {
+  uint32_t samples;         /* good answers pushed */
+  uint32_t failed;          /* transactions that failed */
+  uint32_t missed;          /* deadlines skipped because the sample before ran past them */
+  uint32_t dropped;         /* good answers lost to a full ring */
+  uint64_t lateSumUs;       /* how long after its deadline each request went out */
+  uint32_t lateMaxUs;
+  uint32_t gapMinUs;        /* between two consecutive requests, periodMs * 1000 if on time */
+  uint32_t gapMaxUs;
+} uart_sampler_stats_t;
+
+typedef struct {
+  uart_session_t *session;
+  uint32_t periodMs;
+  int trigger;              /* send CMD_MEAS with measArg before each CMD_ANSWER */
+  uint8_t measArg;
+  volatile int stop;
+  uart_event_t wake;        /* cuts the wait short on uartSamplerStop() */
+  uart_sample_entry_t ring[UART_SAMPLER_RING];
+  std::atomic<uint32_t> head;   /* written by the sampler only */
+  std::atomic<uint32_t> tail;   /* written by the consumer only */
+  uart_sampler_stats_t stats;
+} uart_sampler_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartSamplerInit(uart_sampler_t *sp, uart_session_t *s, uint32_t periodMs);
+void uartSamplerRun(uart_sampler_t *sp);
+void uartSamplerStop(uart_sampler_t *sp);
+int uartSamplerPop(uart_sampler_t *sp, uart_sample_entry_t *e);
+uint32_t uartSamplerCount(uart_sampler_t *sp);
+
+#endif /* __UART_SAMPLER_H */
@@ -0,0 +1,187 @@
+/********************************************************************************************************==*
+*                                      Transaction scheduler for NNTS
+* Filename      : uart_sched.cpp
+**********************************************************************************************************
+* Notes         : A class waits in front of the session lock until no more urgent class is queued; the
+*                 ones queued in front of it only leave the queue once they hold the lock, so nothing
+*                 less urgent slips in between.  Lock order is session lock, then the scheduler lock.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_sched.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Local variables --------------------------------------------------------------------------------------*/
+static const char *const className[UART_PRIO_COUNT] = {"safety", "normal", "bulk"};
+
+/* Local functions --------------------------------------------------------------------------------------*/
+/* With q->lock held: is a class more urgent than prio waiting? */
+static int schedBlocked(uart_sched_t *q, uint32_t prio) {
+  uint32_t ii;
+
+  for(ii = 0; ii < prio; ii++) {
+    if(q->cls[ii].queued)
+      return 1;
+  }
+  return 0;
+}
+
+/* With q->lock held: prio got the link, it asked for it at askedUs. */
+static void schedGranted(uart_sched_t *q, uint32_t prio, uint64_t askedUs) {
+  uart_sched_class_t *c = &q->cls[prio];
+  uint64_t now = uartMicros();
+  uint32_t waitUs = (uint32_t) (now - askedUs);
+
+  c->transactions++;
+  c->waitSumUs += waitUs;
+  if(waitUs > c->waitMaxUs)
+    c->waitMaxUs = waitUs;
+  if(c->lastUs && (now - c->lastUs > c->gapMaxUs))
+    c->gapMaxUs = (uint32_t) (now - c->lastUs);
+  c->lastUs = now;
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+/* Schedule the transactions on s through q from now on.  Call after uartSessionInit(), with s idle. */
+void uartSchedInit(uart_sched_t *q, uart_session_t *s) {
+  memset(q->cls, 0, sizeof(q->cls));
+  s->sched = q;
+}
+
+/*
+ * Take the link for a transaction of class prio, waiting behind every more urgent class first.  Nests
+ * like uartSessionLock(), and is uartSessionLock() on a session without a scheduler.  Give the link back
+ * with uartSchedRelease().
+ */
+void uartSchedAcquire(uart_session_t *s, uint32_t prio) {
+  uart_sched_t *q = s->sched;
+  uart_sched_class_t *c;
+  uint64_t askedUs;
+  uint32_t ii;
+
+  if(q == NULL) {
+    uartSessionLock(s);
+    return;
+  }
+  askedUs = uartMicros();
+
+  /* free, or already ours: no need to queue unless someone more urgent is */
+  if(uartMutexTryLock(&s->lock)) {
+    uartMutexLock(&q->lock);
+    if((s->depth != 0) || !schedBlocked(q, prio)) {
+      if(s->depth++ == 0)
+        schedGranted(q, prio, askedUs);
+      uartMutexUnlock(&q->lock);
+      return;
+    }
+    uartMutexUnlock(&q->lock);
+    uartMutexUnlock(&s->lock);
+  }
+
+  c = &q->cls[prio];
+  uartMutexLock(&q->lock);
+  if(++c->queued > c->queueMax)
+    c->queueMax = c->queued;
+  while(schedBlocked(q, prio)) {
+    uartMutexUnlock(&q->lock);
+    uartEventWait(&q->wake[prio], UART_SCHED_RECHECK_MS);
+    uartMutexLock(&q->lock);
+  }
+  if(c->queued > 1)
+    uartEventSignal(&q->wake[prio]);   /* the others of the class may go on too */
+  uartMutexUnlock(&q->lock);
+
+  uartSessionLock(s);
+  uartMutexLock(&q->lock);
+  c->queued--;
+  schedGranted(q, prio, askedUs);
+  for(ii = prio + 1; ii < UART_PRIO_COUNT; ii++) {
+    if(!schedBlocked(q, ii))
+      uartEventSignal(&q->wake[ii]);
+  }
+  uartMutexUnlock(&q->lock);
+}
+
+void uartSchedRelease(uart_session_t *s) {
+  uartSessionUnlock(s);
+}
+
+/* Is a class more urgent than prio waiting for the link of s? */
+int uartSchedPending(uart_session_t *s, uint32_t prio) {
+  uart_sched_t *q = s->sched;
+  int pending;
+
+  if(q == NULL)
+    return 0;
+  uartMutexLock(&q->lock);
+  pending = schedBlocked(q, prio);
+  uartMutexUnlock(&q->lock);
+  return pending;
+}
+
+/*
+ * Called by a long transaction of class prio at a point where the link is idle: if a more urgent class
+ * waits, let it through and take the link back after it.  Only the outermost holder can give the link
+ * up.  Returns 1 if it did.
+ */
+int uartSchedYield(uart_session_t *s, uint32_t prio) {
+  uart_sched_t *q = s->sched;
+
+  if((q == NULL) || (s->depth != 1) || !uartSchedPending(s, prio))
+    return 0;
+  uartMutexLock(&q->lock);
+  q->cls[prio].yields++;
+  uartMutexUnlock(&q->lock);
+
+  uartSessionUnlock(s);
+  uartSchedAcquire(s, prio);
+  return 1;
+}
+
+/* uartSessionTransact() as a transaction of class prio. */
+uint32_t uartSchedTransact(uart_session_t *s, uint32_t prio, uint8_t cmdID, uint8_t *txPayload, uint16_t txLen,
+                           uint8_t *rxPayload, uint16_t rxLen) {
+  uint32_t sts;
+
+  uartSchedAcquire(s, prio);
+  sts = uartSessionTransact(s, cmdID, txPayload, txLen, rxPayload, rxLen);
+  uartSchedRelease(s);
+  return sts;
+}
+
+/* A consistent snapshot of class prio. */
+void uartSchedGet(uart_sched_t *q, uint32_t prio, uart_sched_class_t *c) {
+  uartMutexLock(&q->lock);
+  *c = q->cls[prio];
+  uartMutexUnlock(&q->lock);
+}
+
+/* Clear the statistics; what is queued right now stays queued. */
+void uartSchedReset(uart_sched_t *q) {
+  uint32_t ii, queued;
+
+  uartMutexLock(&q->lock);
+  for(ii = 0; ii < UART_PRIO_COUNT; ii++) {
+    queued = q->cls[ii].queued;
+    memset(&q->cls[ii], 0, sizeof(q->cls[ii]));
+    q->cls[ii].queued = queued;
+  }
+  uartMutexUnlock(&q->lock);
+}
+
+/* One line per class that has had the link. */
+void uartSchedDump(uart_sched_t *q) {
+  uart_sched_class_t c;
+  uint32_t ii;
+
+  printf("class      txns  queue max  yields  wait avg us  wait max us   gap max us\r\n");
+  for(ii = 0; ii < UART_PRIO_COUNT; ii++) {
+    uartSchedGet(q, ii, &c);
+    if(c.transactions == 0)
+      continue;
+    printf("%-6s %8u %10u %7u %12llu %12u %12u\r\n", className[ii], c.transactions, c.queueMax, c.yields,
+           (unsigned long long) (c.waitSumUs / c.transactions), c.waitMaxUs, c.gapMaxUs);
+  }
+}
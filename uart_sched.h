@@ -0,0 +1,70 @@
+/********************************************************************************************************==*
+*                                      Transaction scheduler for NNTS
+* Filename      : uart_sched.h
+**********************************************************************************************************
+* Notes         : Orders the transactions waiting for a session's link by priority class, so a
+*                 concentration poll is not stuck behind a whole engineering data download.  Without a
+*                 scheduler the session lock is first come, first served.
+*
+*                 A transaction asks for the link with uartSchedAcquire().  It goes ahead only while no
+*                 transaction of a more urgent class waits, and the download (UART_PRIO_BULK) gives the
+*                 link up at chunk boundaries whenever one does, see uartSessionEngDataDownload().  So a
+*                 UART_PRIO_SAFETY transaction waits at most for ENGDATA_AHEAD + 1 chunks to come in plus
+*                 one UART_PRIO_NORMAL transaction that was already waiting for the lock itself; its poll
+*                 interval is the caller's period plus that.  gapMaxUs shows what was actually reached.
+*
+*                 The plain session calls run at UART_PRIO_NORMAL, the download at UART_PRIO_BULK.
+*                 Calls made while the caller already holds the link (uartLock, or inside an acquired
+*                 transaction) are part of that transaction and are not queued again.  Sequences under a
+*                 bare uartSessionLock() are not scheduled at all.
+*/
+
+#ifndef __UART_SCHED_H
+#define __UART_SCHED_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_client.h"
+#include "uart_platform.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define UART_PRIO_SAFETY        0     /* alarm path: CMD_CONC, CMD_ANSWER polls */
+#define UART_PRIO_NORMAL        1     /* everything else */
+#define UART_PRIO_BULK          2     /* engineering data, gives way at chunk boundaries */
+#define UART_PRIO_COUNT         3
+
+#ifndef UART_SCHED_RECHECK_MS
+#define UART_SCHED_RECHECK_MS   5     /* a waiting class looks again this often should a wakeup go astray */
+#endif
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uint32_t transactions;    /* times the class got the link, yields of the download included */
+  uint32_t queued;          /* waiting now */
+  uint32_t queueMax;
+  uint32_t yields;          /* times the class gave the link to a more urgent one */
+  uint64_t waitSumUs;       /* from asking for the link to getting it */
+  uint32_t waitMaxUs;
+  uint32_t gapMaxUs;        /* longest time between two transactions of the class getting the link */
+  uint64_t lastUs;          /* when the class last got the link, 0 before the first time */
+} uart_sched_class_t;
+
+typedef struct uart_sched {
+  uart_mutex_t lock;        /* guards the classes, never held while waiting */
+  uart_event_t wake[UART_PRIO_COUNT];
+  uart_sched_class_t cls[UART_PRIO_COUNT];
+} uart_sched_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartSchedInit(uart_sched_t *q, uart_session_t *s);
+void uartSchedAcquire(uart_session_t *s, uint32_t prio);
+void uartSchedRelease(uart_session_t *s);
+int uartSchedPending(uart_session_t *s, uint32_t prio);
+int uartSchedYield(uart_session_t *s, uint32_t prio);
+uint32_t uartSchedTransact(uart_session_t *s, uint32_t prio, uint8_t cmdID, uint8_t *txPayload, uint16_t txLen,
+                           uint8_t *rxPayload, uint16_t rxLen);
+void uartSchedGet(uart_sched_t *q, uint32_t prio, uart_sched_class_t *c);
+void uartSchedReset(uart_sched_t *q);
+void uartSchedDump(uart_sched_t *q);
+
+#endif /* __UART_SCHED_H */
@@ -0,0 +1,334 @@
+/********************************************************************************************************==*
+*                                      answer_t time series blocks for NNTS
+* Filename      : uart_series.cpp
+**********************************************************************************************************
+* Notes         : The writer keeps the samples of the open block and the exact number of bytes they will
+*                 take, so a block is encoded once, when the next sample would not fit any more.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_series.h"
+#include "checksum.h"
+#include <string.h>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define COL_TIME            0
+#define COL_CYCLE           1
+#define COL_CONC            2
+#define COL_FLAM            3
+#define COL_TEMP            4
+#define COL_PRES            5
+#define COL_REL_HUM         6
+#define COL_ABS_HUM         7
+
+#define CKSUM_OFFSET        6     /* of cksum in the wire header */
+
+static_assert(UART_SERIES_HDR_SIZE + UART_SERIES_SAMPLE_MAX <= UART_SERIES_BLOCK, "a block holds a sample");
+static_assert(UART_SERIES_MAX_SAMPLES <= 0xFFFF, "sample count is 16 bit");
+
+/* Local variables --------------------------------------------------------------------------------------*/
+/* Column of each float of seriesFloats(), in order */
+static const uint8_t floatCol[5] = {COL_CONC, COL_TEMP, COL_PRES, COL_REL_HUM, COL_ABS_HUM};
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static void seriesFloats(const answer_t *a, uint32_t bits[5]) {
+  memcpy(&bits[0], &a->concentration, 4);
+  memcpy(&bits[1], &a->temp, 4);
+  memcpy(&bits[2], &a->pressure, 4);
+  memcpy(&bits[3], &a->relHumidity, 4);
+  memcpy(&bits[4], &a->absHumidity, 4);
+}
+
+static void seriesSetFloat(answer_t *a, uint32_t ii, uint32_t bits) {
+  float *field[5] = {&a->concentration, &a->temp, &a->pressure, &a->relHumidity, &a->absHumidity};
+
+  memcpy(field[ii], &bits, 4);
+}
+
+static uint64_t zigzag(int64_t v) {
+  return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+  return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+static uint32_t varintSize(uint64_t v) {
+  uint32_t n = 1;
+
+  for(; v >= 0x80; v >>= 7)
+    n++;
+  return n;
+}
+
+static uint8_t *varintPut(uint8_t *p, uint64_t v) {
+  for(; v >= 0x80; v >>= 7)
+    *p++ = (uint8_t) (v | 0x80);
+  *p++ = (uint8_t) v;
+  return p;
+}
+
+/* NULL if the varint runs past end or is longer than 64 bits. */
+static const uint8_t *varintGet(const uint8_t *p, const uint8_t *end, uint64_t *v) {
+  uint32_t shift;
+
+  *v = 0;
+  for(shift = 0; (p < end) && (shift < 64); shift += 7) {
+    *v |= (uint64_t) (*p & 0x7F) << shift;
+    if((*p++ & 0x80) == 0)
+      return p;
+  }
+  return NULL;
+}
+
+/* Bytes left of x once its leading and trailing zero bytes are dropped, x != 0. */
+static uint32_t xorBytes(uint32_t x) {
+  return 4 - __builtin_clz(x) / 8 - __builtin_ctz(x) / 8;
+}
+
+static uint32_t xorSize(uint32_t x) {
+  return x ? 1 + xorBytes(x) : 1;
+}
+
+static uint8_t *xorPut(uint8_t *p, uint32_t x) {
+  uint32_t tz, len;
+
+  if(x == 0) {
+    *p++ = 0;
+    return p;
+  }
+  tz = __builtin_ctz(x) / 8;
+  len = xorBytes(x);
+  *p++ = (uint8_t) ((tz << 4) | len);
+  for(x >>= 8 * tz; len; len--, x >>= 8)
+    *p++ = (uint8_t) x;
+  return p;
+}
+
+static const uint8_t *xorGet(const uint8_t *p, const uint8_t *end, uint32_t *x) {
+  uint32_t tz, len, ii;
+
+  if(p >= end)
+    return NULL;
+  tz = *p >> 4;
+  len = *p++ & 0x0F;
+  *x = 0;
+  if((tz | len) == 0)
+    return p;
+  if((len == 0) || (tz + len > 4) || ((uint32_t) (end - p) < len))
+    return NULL;
+  for(ii = 0; ii < len; ii++)
+    *x |= (uint32_t) *p++ << (8 * ii);
+  *x <<= 8 * tz;
+  return p;
+}
+
+/* Bytes s adds to the open block. */
+static uint32_t seriesCost(const uart_series_writer_t *w, const uart_sample_t *s) {
+  uint32_t bits[5], ii, cost;
+
+  cost = varintSize(zigzag((int64_t) (s->timeMs - w->prevTime)));
+  cost += varintSize(zigzag((int32_t) (s->answer.cycleCount - w->prevCycle)));
+  seriesFloats(&s->answer, bits);
+  for(ii = 0; ii < 5; ii++)
+    cost += xorSize(bits[ii] ^ w->prevBits[ii]);
+  if(w->count && (s->answer.flamID == w->flamValue))
+    cost += varintSize(w->flamRun + 1) - varintSize(w->flamRun);
+  else
+    cost += varintSize(s->answer.flamID) + 1;
+  return cost;
+}
+
+static void seriesRange(float v, float *min, float *max, int first) {
+  if(first || (v < *min))
+    *min = v;
+  if(first || (v > *max))
+    *max = v;
+}
+
+static uint16_t seriesCrc(const uint8_t *block) {
+  static const uint8_t zero[2] = {0, 0};
+  uint16_t crc;
+
+  crc = crc_generate(block, CKSUM_OFFSET, 0xFFFF);
+  crc = crc_generate(zero, sizeof(zero), crc);
+  return crc_generate(&block[CKSUM_OFFSET + 2], UART_SERIES_BLOCK - CKSUM_OFFSET - 2, crc);
+}
+
+/* Encode the open block, header and columns, into block. */
+static void seriesEncode(const uart_series_writer_t *w, uint8_t *block) {
+  const uart_sample_t *s;
+  uart_series_hdr_t hdr;
+  uint8_t *p = block + UART_SERIES_HDR_SIZE;
+  uint32_t ii, jj, bits[5], prevBits, flam, run, prevCycle = 0;
+  uint64_t prevTime = 0;
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = UART_SERIES_MAGIC;
+  hdr.count = (uint16_t) w->count;
+  hdr.firstTimeMs = w->samples[0].timeMs;
+  hdr.lastTimeMs = w->samples[w->count - 1].timeMs;
+
+  for(ii = 0; ii < w->count; ii++) {
+    s = &w->samples[ii];
+    p = varintPut(p, zigzag((int64_t) (s->timeMs - prevTime)));
+    prevTime = s->timeMs;
+  }
+  hdr.colEnd[COL_TIME] = (uint16_t) (p - block);
+
+  for(ii = 0; ii < w->count; ii++) {
+    s = &w->samples[ii];
+    p = varintPut(p, zigzag((int32_t) (s->answer.cycleCount - prevCycle)));
+    prevCycle = s->answer.cycleCount;
+    if((ii == 0) || (s->answer.cycleCount < hdr.minCycle))
+      hdr.minCycle = s->answer.cycleCount;
+    if((ii == 0) || (s->answer.cycleCount > hdr.maxCycle))
+      hdr.maxCycle = s->answer.cycleCount;
+  }
+  hdr.colEnd[COL_CYCLE] = (uint16_t) (p - block);
+
+  for(jj = 0; jj < 5; jj++) {
+    if(jj == 1) {   /* flamID sits between concentration and temp */
+      for(ii = 0; ii < w->count; ii += run) {
+        flam = w->samples[ii].answer.flamID;
+        for(run = 1; (ii + run < w->count) && (w->samples[ii + run].answer.flamID == flam); run++)
+          ;
+        p = varintPut(p, flam);
+        p = varintPut(p, run);
+      }
+      hdr.colEnd[COL_FLAM] = (uint16_t) (p - block);
+    }
+
+    for(ii = 0, prevBits = 0; ii < w->count; ii++) {
+      seriesFloats(&w->samples[ii].answer, bits);
+      p = xorPut(p, bits[jj] ^ prevBits);
+      prevBits = bits[jj];
+    }
+    hdr.colEnd[floatCol[jj]] = (uint16_t) (p - block);
+  }
+
+  for(ii = 0; ii < w->count; ii++) {
+    s = &w->samples[ii];
+    seriesRange(s->answer.concentration, &hdr.minConc, &hdr.maxConc, ii == 0);
+    seriesRange(s->answer.temp, &hdr.minTemp, &hdr.maxTemp, ii == 0);
+    seriesRange(s->answer.pressure, &hdr.minPres, &hdr.maxPres, ii == 0);
+    seriesRange(s->answer.relHumidity, &hdr.minRelHum, &hdr.maxRelHum, ii == 0);
+    seriesRange(s->answer.absHumidity, &hdr.minAbsHum, &hdr.maxAbsHum, ii == 0);
+  }
+
+  memset(p, 0, UART_SERIES_BLOCK - (p - block));
+  uart_codec<uart_series_hdr_t>::encode(&hdr, block);
+  uartStore16(&block[CKSUM_OFFSET], seriesCrc(block));
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartSeriesInit(uart_series_writer_t *w) {
+  w->count = 0;
+  w->size = UART_SERIES_HDR_SIZE;
+  w->prevTime = 0;
+  w->prevCycle = 0;
+  memset(w->prevBits, 0, sizeof(w->prevBits));
+  w->flamValue = 0;
+  w->flamRun = 0;
+}
+
+/*
+ * Add s to the open block.  Returns 1 if the block was full: it has been encoded into block (which must
+ * hold UART_SERIES_BLOCK bytes) and s opens the next one.  Returns 0 otherwise, block is untouched.
+ */
+int uartSeriesAppend(uart_series_writer_t *w, const uart_sample_t *s, uint8_t *block) {
+  int full = 0;
+
+  if((w->count == UART_SERIES_MAX_SAMPLES) || (w->size + seriesCost(w, s) > UART_SERIES_BLOCK))
+    full = uartSeriesFlush(w, block);
+
+  w->size += seriesCost(w, s);
+  if(w->count && (s->answer.flamID == w->flamValue)) {
+    w->flamRun++;
+  } else {
+    w->flamValue = s->answer.flamID;
+    w->flamRun = 1;
+  }
+  w->prevTime = s->timeMs;
+  w->prevCycle = s->answer.cycleCount;
+  seriesFloats(&s->answer, w->prevBits);
+  w->samples[w->count++] = *s;
+  return full;
+}
+
+/* Encode the open block into block, even if it is not full.  Returns 0 if it was empty. */
+int uartSeriesFlush(uart_series_writer_t *w, uint8_t *block) {
+  if(w->count == 0)
+    return 0;
+  seriesEncode(w, block);
+  uartSeriesInit(w);
+  return 1;
+}
+
+/* Header of a block, without checking its CRC.  Returns 0, or -1 if it is not a series block. */
+int uartSeriesHeader(const uint8_t *block, uart_series_hdr_t *hdr) {
+  uint32_t ii, start = UART_SERIES_HDR_SIZE;
+
+  uart_codec<uart_series_hdr_t>::decode(block, hdr);
+  if((hdr->magic != UART_SERIES_MAGIC) || (hdr->count == 0) || (hdr->count > UART_SERIES_MAX_SAMPLES))
+    return -1;
+  for(ii = 0; ii < UART_SERIES_COLUMNS; ii++) {
+    if((hdr->colEnd[ii] < start) || (hdr->colEnd[ii] > UART_SERIES_BLOCK))
+      return -1;
+    start = hdr->colEnd[ii];
+  }
+  return 0;
+}
+
+/*
+ * Check and decode a block into samples, which must hold UART_SERIES_MAX_SAMPLES.  Returns the number of
+ * samples, or -1 if the block is damaged.
+ */
+int uartSeriesDecode(const uint8_t *block, uart_series_hdr_t *hdr, uart_sample_t *samples) {
+  const uint8_t *p, *end;
+  uint64_t v, len, time = 0;
+  uint32_t ii, jj, x, bits, cycle = 0;
+
+  if((uartSeriesHeader(block, hdr) != 0) || (seriesCrc(block) != hdr->cksum))
+    return -1;
+
+  p = block + UART_SERIES_HDR_SIZE;
+  end = block + hdr->colEnd[COL_TIME];
+  for(ii = 0; ii < hdr->count; ii++) {
+    if((p = varintGet(p, end, &v)) == NULL)
+      return -1;
+    time += (uint64_t) unzigzag(v);
+    samples[ii].timeMs = time;
+  }
+
+  end = block + hdr->colEnd[COL_CYCLE];
+  for(ii = 0; ii < hdr->count; ii++) {
+    if((p = varintGet(p, end, &v)) == NULL)
+      return -1;
+    cycle += (uint32_t) unzigzag(v);
+    samples[ii].answer.cycleCount = cycle;
+  }
+
+  for(jj = 0; jj < 5; jj++) {
+    if(jj == 1) {
+      end = block + hdr->colEnd[COL_FLAM];
+      for(ii = 0; ii < hdr->count;) {
+        if(((p = varintGet(p, end, &v)) == NULL) || ((p = varintGet(p, end, &len)) == NULL) ||
+           (len == 0) || (len > hdr->count - ii))
+          return -1;
+        for(; len; len--)
+          samples[ii++].answer.flamID = (uint32_t) v;
+      }
+    }
+
+    end = block + hdr->colEnd[floatCol[jj]];
+    for(ii = 0, bits = 0; ii < hdr->count; ii++) {
+      if((p = xorGet(p, end, &x)) == NULL)
+        return -1;
+      bits ^= x;
+      seriesSetFloat(&samples[ii].answer, jj, bits);
+    }
+  }
+  return hdr->count;
+}
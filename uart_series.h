@@ -0,0 +1,89 @@
+/********************************************************************************************************==*
+*                                      answer_t time series blocks for NNTS
+* Filename      : uart_series.h
+**********************************************************************************************************
+* Notes         : Samples are stored in fixed-size blocks of UART_SERIES_BLOCK bytes, column by column:
+*                 first the time stamps, then each field of answer_t in declaration order.
+*
+*                   time, cycleCount    zigzag varint of the difference to the previous sample
+*                   float fields        XOR with the previous value of the column; a control byte gives
+*                                       the trailing zero bytes (high nibble) and the bytes that follow
+*                                       (low nibble), 0x00 alone means unchanged
+*                   flamID              runs of (varint value, varint length)
+*
+*                 The previous values start at zero in every block, so a block decodes on its own.  The
+*                 header carries the sample count, the time and cycle range, the range of every float
+*                 field and where each column ends, so a reader can skip blocks without decoding them.
+*                 A CRC-16 over the whole block guards the rest.
+*
+*                 Time stamps must not go backwards within a series; cycle counts may (sensor reset).
+*                 This is only the block codec - host/uart_series_file.h keeps blocks in a file.
+*/
+
+#ifndef __UART_SERIES_H
+#define __UART_SERIES_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_proto.h"
+#include "uart_wire.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define UART_SERIES_BLOCK       4096
+#define UART_SERIES_MAGIC       0x4B4C4253u   /* "SBLK" */
+#define UART_SERIES_COLUMNS     8
+#define UART_SERIES_MAX_SAMPLES 600           /* a sample takes at least 7 bytes */
+#define UART_SERIES_SAMPLE_MAX  50            /* most bytes a sample can take, over all columns */
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uint64_t timeMs;
+  answer_t answer;
+} uart_sample_t;
+
+typedef struct {
+  uint32_t magic;
+  uint16_t count;
+  uint16_t cksum;         /* CRC-16 of the block with this field zeroed */
+  uint64_t firstTimeMs;
+  uint64_t lastTimeMs;
+  uint32_t minCycle;
+  uint32_t maxCycle;
+  float minConc, maxConc;
+  float minTemp, maxTemp;
+  float minPres, maxPres;
+  float minRelHum, maxRelHum;
+  float minAbsHum, maxAbsHum;
+  uint16_t colEnd[UART_SERIES_COLUMNS];   /* block offset one past each column */
+} uart_series_hdr_t;
+
+#define UART_WIRE_uart_series_hdr_t(F) \
+  F(U32, magic) F(U16, count) F(U16, cksum) F(U64, firstTimeMs) F(U64, lastTimeMs) F(U32, minCycle) \
+  F(U32, maxCycle) F(F32, minConc) F(F32, maxConc) F(F32, minTemp) F(F32, maxTemp) F(F32, minPres) \
+  F(F32, maxPres) F(F32, minRelHum) F(F32, maxRelHum) F(F32, minAbsHum) F(F32, maxAbsHum) \
+  F(U16, colEnd[0]) F(U16, colEnd[1]) F(U16, colEnd[2]) F(U16, colEnd[3]) F(U16, colEnd[4]) \
+  F(U16, colEnd[5]) F(U16, colEnd[6]) F(U16, colEnd[7])
+UART_WIRE_CODEC(uart_series_hdr_t)
+
+#define UART_SERIES_HDR_SIZE    uart_codec<uart_series_hdr_t>::wireSize
+
+/* Samples of the block being filled, and the exact size they will encode to. */
+typedef struct {
+  uart_sample_t samples[UART_SERIES_MAX_SAMPLES];
+  uint32_t count;
+  uint32_t size;          /* bytes the block needs so far, header included */
+  uint64_t prevTime;
+  uint32_t prevCycle;
+  uint32_t prevBits[5];
+  uint32_t flamValue;     /* run being counted */
+  uint32_t flamRun;
+} uart_series_writer_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartSeriesInit(uart_series_writer_t *w);
+int uartSeriesAppend(uart_series_writer_t *w, const uart_sample_t *s, uint8_t *block);
+int uartSeriesFlush(uart_series_writer_t *w, uint8_t *block);
+int uartSeriesHeader(const uint8_t *block, uart_series_hdr_t *hdr);
+int uartSeriesDecode(const uint8_t *block, uart_series_hdr_t *hdr, uart_sample_t *samples);
+
+#endif /* __UART_SERIES_H */
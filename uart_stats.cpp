@@ -0,0 +1,300 @@
+/********************************************************************************************************==*
+*                                      Streaming statistics for NNTS
+* Filename      : uart_stats.cpp
+**********************************************************************************************************
+* Notes         : P-square after Jain and Chlamtac, CACM 28(10), 1985: five markers track the minimum,
+*                 p/2, p, (1+p)/2 and the maximum, and the middle three are moved along a parabola
+*                 through their neighbours whenever they drift a whole position from where they should be.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_stats.h"
+#include "uart_format.h"
+#include "uart_log.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Variables --------------------------------------------------------------------------------------------*/
+const char *const uartStatsFieldName[UART_STATS_FIELDS] = {"conc", "temp", "pres", "relHum", "absHum"};
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static float statsValue(const answer_t *a, uint32_t field) {
+  switch(field) {
+    case 0: return a->concentration;
+    case 1: return a->temp;
+    case 2: return a->pressure;
+    case 3: return a->relHumidity;
+    default: return a->absHumidity;
+  }
+}
+
+static void p2Sort(float *v, uint32_t n) {
+  uint32_t ii, jj;
+  float x;
+
+  for(ii = 1; ii < n; ii++) {
+    x = v[ii];
+    for(jj = ii; (jj > 0) && (v[jj - 1] > x); jj--)
+      v[jj] = v[jj - 1];
+    v[jj] = x;
+  }
+}
+
+/* Height of marker i moved by d (+1 or -1) positions: parabolic, or linear if that leaves the order. */
+static float p2Move(const uart_p2_t *e, uint32_t i, int32_t d) {
+  float q = e->q[i], qp;
+  float n0 = (float) e->n[i - 1], n1 = (float) e->n[i], n2 = (float) e->n[i + 1];
+
+  qp = q + d / (n2 - n0) * ((n1 - n0 + d) * (e->q[i + 1] - q) / (n2 - n1) +
+                            (n2 - n1 - d) * (q - e->q[i - 1]) / (n1 - n0));
+  if((e->q[i - 1] < qp) && (qp < e->q[i + 1]))
+    return qp;
+  return q + d * (e->q[i + d] - q) / (float) (e->n[i + d] - e->n[i]);
+}
+
+static void statsReset(uart_stats_t *st) {
+  uart_stats_field_t *f;
+  uint32_t ii, jj;
+
+  for(ii = 0; ii < UART_STATS_FIELDS; ii++) {
+    f = &st->field[ii];
+    f->count = 0;
+    f->min = 0;
+    f->max = 0;
+    f->mean = 0;
+    f->m2 = 0;
+    for(jj = 0; jj < st->cfg.quantiles; jj++)
+      uartP2Init(&f->q[jj], st->cfg.quantile[jj]);
+  }
+}
+
+static void statsPrint(const uart_stats_report_t *r) {
+  char text[UART_FMT_LINE_MAX];
+  uint32_t ii;
+
+  for(ii = 0; ii < UART_STATS_FIELDS; ii++)
+    uartLogText(text, uartStatsFormat(text, sizeof(text), r, ii, uartFmtDecimals));
+}
+
+/* Report the window and start the next one. */
+static void statsClose(uart_stats_t *st) {
+  uart_stats_report_t r;
+  uart_stats_field_t *f;
+  uint32_t ii, jj;
+
+  r.window = st->window++;
+  r.count = st->field[0].count;
+  r.startUs = st->startUs;
+  r.endUs = st->lastUs;
+  r.firstCycle = st->firstCycle;
+  r.lastCycle = st->lastCycle;
+  r.flamID = st->flamID;
+  r.quantiles = st->cfg.quantiles;
+  for(ii = 0; ii < UART_STATS_FIELDS; ii++) {
+    f = &st->field[ii];
+    r.field[ii].min = f->min;
+    r.field[ii].max = f->max;
+    r.field[ii].mean = f->mean;
+    r.field[ii].var = (f->count > 1) ? f->m2 / (f->count - 1) : 0.0f;
+    r.field[ii].ewma = f->ewma;
+    for(jj = 0; jj < r.quantiles; jj++)
+      r.field[ii].q[jj] = uartP2Get(&f->q[jj]);
+  }
+  statsReset(st);
+
+  if(st->report != NULL)
+    st->report(st->ctx, &r);
+  else
+    statsPrint(&r);
+}
+
+static int statsProcess(uart_answer_stage_t *stage, const answer_t *answer, uint64_t timeUs) {
+  uart_stats_t *st = (uart_stats_t *) stage;
+
+  uartStatsAdd(st, answer, timeUs);
+  return st->cfg.passThrough;
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartP2Init(uart_p2_t *e, float p) {
+  e->p = p;
+  e->count = 0;
+}
+
+void uartP2Add(uart_p2_t *e, float x) {
+  float p = e->p, d;
+  uint32_t ii, k;
+  int32_t step;
+
+  if(e->count < 5) {
+    e->q[e->count++] = x;
+    if(e->count == 5) {
+      p2Sort(e->q, 5);
+      for(ii = 0; ii < 5; ii++)
+        e->n[ii] = (int32_t) ii;
+      e->np[0] = 0;
+      e->np[1] = 2 * p;
+      e->np[2] = 4 * p;
+      e->np[3] = 2 + 2 * p;
+      e->np[4] = 4;
+    }
+    return;
+  }
+
+  /* cell k holds x; the extremes follow it out */
+  if(x < e->q[0]) {
+    e->q[0] = x;
+    k = 0;
+  } else if(x >= e->q[4]) {
+    e->q[4] = x;
+    k = 3;
+  } else {
+    for(k = 0; x >= e->q[k + 1]; k++)
+      ;
+  }
+  for(ii = k + 1; ii < 5; ii++)
+    e->n[ii]++;
+  e->np[1] += p / 2;
+  e->np[2] += p;
+  e->np[3] += (1 + p) / 2;
+  e->np[4] += 1;
+  e->count++;
+
+  for(ii = 1; ii < 4; ii++) {
+    d = e->np[ii] - e->n[ii];
+    if(((d >= 1) && (e->n[ii + 1] - e->n[ii] > 1)) || ((d <= -1) && (e->n[ii - 1] - e->n[ii] < -1))) {
+      step = (d > 0) ? 1 : -1;
+      e->q[ii] = p2Move(e, ii, step);
+      e->n[ii] += step;
+    }
+  }
+}
+
+/* The estimate; exact (nearest rank) up to five samples, NAN without any. */
+float uartP2Get(const uart_p2_t *e) {
+  float v[5];
+
+  if(e->count == 0)
+    return NAN;
+  if(e->count > 5)
+    return e->q[2];
+  memcpy(v, e->q, e->count * sizeof(float));
+  p2Sort(v, e->count);
+  return v[(uint32_t) (e->p * (e->count - 1) + 0.5f)];
+}
+
+/* Windows of 60 answers, EWMA weight 0.1, median, 90th and 99th percentile, answers not passed on. */
+void uartStatsDefaults(uart_stats_cfg_t *cfg) {
+  cfg->windowSamples = 60;
+  cfg->windowMs = 0;
+  cfg->ewmaAlpha = 0.1f;
+  cfg->quantiles = 3;
+  cfg->quantile[0] = 0.5f;
+  cfg->quantile[1] = 0.9f;
+  cfg->quantile[2] = 0.99f;
+  cfg->passThrough = 0;
+}
+
+/* report may be NULL.  Add the stage to the pipeline with uartAnswerAddStage(&st->stage). */
+void uartStatsInit(uart_stats_t *st, const uart_stats_cfg_t *cfg, uart_stats_report_cb_t report, void *ctx) {
+  st->stage.process = statsProcess;
+  st->stage.reading = NULL;
+  st->stage.next = NULL;
+  st->cfg = *cfg;
+  if(st->cfg.quantiles > UART_STATS_QMAX)
+    st->cfg.quantiles = UART_STATS_QMAX;
+  st->report = report;
+  st->ctx = ctx;
+  st->window = 0;
+  st->ewmaSet = 0;
+  statsReset(st);
+}
+
+void uartStatsAdd(uart_stats_t *st, const answer_t *answer, uint64_t timeUs) {
+  uart_stats_field_t *f;
+  uint32_t ii, jj;
+  float x, d;
+
+  if(st->field[0].count && st->cfg.windowMs && (timeUs - st->startUs >= (uint64_t) st->cfg.windowMs * 1000))
+    statsClose(st);
+
+  if(st->field[0].count == 0) {
+    st->startUs = timeUs;
+    st->firstCycle = answer->cycleCount;
+  }
+  for(ii = 0; ii < UART_STATS_FIELDS; ii++) {
+    f = &st->field[ii];
+    x = statsValue(answer, ii);
+    if((f->count == 0) || (x < f->min))
+      f->min = x;
+    if((f->count == 0) || (x > f->max))
+      f->max = x;
+    f->count++;
+    d = x - f->mean;
+    f->mean += d / f->count;
+    f->m2 += d * (x - f->mean);
+    f->ewma = st->ewmaSet ? f->ewma + st->cfg.ewmaAlpha * (x - f->ewma) : x;
+    for(jj = 0; jj < st->cfg.quantiles; jj++)
+      uartP2Add(&f->q[jj], x);
+  }
+  st->ewmaSet = 1;
+  st->lastUs = timeUs;
+  st->lastCycle = answer->cycleCount;
+  st->flamID = answer->flamID;
+
+  if(st->cfg.windowSamples && (st->field[0].count >= st->cfg.windowSamples))
+    statsClose(st);
+}
+
+/* Report what the current window holds so far, if anything. */
+void uartStatsFlush(uart_stats_t *st) {
+  if(st->field[0].count)
+    statsClose(st);
+}
+
+/*
+ * One CSV line for field of the report, see UART_STATS_CSV_HEADER: the window, the field name, the count,
+ * min, max, mean, variance, EWMA and the percentiles.  Returns its length, or 0 if it did not fit.
+ */
+uint32_t uartStatsFormat(char *buf, uint32_t size, const uart_stats_report_t *r, uint32_t field, uint32_t decimals) {
+  float values[5 + UART_STATS_QMAX];
+  uint32_t ii, n, len, w;
+  int head;
+
+  if(size == 0)
+    return 0;
+  head = snprintf(buf, size, "%lu,%s,%lu", (unsigned long) r->window, uartStatsFieldName[field],
+                  (unsigned long) r->count);
+  if((head < 0) || ((uint32_t) head >= size)) {
+    buf[0] = '\0';
+    return 0;
+  }
+
+  values[0] = r->field[field].min;
+  values[1] = r->field[field].max;
+  values[2] = r->field[field].mean;
+  values[3] = r->field[field].var;
+  values[4] = r->field[field].ewma;
+  for(ii = 0; ii < r->quantiles; ii++)
+    values[5 + ii] = r->field[field].q[ii];
+  n = 5 + r->quantiles;
+
+  len = (uint32_t) head;
+  for(ii = 0; ii < n; ii++) {
+    if((len + 1 >= size) || ((w = uartFormatFloat(buf + len + 1, size - len - 1, values[ii], decimals)) == 0)) {
+      buf[0] = '\0';
+      return 0;
+    }
+    buf[len] = ',';
+    len += 1 + w;
+  }
+  if(len + 2 > size) {
+    buf[0] = '\0';
+    return 0;
+  }
+  buf[len++] = '\n';
+  buf[len] = '\0';
+  return len;
+}
@@ -0,0 +1,109 @@
+/********************************************************************************************************==*
+*                                      Streaming statistics for NNTS
+* Filename      : uart_stats.h
+**********************************************************************************************************
+* Notes         : An answer pipeline stage (uart_client.h) that keeps, per window, the count, min, max,
+*                 mean and variance (Welford), an EWMA and approximate percentiles of concentration, temp,
+*                 pressure, relHumidity and absHumidity, and reports them once per window instead of
+*                 passing every answer on.  Memory is constant: the percentiles are P-square estimates,
+*                 five markers each, exact for the first five samples of a window.
+*
+*                 A window ends after windowSamples answers or windowMs, whichever is set and comes first.
+*                 The EWMA runs on across windows.  All arithmetic is in float, for the target's FPU.
+*/
+
+#ifndef __UART_STATS_H
+#define __UART_STATS_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_client.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define UART_STATS_FIELDS       5     /* concentration, temp, pressure, relHumidity, absHumidity */
+#define UART_STATS_QMAX         3     /* percentiles per field */
+
+/* CSV column names, in the order uartStatsFormat() writes them with three percentiles */
+#define UART_STATS_CSV_HEADER   "window,field,count,min,max,mean,var,ewma,q0,q1,q2\n"
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  uint32_t windowSamples;     /* answers per window, 0: by time only */
+  uint32_t windowMs;          /* window length, 0: by count only */
+  float ewmaAlpha;            /* weight of the newest answer */
+  uint32_t quantiles;         /* percentiles kept, up to UART_STATS_QMAX */
+  float quantile[UART_STATS_QMAX];
+  int passThrough;            /* pass every answer on as well */
+} uart_stats_cfg_t;
+
+/* P-square estimate of one quantile. */
+typedef struct {
+  float p;
+  float q[5];                 /* marker heights */
+  int32_t n[5];               /* marker positions */
+  float np[5];                /* desired positions */
+  uint32_t count;
+} uart_p2_t;
+
+typedef struct {
+  uint32_t count;
+  float min;
+  float max;
+  float mean;
+  float m2;                   /* sum of squared deviations from the mean */
+  float ewma;
+  uart_p2_t q[UART_STATS_QMAX];
+} uart_stats_field_t;
+
+typedef struct {
+  uint32_t window;            /* windows reported before this one */
+  uint32_t count;
+  uint64_t startUs;           /* time of the first and last answer in the window */
+  uint64_t endUs;
+  uint32_t firstCycle;
+  uint32_t lastCycle;
+  uint8_t flamID;             /* of the last answer */
+  uint32_t quantiles;
+  struct {
+    float min;
+    float max;
+    float mean;
+    float var;                /* sample variance, 0 for a single answer */
+    float ewma;
+    float q[UART_STATS_QMAX];
+  } field[UART_STATS_FIELDS];
+} uart_stats_report_t;
+
+/* Gets each window's report.  Without one the report is printed as CSV through uartLogText(). */
+typedef void (*uart_stats_report_cb_t)(void *ctx, const uart_stats_report_t *r);
+
+typedef struct {
+  uart_answer_stage_t stage;   /* first: the pipeline sees the stats through it */
+  uart_stats_cfg_t cfg;
+  uart_stats_report_cb_t report;
+  void *ctx;
+  uint32_t window;
+  uint64_t startUs;
+  uint64_t lastUs;
+  uint32_t firstCycle;
+  uint32_t lastCycle;
+  uint8_t flamID;
+  int ewmaSet;
+  uart_stats_field_t field[UART_STATS_FIELDS];
+} uart_stats_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartStatsDefaults(uart_stats_cfg_t *cfg);
+void uartStatsInit(uart_stats_t *st, const uart_stats_cfg_t *cfg, uart_stats_report_cb_t report, void *ctx);
+void uartStatsAdd(uart_stats_t *st, const answer_t *answer, uint64_t timeUs);
+void uartStatsFlush(uart_stats_t *st);
+uint32_t uartStatsFormat(char *buf, uint32_t size, const uart_stats_report_t *r, uint32_t field, uint32_t decimals);
+
+void uartP2Init(uart_p2_t *e, float p);
+void uartP2Add(uart_p2_t *e, float x);
+float uartP2Get(const uart_p2_t *e);
+
+/* Variables --------------------------------------------------------------------------------------------*/
+extern const char *const uartStatsFieldName[UART_STATS_FIELDS];
+
+#endif /* __UART_STATS_H */
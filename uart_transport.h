@@ -0,0 +1,40 @@
+/********************************************************************************************************==*
+*                                      UART transport interface for NNTS
+* Filename      : uart_transport.h
+**********************************************************************************************************
+* Notes         : The protocol code only talks to a uart_transport_t.  Backends fill in the function
+*                 pointers: uart_transport_mbed.cpp wraps a BufferedSerial on the target and
+*                 host/uart_transport_posix.cpp wraps a file descriptor (tty, pty or socket) on Linux.
+*/
+
+#ifndef __UART_TRANSPORT_H
+#define __UART_TRANSPORT_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#define UART_WAIT_FOREVER   0xFFFFFFFF  /* timeout value for a read that blocks until data arrives */
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+typedef struct {
+  void *ctx;   /* backend specific handle */
+  /* Write len bytes.  Returns the number of bytes written or a negative value on error. */
+  int (*write)(void *ctx, const uint8_t *buf, size_t len);
+  /* Wait up to timeoutMs for data and read at most len bytes.  Returns the number of bytes read,
+   * 0 on timeout or a negative value on error. */
+  int (*read)(void *ctx, uint8_t *buf, size_t len, uint32_t timeoutMs);
+} uart_transport_t;
+
+/* Functions --------------------------------------------------------------------------------------------*/
+static inline int uartTransportWrite(uart_transport_t *t, const uint8_t *buf, size_t len) {
+  return t->write(t->ctx, buf, len);
+}
+
+static inline int uartTransportRead(uart_transport_t *t, uint8_t *buf, size_t len, uint32_t timeoutMs) {
+  return t->read(t->ctx, buf, len, timeoutMs);
+}
+
+#endif /* __UART_TRANSPORT_H */
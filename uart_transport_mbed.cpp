@@ -0,0 +1,41 @@
+/********************************************************************************************************==*
+*                                      BufferedSerial transport for NNTS
+* Filename      : uart_transport_mbed.cpp
+**********************************************************************************************************
+* Notes         : Reads block on the serial FileHandle; a finite timeout is implemented with mbed::poll.
+*/
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "uart_transport_mbed.h"
+#include "platform/mbed_poll.h"
+
+/* Local functions --------------------------------------------------------------------------------------*/
+static int mbedWrite(void *ctx, const uint8_t *buf, size_t len) {
+  BufferedSerial *serial = (BufferedSerial *) ctx;
+
+  return (int) serial->write(buf, len);
+}
+
+static int mbedRead(void *ctx, uint8_t *buf, size_t len, uint32_t timeoutMs) {
+  BufferedSerial *serial = (BufferedSerial *) ctx;
+  mbed::pollfh fds;
+  int rc;
+
+  if(timeoutMs != UART_WAIT_FOREVER) {
+    fds.fh = serial;
+    fds.events = POLLIN;
+    rc = mbed::poll(&fds, 1, (int) timeoutMs);
+    if(rc <= 0)
+      return rc;   /* 0 on timeout */
+  }
+
+  return (int) serial->read(buf, len);
+}
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartTransportMbedInit(uart_transport_t *t, BufferedSerial *serial) {
+  t->ctx = serial;
+  t->write = mbedWrite;
+  t->read = mbedRead;
+}
@@ -0,0 +1,18 @@
+/********************************************************************************************************==*
+*                                      BufferedSerial transport for NNTS
+* Filename      : uart_transport_mbed.h
+**********************************************************************************************************
+*/
+
+#ifndef __UART_TRANSPORT_MBED_H
+#define __UART_TRANSPORT_MBED_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include "mbed.h"
+#include "uart_transport.h"
+
+/* Functions --------------------------------------------------------------------------------------------*/
+void uartTransportMbedInit(uart_transport_t *t, BufferedSerial *serial);
+
+#endif /* __UART_TRANSPORT_MBED_H */
@@ -0,0 +1,211 @@
+/********************************************************************************************************==*
+*                                      Wire codec for NNTS
+* Filename      : uart_wire.h
+**********************************************************************************************************
+* Notes         : Everything on the line is little endian and packed: fields follow each other with no
+*                 padding, in the order they are declared in uart_proto.h.  uart_codec<T> moves a header or
+*                 payload between that layout and its C struct, so nothing is written to or read from the
+*                 UART as raw struct memory.
+*
+*                 Each codec is described by its field list.  When the struct already matches the wire
+*                 (little-endian host, no padding - checked at compile time) decode/encode is a single
+*                 memcpy; otherwise every field is a byte load, with SWAP16/SWAP32 on big-endian hosts,
+*                 which the compiler turns into bswap/rev.  Everything is inline, there is no call per
+*                 field.
+*/
+
+#ifndef __UART_WIRE_H
+#define __UART_WIRE_H
+
+/* Includes ---------------------------------------------------------------------------------------------*/
+
+#include <stddef.h>
+#include <string.h>
+#include "uart_proto.h"
+
+/* Defines ----------------------------------------------------------------------------------------------*/
+#ifndef UART_WIRE_NATIVE
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define UART_WIRE_NATIVE    0
+#else
+#define UART_WIRE_NATIVE    1     /* host byte order is wire byte order */
+#endif
+#endif
+
+/* Field lists: kind and name, in wire order */
+#define UART_WIRE_uartRqstHeader_t(F) \
+  F(U16, cmdID) F(U16, length) F(U16, reserved) F(U16, cksum)
+#define UART_WIRE_uartReplyHeader_t(F) \
+  F(U8, cmdID) F(U8, status) F(U16, length) F(U16, cksum)
+#define UART_WIRE_uart_version_t(F) \
+  F(U8, sw_w) F(U8, sw_x) F(U8, sw_y) F(U8, sw_z) F(U8, hw_w) F(U8, hw_x) F(U8, proto_w) F(U8, proto_x)
+#define UART_WIRE_uart_sensor_info_t(F) \
+  F(BYTES, sensorName) F(U32, sensorType) F(BYTES, calDate) F(BYTES, mfgDate)
+#define UART_WIRE_answer_t(F) \
+  F(U32, cycleCount) F(F32, concentration) F(U32, flamID) F(F32, temp) F(F32, pressure) \
+  F(F32, relHumidity) F(F32, absHumidity)
+#define UART_WIRE_uart_engdata_t(F) \
+  F(U32, length) F(BYTES, data)
+
+/* Functions --------------------------------------------------------------------------------------------*/
+static inline uint16_t uartLoad16(const uint8_t *src) {
+  uint16_t v;
+
+  memcpy(&v, src, sizeof(v));
+#if !UART_WIRE_NATIVE
+  v = SWAP16(v);
+#endif
+  return v;
+}
+
+static inline uint32_t uartLoad32(const uint8_t *src) {
+  uint32_t v;
+
+  memcpy(&v, src, sizeof(v));
+#if !UART_WIRE_NATIVE
+  v = SWAP32(v);
+#endif
+  return v;
+}
+
+static inline uint64_t uartLoad64(const uint8_t *src) {
+  return (uint64_t) uartLoad32(src) | ((uint64_t) uartLoad32(src + 4) << 32);
+}
+
+static inline float uartLoadFloat(const uint8_t *src) {
+  uint32_t bits = uartLoad32(src);
+  float v;
+
+  memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+static inline void uartStore16(uint8_t *dst, uint16_t v) {
+#if !UART_WIRE_NATIVE
+  v = SWAP16(v);
+#endif
+  memcpy(dst, &v, sizeof(v));
+}
+
+static inline void uartStore32(uint8_t *dst, uint32_t v) {
+#if !UART_WIRE_NATIVE
+  v = SWAP32(v);
+#endif
+  memcpy(dst, &v, sizeof(v));
+}
+
+static inline void uartStore64(uint8_t *dst, uint64_t v) {
+  uartStore32(dst, (uint32_t) v);
+  uartStore32(dst + 4, (uint32_t) (v >> 32));
+}
+
+static inline void uartStoreFloat(uint8_t *dst, float v) {
+  uint32_t bits;
+
+  memcpy(&bits, &v, sizeof(bits));
+  uartStore32(dst, bits);
+}
+
+/* Structure definitions --------------------------------------------------------------------------------*/
+/* Only the types below have a wire layout; anything else does not compile. */
+template<typename T> struct uart_codec;
+
+template<>
+struct uart_codec<void> {
+  static constexpr uint16_t wireSize = 0;
+  static void decode(const uint8_t *, void *) {}
+  static void encode(const void *, uint8_t *) {}
+};
+
+#define UART_WIRE_SCALAR(T, load, store) \
+  template<> struct uart_codec<T> { \
+    static constexpr uint16_t wireSize = sizeof(T); \
+    static void decode(const uint8_t *src, T *dst) { *dst = load(src); } \
+    static void encode(const T *src, uint8_t *dst) { store(dst, *src); } \
+  };
+
+static inline uint8_t uartLoad8(const uint8_t *src) { return *src; }
+static inline void uartStore8(uint8_t *dst, uint8_t v) { *dst = v; }
+
+UART_WIRE_SCALAR(uint8_t, uartLoad8, uartStore8)
+UART_WIRE_SCALAR(uint16_t, uartLoad16, uartStore16)
+UART_WIRE_SCALAR(uint32_t, uartLoad32, uartStore32)
+UART_WIRE_SCALAR(float, uartLoadFloat, uartStoreFloat)
+#undef UART_WIRE_SCALAR
+
+/* Per-kind pieces used to expand a field list */
+#define UART_WIRE_LEN_U8(S, f)        1
+#define UART_WIRE_LEN_U16(S, f)       2
+#define UART_WIRE_LEN_U32(S, f)       4
+#define UART_WIRE_LEN_U64(S, f)       8
+#define UART_WIRE_LEN_F32(S, f)       4
+#define UART_WIRE_LEN_BYTES(S, f)     sizeof(S::f)
+
+#define UART_WIRE_GET_U8(f)           dst->f = src[pos]
+#define UART_WIRE_GET_U16(f)          dst->f = uartLoad16(&src[pos])
+#define UART_WIRE_GET_U32(f)          dst->f = uartLoad32(&src[pos])
+#define UART_WIRE_GET_U64(f)          dst->f = uartLoad64(&src[pos])
+#define UART_WIRE_GET_F32(f)          dst->f = uartLoadFloat(&src[pos])
+#define UART_WIRE_GET_BYTES(f)        memcpy(dst->f, &src[pos], sizeof(dst->f))
+
+#define UART_WIRE_PUT_U8(f)           dst[pos] = src->f
+#define UART_WIRE_PUT_U16(f)          uartStore16(&dst[pos], src->f)
+#define UART_WIRE_PUT_U32(f)          uartStore32(&dst[pos], src->f)
+#define UART_WIRE_PUT_U64(f)          uartStore64(&dst[pos], src->f)
+#define UART_WIRE_PUT_F32(f)          uartStoreFloat(&dst[pos], src->f)
+#define UART_WIRE_PUT_BYTES(f)        memcpy(&dst[pos], src->f, sizeof(src->f))
+
+#define UART_WIRE_CODEC(T) \
+  /* non-zero if the struct has exactly the wire layout, so the codec can copy it whole */ \
+  static constexpr int uartWireMatches_##T(void) { \
+    typedef T wire_t; \
+    const size_t ofs[] = { UART_WIRE_##T(UART_WIRE_OFS) }; \
+    const size_t len[] = { UART_WIRE_##T(UART_WIRE_LEN) }; \
+    size_t pos = 0; \
+    for(size_t ii = 0; ii < sizeof(ofs) / sizeof(ofs[0]); ii++) { \
+      if(ofs[ii] != pos) \
+        return 0; \
+      pos += len[ii]; \
+    } \
+    return pos == sizeof(T); \
+  } \
+  template<> struct uart_codec<T> { \
+    typedef T wire_t; \
+    static constexpr uint16_t wireSize = 0 UART_WIRE_##T(UART_WIRE_SUM); \
+    static constexpr int native = UART_WIRE_NATIVE && uartWireMatches_##T(); \
+    static inline void decode(const uint8_t *src, T *dst) { \
+      size_t pos = 0; \
+      if(native) { \
+        memcpy(dst, src, sizeof(T)); \
+        return; \
+      } \
+      UART_WIRE_##T(UART_WIRE_DECODE) \
+      (void) pos; \
+    } \
+    static inline void encode(const T *src, uint8_t *dst) { \
+      size_t pos = 0; \
+      if(native) { \
+        memcpy(dst, src, sizeof(T)); \
+        return; \
+      } \
+      UART_WIRE_##T(UART_WIRE_ENCODE) \
+      (void) pos; \
+    } \
+  };
+#define UART_WIRE_OFS(kind, f)        offsetof(wire_t, f),
+#define UART_WIRE_LEN(kind, f)        UART_WIRE_LEN_##kind(wire_t, f),
+#define UART_WIRE_SUM(kind, f)        + UART_WIRE_LEN_##kind(wire_t, f)
+#define UART_WIRE_DECODE(kind, f)     UART_WIRE_GET_##kind(f); pos += UART_WIRE_LEN_##kind(wire_t, f);
+#define UART_WIRE_ENCODE(kind, f)     UART_WIRE_PUT_##kind(f); pos += UART_WIRE_LEN_##kind(wire_t, f);
+
+UART_WIRE_CODEC(uartRqstHeader_t)
+UART_WIRE_CODEC(uartReplyHeader_t)
+UART_WIRE_CODEC(uart_version_t)
+UART_WIRE_CODEC(uart_sensor_info_t)
+UART_WIRE_CODEC(answer_t)
+UART_WIRE_CODEC(uart_engdata_t)
+
+static_assert(uart_codec<uartRqstHeader_t>::wireSize == RQST_HDR_LENGTH, "request header is 8 bytes on the wire");
+static_assert(uart_codec<uartReplyHeader_t>::wireSize == REPLY_HDR_LENGTH, "reply header is 6 bytes on the wire");
+
+#endif /* __UART_WIRE_H */